@@ -0,0 +1,233 @@
+#include "myshell.h"
+
+#define MAX_ALIAS_DEPTH 16
+
+// One alias, kept in definition order
+typedef struct Alias
+{
+    char *name;
+    char *value;
+    struct Alias *next;
+} Alias;
+
+static Alias *aliases = NULL;
+
+// Finds the alias named by the len bytes at name, or returns NULL
+static Alias *alias_find(const char *name, size_t len, Alias ***link_out)
+{
+    Alias **link = &aliases;
+    while (*link != NULL)
+    {
+        if (strlen((*link)->name) == len && strncmp((*link)->name, name, len) == 0)
+        {
+            if (link_out != NULL)
+                *link_out = link;
+            return *link;
+        }
+        link = &(*link)->next;
+    }
+    return NULL;
+}
+
+// Calls visit with the name of every alias
+void for_each_alias(void (*visit)(const char *name))
+{
+    for (const Alias *alias = aliases; alias != NULL; alias = alias->next)
+        visit(alias->name);
+}
+
+// Prints an alias in the form alias reads back, single quotes in the value escaped as '\''
+static void alias_print(const Alias *alias)
+{
+    printf("alias %s='", alias->name);
+    for (const char *p = alias->value; *p != '\0'; p++)
+    {
+        if (*p == '\'')
+            printf("'\\''");
+        else
+            putchar(*p);
+    }
+    printf("'\n");
+}
+
+// alias [name[=value]...]: defines each name=value, prints each name, or prints every alias without arguments
+void alias_builtin(char **argv)
+{
+    if (argv[1] == NULL)
+    {
+        for (const Alias *alias = aliases; alias != NULL; alias = alias->next)
+            alias_print(alias);
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        const char *eq = strchr(argv[i], '=');
+        size_t len = eq != NULL ? (size_t)(eq - argv[i]) : strlen(argv[i]);
+        Alias *alias = alias_find(argv[i], len, NULL);
+
+        if (eq == NULL)
+        {
+            if (alias != NULL)
+                alias_print(alias);
+            else
+            {
+                fprintf(stderr, "alias: %s: not found\n", argv[i]);
+                last_exit_status = 1;
+            }
+            continue;
+        }
+        if (len == 0 || strcspn(argv[i], " \t\n'\"\\$`|&;<>") < len)
+        {
+            fprintf(stderr, "alias: '%.*s': invalid alias name\n", (int)len, argv[i]);
+            last_exit_status = 1;
+            continue;
+        }
+
+        char *value = my_strdup(eq + 1);
+        if (alias == NULL)
+        {
+            Alias **tail = &aliases;
+            while (*tail != NULL)
+                tail = &(*tail)->next;
+            alias = calloc(1, sizeof(Alias));
+            if (alias != NULL)
+                alias->name = strndup(argv[i], len);
+            *tail = alias;
+        }
+        if (value == NULL || alias == NULL || alias->name == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        free(alias->value);
+        alias->value = value;
+    }
+}
+
+// unalias -a | unalias name...: removes every alias, or the ones named
+void unalias_builtin(char **argv)
+{
+    if (argv[1] == NULL)
+    {
+        fprintf(stderr, "unalias: usage: unalias -a | unalias name...\n");
+        last_exit_status = 2;
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        int all = strcmp(argv[i], "-a") == 0;
+        Alias **link = &aliases;
+        Alias *alias = all ? aliases : alias_find(argv[i], strlen(argv[i]), &link);
+
+        if (alias == NULL && !all)
+        {
+            fprintf(stderr, "unalias: %s: not found\n", argv[i]);
+            last_exit_status = 1;
+            continue;
+        }
+        while (alias != NULL)
+        {
+            *link = alias->next;
+            free(alias->name);
+            free(alias->value);
+            free(alias);
+            alias = all ? *link : NULL;
+        }
+    }
+}
+
+// Appends len bytes to out, returns -1 when they do not fit in size
+static int append(char *out, size_t *used, size_t size, const char *text, size_t len)
+{
+    if (*used + len >= size)
+        return -1;
+    memcpy(out + *used, text, len);
+    *used += len;
+    return 0;
+}
+
+// Appends the value of alias to out; when the value starts with another alias that is not already being
+// expanded on the way here, that one is replaced too. chain holds the depth aliases expanded so far
+static int append_alias(char *out, size_t *used, size_t size, const Alias *alias, const Alias **chain, int depth)
+{
+    const char *value = alias->value;
+    size_t blanks = strspn(value, " \t");
+    size_t word = strcspn(value + blanks, " \t\n;|&<>");
+    const Alias *inner = depth < MAX_ALIAS_DEPTH ? alias_find(value + blanks, word, NULL) : NULL;
+
+    chain[depth] = alias;
+    for (int i = 0; inner != NULL && i <= depth; i++)
+    {
+        if (chain[i] == inner)
+            inner = NULL;
+    }
+    if (inner == NULL)
+        return append(out, used, size, value, strlen(value));
+    if (append(out, used, size, value, blanks) == -1 || append_alias(out, used, size, inner, chain, depth + 1) == -1)
+        return -1;
+    return append(out, used, size, value + blanks + word, strlen(value + blanks + word));
+}
+
+// Replaces every unquoted word in command position of the lexed command that names an alias by the alias's
+// value, in place; command holds MAX_COMMAND_LENGTH bytes. A value ending in a blank makes the word after it
+// a candidate too. Returns 1 when the text changed and has to be lexed again, 0 when it did not, -1 after
+// reporting an expansion too long for the line
+int expand_aliases(char *command, const Token *tokens, int count)
+{
+    char out[MAX_COMMAND_LENGTH];
+    const Alias *chain[MAX_ALIAS_DEPTH + 1];
+    size_t used = 0;
+    size_t copied = 0; // end of the part of command already in out
+    int command_start = 1;
+    int changed = 0;
+
+    if (aliases == NULL)
+        return 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const Token *token = &tokens[i];
+        if (token->type != TOK_WORD)
+        {
+            // After a redirection operator comes a file name, not a command
+            command_start = token->type == TOK_SEMI || token->type == TOK_PIPE || token->type == TOK_AMP;
+            continue;
+        }
+        if (!command_start)
+            continue;
+
+        const Alias *alias = NULL;
+        if (!token->quoted && !token->expand)
+            alias = alias_find(command + token->offset, token->length, NULL);
+        if (alias == NULL)
+        {
+            command_start = 0;
+            for (int k = 0; command_keywords[k] != NULL; k++)
+                command_start |= token_is(command, token, command_keywords[k]);
+            continue;
+        }
+
+        if (append(out, &used, sizeof(out), command + copied, token->offset - copied) == -1 ||
+            append_alias(out, &used, sizeof(out), alias, chain, 0) == -1)
+        {
+            fprintf(stderr, "alias: expansion too long\n");
+            return -1;
+        }
+        copied = token->offset + token->length;
+        size_t value_len = strlen(alias->value);
+        command_start = value_len > 0 && (alias->value[value_len - 1] == ' ' || alias->value[value_len - 1] == '\t');
+        changed = 1;
+    }
+
+    if (!changed)
+        return 0;
+    if (append(out, &used, sizeof(out), command + copied, strlen(command + copied) + 1) == -1)
+    {
+        fprintf(stderr, "alias: expansion too long\n");
+        return -1;
+    }
+    memcpy(command, out, used);
+    return 1;
+}
@@ -0,0 +1,145 @@
+#include "myshell.h"
+
+#define ARENA_BLOCK_SIZE 8192
+#define ARENA_ALIGN (sizeof(void *))
+
+// One chunk of arena memory; blocks are kept chained after a reset and reused by later lines
+struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+// Memory for everything derived from the current input line: tokens, argv arrays and expansions
+Arena line_arena = {NULL, NULL, 0, 0, 0};
+
+// Moves to the next kept block, or mallocs a new one large enough for size bytes
+static ArenaBlock *arena_grow(Arena *arena, size_t size)
+{
+    ArenaBlock *next = arena->current != NULL ? arena->current->next : arena->head;
+
+    // Reuse blocks left over from earlier lines while they are large enough
+    while (next != NULL && next->size < size)
+        next = next->next;
+    if (next != NULL)
+    {
+        next->used = 0;
+        arena->current = next;
+        return next;
+    }
+
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    arena->heap_allocations++;
+    arena->line_allocations++;
+
+    block->size = block_size;
+    block->used = 0;
+    if (arena->current == NULL)
+    {
+        block->next = arena->head;
+        arena->head = block;
+    }
+    else
+    {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    }
+    arena->current = block;
+    return block;
+}
+
+// Returns size bytes of pointer-aligned memory that lives until the next arena_reset()
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = arena->current;
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if (block == NULL || block->size - block->used < size)
+        block = arena_grow(arena, size);
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+// Copies len bytes of s into the arena as a NUL-terminated string
+char *arena_strndup(Arena *arena, const char *s, size_t len)
+{
+    char *dup = arena_alloc(arena, len + 1);
+    memcpy(dup, s, len);
+    dup[len] = '\0';
+    return dup;
+}
+
+// Copies a NUL-terminated string into the arena
+char *arena_strdup(Arena *arena, const char *s)
+{
+    return arena_strndup(arena, s, strlen(s));
+}
+
+// Releases everything allocated since the last reset in O(1), keeping the blocks for reuse
+void arena_reset(Arena *arena)
+{
+    arena->current = arena->head;
+    if (arena->head != NULL)
+        arena->head->used = 0;
+    arena->bytes_used = 0;
+    arena->line_allocations = 0;
+}
+
+// Remembers the current end of the arena so the allocations made after it can be released together
+ArenaMark arena_mark(const Arena *arena)
+{
+    ArenaMark mark = {arena->current, arena->current != NULL ? arena->current->used : 0, arena->bytes_used};
+    return mark;
+}
+
+// Releases everything allocated since mark was taken, keeping the blocks for reuse
+void arena_rewind(Arena *arena, ArenaMark mark)
+{
+    if (mark.block == NULL)
+    {
+        arena_reset(arena);
+        return;
+    }
+    arena->current = mark.block;
+    mark.block->used = mark.used;
+    arena->bytes_used = mark.bytes_used;
+}
+
+// Gives every block of an arena back to the heap, leaving it empty and ready for reuse
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Prints how much the arena holds and how often it had to go to the heap
+void arena_stats(const Arena *arena)
+{
+    int blocks = 0;
+    size_t reserved = 0;
+    for (ArenaBlock *block = arena->head; block != NULL; block = block->next)
+    {
+        blocks++;
+        reserved += block->size;
+    }
+    printf("arena: %d blocks, %zu bytes reserved, %zu bytes used by this line\n", blocks, reserved, arena->bytes_used);
+    printf("arena: %zu heap allocations for this line, %zu since startup\n", arena->line_allocations,
+           arena->heap_allocations);
+}
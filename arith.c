@@ -0,0 +1,403 @@
+#include "myshell.h"
+
+// State of one evaluation of the text inside $(( ))
+typedef struct
+{
+    const char *p;
+    const char *error;
+    int skip; // inside the branch of && || ?: that is not taken: nothing is assigned and nothing fails
+} Arith;
+
+static long arith_assign(Arith *a);
+
+// Skips blanks before the next operator or operand
+static void skip_blanks(Arith *a)
+{
+    while (isspace((unsigned char)*a->p))
+        a->p++;
+}
+
+// Consumes op when it comes next and is not the start of a longer operator in notbefore
+static int accept(Arith *a, const char *op, const char *notbefore)
+{
+    size_t len = strlen(op);
+    skip_blanks(a);
+    if (strncmp(a->p, op, len) != 0)
+        return 0;
+    if (notbefore != NULL && a->p[len] != '\0' && strchr(notbefore, a->p[len]) != NULL)
+        return 0;
+    a->p += len;
+    return 1;
+}
+
+// Records the first error; evaluation carries on but the result is thrown away
+static long fail(Arith *a, const char *message)
+{
+    if (a->error == NULL)
+        a->error = message;
+    return 0;
+}
+
+// Reads an identifier into name as a shell variable name (with its '$'), returns 0 when there is none
+static int read_name(Arith *a, char *name, size_t size)
+{
+    skip_blanks(a);
+    if (!isalpha((unsigned char)*a->p) && *a->p != '_')
+        return 0;
+
+    size_t len = 1;
+    name[0] = '$';
+    while ((isalnum((unsigned char)*a->p) || *a->p == '_') && len < size - 1)
+        name[len++] = *a->p++;
+    name[len] = '\0';
+    return 1;
+}
+
+// Value of a variable as an integer; unset or empty variables count as 0
+static long variable_value(Arith *a, const char *name)
+{
+    const char *value = get_variable_value(name);
+    char *end;
+
+    if (value == NULL || *value == '\0')
+        return 0;
+    long number = strtol(value, &end, 0);
+    while (isspace((unsigned char)*end))
+        end++;
+    if (*end != '\0')
+        return fail(a, "variable is not an integer");
+    return number;
+}
+
+// Stores an integer in a variable unless evaluating a branch that is not taken
+static void set_number(Arith *a, const char *name, long number)
+{
+    char value[32];
+    if (a->skip)
+        return;
+    snprintf(value, sizeof(value), "%ld", number);
+    set_variable_value(name, value);
+}
+
+// Number, variable (with ++ or -- after it), or parenthesised expression
+static long arith_primary(Arith *a)
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    skip_blanks(a);
+    if (accept(a, "(", NULL))
+    {
+        long value = arith_assign(a);
+        if (!accept(a, ")", NULL))
+            return fail(a, "missing ')'");
+        return value;
+    }
+    if (isdigit((unsigned char)*a->p))
+    {
+        char *end;
+        long value = strtol(a->p, &end, 0);
+        if (isalnum((unsigned char)*end))
+            return fail(a, "invalid number");
+        a->p = end;
+        return value;
+    }
+    if (*a->p == '$')
+        a->p++;
+    if (read_name(a, name, sizeof(name)))
+    {
+        long value = variable_value(a, name);
+        if (accept(a, "++", NULL))
+            set_number(a, name, value + 1);
+        else if (accept(a, "--", NULL))
+            set_number(a, name, value - 1);
+        return value;
+    }
+    return fail(a, *a->p == '\0' ? "operand expected" : "syntax error");
+}
+
+// Prefix operators: + - ! ~ and ++/-- on a variable
+static long arith_unary(Arith *a)
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    if (accept(a, "++", NULL) || accept(a, "--", NULL))
+    {
+        long delta = a->p[-1] == '+' ? 1 : -1;
+        if (!read_name(a, name, sizeof(name)))
+            return fail(a, "variable expected");
+        long value = variable_value(a, name) + delta;
+        set_number(a, name, value);
+        return value;
+    }
+    if (accept(a, "-", NULL))
+        return -arith_unary(a);
+    if (accept(a, "+", NULL))
+        return arith_unary(a);
+    if (accept(a, "!", "="))
+        return !arith_unary(a);
+    if (accept(a, "~", NULL))
+        return ~arith_unary(a);
+    return arith_primary(a);
+}
+
+// value / rhs or value % rhs for a non-zero rhs; dividing the most negative value by -1 overflows and traps
+// in C, so -1 negates in unsigned arithmetic (wrapping like the other operators) and leaves no remainder
+static long divide(long value, long rhs, char op)
+{
+    if (rhs == -1)
+        return op == '/' ? (long)(0 - (unsigned long)value) : 0;
+    return op == '/' ? value / rhs : value % rhs;
+}
+
+// value << count, or value >> count with right set; a negative count shifts the other way, and a count of the
+// width of a long or more shifts every bit out, leaving 0 or, shifting a negative value right, -1
+static long shift(long value, long count, int right)
+{
+    int width = (int)sizeof(long) * CHAR_BIT;
+
+    if (count < 0)
+    {
+        right = !right;
+        count = count == LONG_MIN ? width : -count;
+    }
+    if (right)
+        return count >= width ? (value < 0 ? -1 : 0) : value >> count;
+    return count >= width ? 0 : (long)((unsigned long)value << count);
+}
+
+// * / %
+static long arith_multiply(Arith *a)
+{
+    long value = arith_unary(a);
+    while (1)
+    {
+        if (accept(a, "*", "="))
+            value *= arith_unary(a);
+        else if (accept(a, "/", "=") || accept(a, "%", "="))
+        {
+            char op = a->p[-1];
+            long rhs = arith_unary(a);
+            if (rhs == 0)
+            {
+                if (!a->skip)
+                    return fail(a, "division by zero");
+                continue;
+            }
+            value = divide(value, rhs, op);
+        }
+        else
+            return value;
+    }
+}
+
+// + -
+static long arith_add(Arith *a)
+{
+    long value = arith_multiply(a);
+    while (1)
+    {
+        if (accept(a, "+", "+="))
+            value += arith_multiply(a);
+        else if (accept(a, "-", "-="))
+            value -= arith_multiply(a);
+        else
+            return value;
+    }
+}
+
+// << >>
+static long arith_shift(Arith *a)
+{
+    long value = arith_add(a);
+    while (1)
+    {
+        if (accept(a, "<<", "="))
+            value = shift(value, arith_add(a), 0);
+        else if (accept(a, ">>", "="))
+            value = shift(value, arith_add(a), 1);
+        else
+            return value;
+    }
+}
+
+// < <= > >=
+static long arith_compare(Arith *a)
+{
+    long value = arith_shift(a);
+    while (1)
+    {
+        if (accept(a, "<=", NULL))
+            value = value <= arith_shift(a);
+        else if (accept(a, ">=", NULL))
+            value = value >= arith_shift(a);
+        else if (accept(a, "<", "<"))
+            value = value < arith_shift(a);
+        else if (accept(a, ">", ">"))
+            value = value > arith_shift(a);
+        else
+            return value;
+    }
+}
+
+// == !=
+static long arith_equal(Arith *a)
+{
+    long value = arith_compare(a);
+    while (1)
+    {
+        if (accept(a, "==", NULL))
+            value = value == arith_compare(a);
+        else if (accept(a, "!=", NULL))
+            value = value != arith_compare(a);
+        else
+            return value;
+    }
+}
+
+// & ^ | (bitwise, in order of precedence)
+static long arith_bit_and(Arith *a)
+{
+    long value = arith_equal(a);
+    while (accept(a, "&", "&="))
+        value &= arith_equal(a);
+    return value;
+}
+
+static long arith_bit_xor(Arith *a)
+{
+    long value = arith_bit_and(a);
+    while (accept(a, "^", "="))
+        value ^= arith_bit_and(a);
+    return value;
+}
+
+static long arith_bit_or(Arith *a)
+{
+    long value = arith_bit_xor(a);
+    while (accept(a, "|", "|="))
+        value |= arith_bit_xor(a);
+    return value;
+}
+
+// && and ||, evaluating the right side only for its syntax when the left side decides
+static long arith_logical_and(Arith *a)
+{
+    long value = arith_bit_or(a);
+    while (accept(a, "&&", NULL))
+    {
+        int skip = a->skip;
+        a->skip = skip || !value;
+        long rhs = arith_bit_or(a);
+        a->skip = skip;
+        value = value && rhs;
+    }
+    return value;
+}
+
+static long arith_logical_or(Arith *a)
+{
+    long value = arith_logical_and(a);
+    while (accept(a, "||", NULL))
+    {
+        int skip = a->skip;
+        a->skip = skip || value;
+        long rhs = arith_logical_and(a);
+        a->skip = skip;
+        value = value || rhs;
+    }
+    return value;
+}
+
+// cond ? a : b
+static long arith_conditional(Arith *a)
+{
+    long cond = arith_logical_or(a);
+    if (!accept(a, "?", NULL))
+        return cond;
+
+    int skip = a->skip;
+    a->skip = skip || !cond;
+    long yes = arith_assign(a);
+    a->skip = skip;
+    if (!accept(a, ":", NULL))
+        return fail(a, "missing ':'");
+    a->skip = skip || cond;
+    long no = arith_conditional(a);
+    a->skip = skip;
+    return cond ? yes : no;
+}
+
+// name = value and the compound assignments, right to left; anything else is a conditional expression
+static long arith_assign(Arith *a)
+{
+    static const char *const ops[] = {"=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=", NULL};
+    char name[MAX_COMMAND_LENGTH];
+    const char *start = a->p;
+
+    if (read_name(a, name, sizeof(name)))
+    {
+        for (int i = 0; ops[i] != NULL; i++)
+        {
+            if (!accept(a, ops[i], i == 0 ? "=" : NULL))
+                continue;
+
+            long rhs = arith_assign(a);
+            long value = i == 0 ? rhs : variable_value(a, name);
+            switch (ops[i][0])
+            {
+            case '+':
+                value += rhs;
+                break;
+            case '-':
+                value -= rhs;
+                break;
+            case '*':
+                value *= rhs;
+                break;
+            case '/':
+            case '%':
+                if (rhs == 0)
+                    return a->skip ? 0 : fail(a, "division by zero");
+                value = divide(value, rhs, ops[i][0]);
+                break;
+            case '<':
+                value = shift(value, rhs, 0);
+                break;
+            case '>':
+                value = shift(value, rhs, 1);
+                break;
+            case '&':
+                value &= rhs;
+                break;
+            case '^':
+                value ^= rhs;
+                break;
+            case '|':
+                value |= rhs;
+                break;
+            }
+            set_number(a, name, value);
+            return value;
+        }
+        a->p = start;
+    }
+    return arith_conditional(a);
+}
+
+// Evaluates the integer expression in text, reading and assigning shell variables by their bare names
+// Returns 0 with the value in result, or -1 after reporting the error
+int arith_eval(const char *text, long *result)
+{
+    Arith a = {text, NULL, 0};
+
+    *result = arith_assign(&a);
+    skip_blanks(&a);
+    if (a.error == NULL && *a.p != '\0')
+        a.error = "syntax error";
+    if (a.error != NULL)
+    {
+        fprintf(stderr, "%s: arithmetic %s\n", text, a.error);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Measures Tab completion against a PATH directory of many executables: the first index build, a command
+// completion once the index is current (one stat per PATH directory, then a binary search), a rebuild after
+// the directory changed, and a file name completion in the same directory, reading it and then finding it
+// unchanged
+
+#define DEFAULT_ENTRIES 20000
+#define DEFAULT_RUNS 1000
+
+// Fills dir with count empty executables named cmdNNNNN
+static int populate(const char *dir, int count)
+{
+    char path[PATH_MAX];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/cmd%05d", dir, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+        if (fd == -1)
+            return -1;
+        close(fd);
+    }
+    return 0;
+}
+
+// Removes the files populate() made, then the directory
+static void cleanup(const char *dir, int count)
+{
+    char path[PATH_MAX];
+    for (int i = 0; i <= count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/cmd%05d", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+// Completes line with the cursor at its end runs times and returns the mean time per completion
+static double time_completion(const char *line, int runs, int *count)
+{
+    Completion completion;
+    double start = now_seconds();
+    for (int i = 0; i < runs; i++)
+    {
+        ArenaMark mark = arena_mark(&line_arena);
+        complete_word(line, strlen(line), &completion);
+        *count = completion.count;
+        arena_rewind(&line_arena, mark);
+    }
+    return (now_seconds() - start) / runs;
+}
+
+int main(int argc, char *argv[])
+{
+    int entries = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    char dir[] = "/tmp/myshell_complete_XXXXXX";
+    char line[PATH_MAX + 16];
+    char path[PATH_MAX];
+    int count;
+
+    if (mkdtemp(dir) == NULL || populate(dir, entries) == -1)
+    {
+        perror("populate");
+        return 1;
+    }
+    setenv("PATH", dir, 1);
+    printf("completion benchmark: %d executables on PATH, %d completions per case\n", entries, runs);
+
+    double start = now_seconds();
+    command_index_refresh();
+    printf("%-18s %10.1f us\n", "index build", (now_seconds() - start) * 1e6);
+
+    double mean = time_completion("cmd1234", runs, &count);
+    printf("%-18s %10.1f us/op %6d matches\n", "command", mean * 1e6, count);
+
+    // A new file changes the directory's mtime, so the next completion reads it again
+    snprintf(path, sizeof(path), "%s/cmd%05d", dir, entries);
+    close(open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0755));
+    mean = time_completion("cmd1234", 1, &count);
+    printf("%-18s %10.1f us/op %6d matches\n", "command, rescan", mean * 1e6, count);
+
+    // The first file name completion reads the directory, the ones after it find it unchanged
+    snprintf(line, sizeof(line), "ls %s/cmd1234", dir);
+    mean = time_completion(line, 1, &count);
+    printf("%-18s %10.1f us/op %6d matches\n", "file name, read", mean * 1e6, count);
+    mean = time_completion(line, runs, &count);
+    printf("%-18s %10.1f us/op %6d matches\n", "file name", mean * 1e6, count);
+
+    cleanup(dir, entries);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Measures a transformation applied line by line from a script: a new sed for every line through $( ), and
+// one sed kept running as a coprocess, written to and read back once per line. A batch case writes every
+// line before reading the answers back, where read takes them from its buffer instead of a byte at a time
+
+#define DEFAULT_LINES 2000
+#define FILTER "sed -u s/item/ITEM/"
+
+// Writes a while loop running body lines times, with setup before it and finish after it
+static int write_script(char *path, const char *setup, const char *body, const char *finish, int lines)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    fprintf(out, "%s\n$i = 0\nwhile test $i -lt %d; do\n  %s\n  $i = $((i + 1))\ndone\n%s\n", setup, lines, body,
+            finish);
+    fclose(out);
+    return 0;
+}
+
+// Times one script and prints the cost per line
+static void run_case(const char *shell, const char *label, const char *setup, const char *body, const char *finish,
+                     int lines)
+{
+    char script_path[] = "/tmp/myshell_coproc_bench_XXXXXX";
+    if (write_script(script_path, setup, body, finish, lines) == -1)
+    {
+        perror("mkstemp");
+        return;
+    }
+
+    double elapsed = run_shell(shell, script_path, 0);
+    printf("%-12s %8.3f s %10.0f lines/s %8.2f us/line\n", label, elapsed, lines / elapsed, elapsed * 1e6 / lines);
+    unlink(script_path);
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : DEFAULT_LINES;
+    const char *shell = argc > 2 ? argv[2] : "./myshell";
+    char batch_read[128];
+
+    printf("coproc benchmark: %d lines through %s via %s\n", lines, FILTER, shell);
+    run_case(shell, "spawn", "", "$x = $(echo item $i | " FILTER ")", "", lines);
+    run_case(shell, "coproc", "coproc F " FILTER, "echo item $i >&$F_IN\n  read -u $F_OUT x", "coproc -c F", lines);
+
+    // The answers pile up in the pipe, so the batch stays under its capacity
+    snprintf(batch_read, sizeof(batch_read),
+             "$i = 0\nwhile test $i -lt %d; do\n  read -u $F_OUT x\n  $i = $((i + 1))\ndone\ncoproc -c F", lines);
+    run_case(shell, "coproc batch", "coproc F " FILTER, "echo item $i >&$F_IN", batch_read, lines);
+    return 0;
+}
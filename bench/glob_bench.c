@@ -0,0 +1,136 @@
+#include "myshell.h"
+
+#include <glob.h>
+
+#include "harness.h"
+
+// Measures pathname expansion: a pattern in a directory of many files with the shell's engine and with
+// glob(3), a second pattern in the same directory answered from the command's listing cache, and a **
+// pattern over a tree large enough to be walked by several threads
+
+#define DEFAULT_FILES 20000
+#define DEFAULT_RUNS 20
+#define TREE_DIRS 2000
+#define TREE_FILES 10
+
+// Creates an empty file at path
+static int touch(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return -1;
+    close(fd);
+    return 0;
+}
+
+// Fills dir with count files, every other one a .c file, and a tree of TREE_DIRS directories three levels
+// deep holding TREE_FILES files each
+static int populate(const char *dir, int count)
+{
+    char path[PATH_MAX];
+
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/file%05d.%s", dir, i, i % 2 == 0 ? "c" : "h");
+        if (touch(path) == -1)
+            return -1;
+    }
+    for (int i = 0; i < TREE_DIRS; i++)
+    {
+        snprintf(path, sizeof(path), "%s/tree/d%d/d%d/d%d", dir, i % 10, i / 10 % 20, i);
+        for (char *slash = path + strlen(dir) + 1; (slash = strchr(slash, '/')) != NULL; slash++)
+        {
+            *slash = '\0';
+            mkdir(path, 0755);
+            *slash = '/';
+        }
+        mkdir(path, 0755);
+        size_t len = strlen(path);
+        for (int j = 0; j < TREE_FILES; j++)
+        {
+            snprintf(path + len, sizeof(path) - len, "/f%d.%s", j, j % 2 == 0 ? "c" : "h");
+            if (touch(path) == -1)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// Expands pattern runs times with the shell's engine, each time with an empty listing cache unless cached is
+// set, and returns the mean time per expansion
+static double time_shell(const char *pattern, int runs, int cached, int *count)
+{
+    char **paths;
+    double start = now_seconds();
+    for (int i = 0; i < runs; i++)
+    {
+        ArenaMark mark = arena_mark(&line_arena);
+        if (!cached)
+            glob_cache_reset();
+        *count = glob_expand(pattern, &paths);
+        arena_rewind(&line_arena, mark);
+    }
+    return (now_seconds() - start) / runs;
+}
+
+// Expands pattern runs times with glob(3) and returns the mean time per expansion
+static double time_libc(const char *pattern, int runs, int *count)
+{
+    glob_t result;
+    double start = now_seconds();
+    for (int i = 0; i < runs; i++)
+    {
+        glob(pattern, 0, NULL, &result);
+        *count = result.gl_pathc;
+        globfree(&result);
+    }
+    return (now_seconds() - start) / runs;
+}
+
+// Prints one case
+static void report(const char *label, double seconds, const int *count)
+{
+    printf("%-22s %10.1f us/op %8d matches\n", label, seconds * 1e6, *count);
+}
+
+int main(int argc, char *argv[])
+{
+    int files = argc > 1 ? atoi(argv[1]) : DEFAULT_FILES;
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    char dir[] = "/tmp/myshell_glob_XXXXXX";
+    char command[64];
+    int count;
+
+    if (mkdtemp(dir) == NULL || populate(dir, files) == -1 || chdir(dir) == -1)
+    {
+        perror("populate");
+        return 1;
+    }
+    printf("glob benchmark: %d files, a tree of %d directories, %d runs per case\n", files, TREE_DIRS, runs);
+
+    report("*.c glob(3)", time_libc("*.c", runs, &count), &count);
+    report("*.c", time_shell("*.c", runs, 0, &count), &count);
+
+    // Matching nothing leaves the cost of reading the directory
+    report("*.zz glob(3)", time_libc("*.zz", runs, &count), &count);
+    report("*.zz", time_shell("*.zz", runs, 0, &count), &count);
+
+    report("file1[0-4]*.c glob(3)", time_libc("file1[0-4]*.c", runs, &count), &count);
+    report("file1[0-4]*.c", time_shell("file1[0-4]*.c", runs, 0, &count), &count);
+
+    // A second pattern of the same command finds the directory already read
+    time_shell("*.c", 1, 0, &count);
+    report("*.h, same command", time_shell("*.h", runs, 1, &count), &count);
+
+    report("tree/*/*/*/*.c glob(3)", time_libc("tree/*/*/*/*.c", runs, &count), &count);
+    report("tree/*/*/*/*.c", time_shell("tree/*/*/*/*.c", runs, 0, &count), &count);
+    report("tree/**/*.c", time_shell("tree/**/*.c", runs, 0, &count), &count);
+
+    if (chdir("/") == 0)
+    {
+        snprintf(command, sizeof(command), "rm -rf %s", dir);
+        if (system(command) != 0)
+            fprintf(stderr, "could not remove %s\n", dir);
+    }
+    return 0;
+}
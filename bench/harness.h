@@ -0,0 +1,44 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <time.h>
+
+// Helpers shared by the benchmarks: a monotonic clock and a way to time the shell on a script
+
+// Returns the current monotonic time in seconds
+static inline double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Runs the shell once, either on the script path or with the script on stdin, with its output discarded,
+// and returns the elapsed time
+static inline double run_shell(const char *shell, const char *script, int via_stdin)
+{
+    double start = now_seconds();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        if (via_stdin)
+        {
+            int in_fd = open(script, O_RDONLY);
+            dup2(in_fd, STDIN_FILENO);
+            execl(shell, shell, (char *)NULL);
+        }
+        else
+        {
+            execl(shell, shell, script, (char *)NULL);
+        }
+        _exit(127);
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+    return now_seconds() - start;
+}
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,133 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Compares the old split_string-based parse_command (a counting pass, a strdup and a trim per split)
+// with the single-pass lexer building the same argv rows from spans in the line arena
+
+#define DEFAULT_ITERATIONS 1000000
+
+static const char *sample_lines[] = {
+    "ls -l",
+    "cat file.txt | grep search | sort | uniq -c",
+    "echo abc xyz > out.txt",
+    "find . -name x -type f | xargs grep -n pattern | cut -d : -f 1 | sort -u | head -20",
+};
+
+// The tokenizer as it was before the lexer, kept here as the baseline
+static char *legacy_trim(char *str)
+{
+    char *end;
+
+    while (isspace((unsigned char)*str))
+        str++;
+    if (*str == 0)
+        return str;
+
+    end = str + strlen(str) - 1;
+    while (end > str && isspace((unsigned char)*end))
+        end--;
+    *(end + 1) = 0;
+    return str;
+}
+
+static char **legacy_split_string(const char *str, const char delimiter, int *num_tokens, char **copy)
+{
+    int count = 0;
+    for (const char *temp = str; *temp; temp++)
+    {
+        if (*temp == delimiter)
+            count++;
+    }
+
+    char **tokens = malloc((count + 2) * sizeof(char *));
+    int index = 0;
+    char *start = strdup(str);
+    *copy = start;
+
+    char *end = strchr(start, delimiter);
+    while (end != NULL)
+    {
+        *end = '\0';
+        tokens[index++] = legacy_trim(start);
+        start = end + 1;
+        end = strchr(start, delimiter);
+    }
+    tokens[index++] = legacy_trim(start);
+    tokens[index] = NULL;
+
+    *num_tokens = index;
+    return tokens;
+}
+
+// Old parse_command, freeing what it allocates so the baseline is not charged for its leaks
+static int legacy_parse(const char *line, char ***argv, int *argc)
+{
+    int num_tokens;
+    char *copies[MAX_ARG_COUNT + 1];
+    char **commands = legacy_split_string(line, '|', &num_tokens, &copies[0]);
+    int words = 0;
+
+    for (int i = 0; i < num_tokens; i++)
+    {
+        argv[i] = legacy_split_string(commands[i], ' ', &argc[i], &copies[i + 1]);
+        words += argc[i];
+    }
+    for (int i = 0; i < num_tokens; i++)
+    {
+        free(argv[i]);
+        free(copies[i + 1]);
+    }
+    free(commands);
+    free(copies[0]);
+    return words;
+}
+
+// New path: one lexing pass, argv rows built from spans, everything released by an arena reset
+static int lexer_parse(const char *line, char ***argv, int *argc)
+{
+    Token *tokens;
+    Redirect *redirects[MAX_ARG_COUNT];
+    int argv_count;
+    int words = 0;
+    int background;
+
+    arena_reset(&line_arena);
+    int count = lex_line(line, &tokens);
+    parse_tokens(arena_strdup(&line_arena, line), tokens, count, argv, argc, redirects, &argv_count, &background);
+    for (int i = 0; i < argv_count; i++)
+        words += argc[i];
+    return words;
+}
+
+// Times iterations parses of every sample line and prints ns per line
+static double run(const char *label, int (*parse)(const char *, char ***, int *), int iterations)
+{
+    char **argv[MAX_ARG_COUNT];
+    int argc[MAX_ARG_COUNT];
+    int lines = sizeof(sample_lines) / sizeof(sample_lines[0]);
+    long words = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (int j = 0; j < lines; j++)
+            words += parse(sample_lines[j], argv, argc);
+    }
+    double elapsed = now_seconds() - start;
+
+    double ns = elapsed * 1e9 / ((double)iterations * lines);
+    printf("%-14s %8.1f ns/line (%ld words)\n", label, ns, words);
+    return ns;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+
+    printf("lexer benchmark: %d iterations over %zu lines\n", iterations, sizeof(sample_lines) / sizeof(sample_lines[0]));
+    double before = run("split_string", legacy_parse, iterations);
+    double after = run("lexer", lexer_parse, iterations);
+    printf("speedup        %.2fx\n", before / after);
+    return 0;
+}
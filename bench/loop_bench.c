@@ -0,0 +1,136 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Runs a 10k-iteration loop (four nested for loops of ten) through the shell, parsed once and walked
+// as a tree, against the same body unrolled into one line per command that is lexed and parsed every time;
+// then a counting while loop whose condition is the test builtin against the same loop calling /usr/bin/test,
+// and the builtin loop running a pipeline of two builtins on every iteration
+
+#define LOOP_WIDTH 10
+#define BODY_REPEAT 3
+#define COUNT_BUILTIN 100000
+#define COUNT_EXTERNAL 2000
+#define COUNT_PIPELINE 20000
+
+static const char *digits = "0 1 2 3 4 5 6 7 8 9";
+
+// Writes the body of one iteration: builtin-only commands, so no time goes into forking
+static void write_body(FILE *out, const char *indent)
+{
+    for (int i = 0; i < BODY_REPEAT; i++)
+    {
+        fprintf(out, "%s$v = \"value $d\"\n", indent);
+        fprintf(out, "%secho $a $b $c $d\n", indent);
+    }
+}
+
+// Writes the nested loop version
+static int write_loop_script(char *path)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    fprintf(out, "for a in %s\ndo\n", digits);
+    fprintf(out, "  for b in %s\n  do\n", digits);
+    fprintf(out, "    for c in %s\n    do\n", digits);
+    fprintf(out, "      for d in %s\n      do\n", digits);
+    write_body(out, "        ");
+    fprintf(out, "      done\n    done\n  done\ndone\n");
+    fclose(out);
+    return 0;
+}
+
+// Writes the unrolled version, setting the loop variables the way the loops would
+static int write_unrolled_script(char *path)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    for (int i = 0; i < LOOP_WIDTH * LOOP_WIDTH * LOOP_WIDTH * LOOP_WIDTH; i++)
+    {
+        fprintf(out, "$a = %d\n$b = %d\n$c = %d\n$d = %d\n", i / 1000, i / 100 % 10, i / 10 % 10, i % 10);
+        write_body(out, "");
+    }
+    fclose(out);
+    return 0;
+}
+
+// Writes a while loop counting to limit with $(( )), testing the counter with test_command and running body
+static int write_count_script(char *path, const char *test_command, const char *body, int limit)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    fprintf(out, "$i = 0\nwhile %s $i -lt %d; do\n  %s\n  $i = $((i + 1))\ndone\n", test_command, limit, body);
+    fclose(out);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *shell = argc > 1 ? argv[1] : "./myshell";
+    char loop_path[] = "/tmp/myshell_loop_bench_XXXXXX";
+    char unrolled_path[] = "/tmp/myshell_unrolled_bench_XXXXXX";
+    int iterations = LOOP_WIDTH * LOOP_WIDTH * LOOP_WIDTH * LOOP_WIDTH;
+
+    if (write_loop_script(loop_path) == -1 || write_unrolled_script(unrolled_path) == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+
+    printf("loop benchmark: %d iterations of %d commands through %s\n", iterations, BODY_REPEAT * 2, shell);
+    double loop_time = run_shell(shell, loop_path, 0);
+    printf("%-10s %8.3f s %10.0f iterations/s %8.2f us/iteration\n", "loop", loop_time, iterations / loop_time,
+           loop_time * 1e6 / iterations);
+    double unrolled_time = run_shell(shell, unrolled_path, 0);
+    printf("%-10s %8.3f s %10.0f iterations/s %8.2f us/iteration\n", "unrolled", unrolled_time,
+           iterations / unrolled_time, unrolled_time * 1e6 / iterations);
+
+    unlink(loop_path);
+    unlink(unrolled_path);
+
+    // The builtin never forks, the external test forks once per iteration
+    char builtin_path[] = "/tmp/myshell_count_bench_XXXXXX";
+    char external_path[] = "/tmp/myshell_count_bench_XXXXXX";
+    if (write_count_script(builtin_path, "test", "", COUNT_BUILTIN) == -1 ||
+        write_count_script(external_path, "/usr/bin/test", "", COUNT_EXTERNAL) == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+
+    printf("\ncondition benchmark: while test $i -lt N; do $i = $((i + 1)); done\n");
+    double builtin_time = run_shell(shell, builtin_path, 0);
+    printf("%-10s %8.3f s %10.0f iterations/s %8.2f us/iteration\n", "builtin", builtin_time,
+           COUNT_BUILTIN / builtin_time, builtin_time * 1e6 / COUNT_BUILTIN);
+    double external_time = run_shell(shell, external_path, 0);
+    printf("%-10s %8.3f s %10.0f iterations/s %8.2f us/iteration\n", "external", external_time,
+           COUNT_EXTERNAL / external_time, external_time * 1e6 / COUNT_EXTERNAL);
+
+    unlink(builtin_path);
+    unlink(external_path);
+
+    // A pipeline of builtins runs inside the shell, passing its data through an in-memory file
+    char pipeline_path[] = "/tmp/myshell_pipeline_bench_XXXXXX";
+    if (write_count_script(pipeline_path, "test", "echo $i | read v", COUNT_PIPELINE) == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+
+    printf("\npipeline benchmark: echo $i | read v in the same loop\n");
+    double pipeline_time = run_shell(shell, pipeline_path, 0) - builtin_time * COUNT_PIPELINE / COUNT_BUILTIN;
+    printf("%-10s %8.3f s %10.0f pipelines/s %8.2f us/pipeline\n", "builtins", pipeline_time,
+           COUNT_PIPELINE / pipeline_time, pipeline_time * 1e6 / COUNT_PIPELINE);
+
+    unlink(pipeline_path);
+    return 0;
+}
@@ -0,0 +1,332 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Microbenchmarks of the shell's hot paths, linked against its objects: each case is run in rounds long
+// enough to time, the fastest round is kept, and the result is reported in ns/op and allocations/op
+// Given a baseline file (an earlier run's output), every case is compared to it and the run fails when one
+// got more than REGRESSION_PERCENT slower or allocates more
+
+#define ROUNDS 5
+#define MIN_ROUND_SECONDS 0.05
+#define REGRESSION_PERCENT 20
+#define VARIABLE_COUNT 100
+#define SCRIPT_LINES 100
+#define MAX_BASELINE_CASES 64
+
+// Allocations made through malloc, calloc and realloc, counted by the --wrap'ed allocators below
+static unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*run)(long iterations);
+    int ops_per_iteration; // operations one iteration stands for, e.g. the lines of a script
+} BenchCase;
+
+typedef struct
+{
+    char name[64];
+    double ns_per_op;
+    double allocs_per_op;
+} BaselineEntry;
+
+static BaselineEntry baseline[MAX_BASELINE_CASES];
+static int baseline_count;
+static char script[SCRIPT_LINES * 64];
+static size_t script_size;
+static char line_buffer[MAX_COMMAND_LENGTH];
+
+// Copies line into a writable buffer, as run_line() may modify it, and runs it
+static void run_command(const char *line)
+{
+    snprintf(line_buffer, sizeof(line_buffer), "%s", line);
+    run_line(line_buffer);
+}
+
+// Splits a pipeline into stages and each stage into words, as the shell did before the lexer
+static void bench_split_string(long iterations)
+{
+    int stage_count;
+    int word_count;
+
+    for (long i = 0; i < iterations; i++)
+    {
+        char **stages = split_string("ls -l /tmp | grep -v foo | sort -r | uniq -c", '|', &stage_count);
+        for (int j = 0; j < stage_count; j++)
+            split_string(stages[j], ' ', &word_count);
+        arena_reset(&line_arena);
+    }
+}
+
+// Lexes and parses a pipeline with a redirection into per-stage argument vectors
+static void bench_parse_command(long iterations)
+{
+    char **rows[MAX_ARG_COUNT];
+    char ***argv = rows;
+    int argc[MAX_ARG_COUNT];
+    int argv_count;
+    char line[] = "ls -l /tmp | grep -v 'foo bar' | sort -r > /tmp/out.txt";
+
+    for (long i = 0; i < iterations; i++)
+    {
+        parse_command(line, &argv, argc, &argv_count);
+        arena_reset(&line_arena);
+    }
+}
+
+// Expands a word mixing literal text and variables, as every marked argument is
+static void bench_expand_word(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        expand_word("$v7/dir/${v42}_suffix.txt");
+        arena_reset(&line_arena);
+    }
+}
+
+// Expands and splits a word whose variable holds several fields
+static void bench_expand_fields(long iterations)
+{
+    char **fields;
+
+    for (long i = 0; i < iterations; i++)
+    {
+        expand_fields("$words", &fields);
+        arena_reset(&line_arena);
+    }
+}
+
+// Looks up a variable among VARIABLE_COUNT others
+static void bench_variable_lookup(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        if (get_variable_value("$v57") == NULL)
+            abort();
+    }
+}
+
+// Overwrites an existing variable with a value of the same length
+static void bench_variable_assign(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        set_variable_value("$v57", "value57");
+}
+
+// Adds a line to the history ring and appends it to the history file
+static void bench_add_to_history(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        add_to_history("git log --oneline | head -20");
+}
+
+// Runs a builtin-only line through run_line(): lexing, parsing and evaluating without a fork
+static void bench_run_builtin(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        run_command("$x = 1; [ $x = 1 ]");
+}
+
+// Calls a shell function defined once in setup(), whose body is walked from its stored tree
+static void bench_function_call(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        run_command("setx 1");
+}
+
+// Runs an external command, timing the whole launch and wait
+static void bench_spawn(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        run_command("/bin/true");
+}
+
+// Runs a three stage pipeline of external commands
+static void bench_pipeline(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        run_command("/bin/true | /bin/true | /bin/true");
+}
+
+// Runs a script of SCRIPT_LINES builtin lines from memory, as a script file is run once mapped
+static void bench_script(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        run_script_buffer(script, script_size);
+}
+
+static const BenchCase cases[] = {
+    {"split_string", bench_split_string, 1},
+    {"parse_command", bench_parse_command, 1},
+    {"expand_word", bench_expand_word, 1},
+    {"expand_fields", bench_expand_fields, 1},
+    {"variable_lookup", bench_variable_lookup, 1},
+    {"variable_assign", bench_variable_assign, 1},
+    {"add_to_history", bench_add_to_history, 1},
+    {"run_line_builtin", bench_run_builtin, 1},
+    {"function_call", bench_function_call, 1},
+    {"spawn", bench_spawn, 1},
+    {"pipeline", bench_pipeline, 1},
+    {"script_line", bench_script, SCRIPT_LINES},
+};
+
+// Builds the variables, history file and script the cases use; returns the history file to remove later
+static char *setup(void)
+{
+    static char history_path[] = "/tmp/myshell_micro_history_XXXXXX";
+    char name[16];
+    char value[16];
+
+    for (int i = 0; i < VARIABLE_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "$v%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        set_variable_value(name, value);
+    }
+    set_variable_value("$words", "alpha beta gamma delta epsilon");
+
+    int fd = mkstemp(history_path);
+    if (fd == -1)
+    {
+        perror("mkstemp");
+        exit(1);
+    }
+    close(fd);
+    set_variable_value("$HISTFILE", history_path);
+    history_init();
+
+    for (int i = 0; i < SCRIPT_LINES; i++)
+    {
+        const char *line = i % 3 == 0 ? "$a = %d" : i % 3 == 1 ? "[ $a -lt 100 ] # check %d" : "$b = $a; $c = %d";
+        script_size += snprintf(script + script_size, sizeof(script) - script_size, line, i);
+        script[script_size++] = '\n';
+    }
+
+    jobs_init();
+    run_command("setx() { local y=$1; $x = $y; }");
+    return history_path;
+}
+
+// Reads an earlier run's output; lines that are not results are skipped
+static int load_baseline(const char *path)
+{
+    char line[256];
+    FILE *in = fopen(path, "r");
+
+    if (in == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while (baseline_count < MAX_BASELINE_CASES && fgets(line, sizeof(line), in) != NULL)
+    {
+        BaselineEntry *entry = &baseline[baseline_count];
+        if (sscanf(line, "%63s %lf ns/op %lf allocs/op", entry->name, &entry->ns_per_op, &entry->allocs_per_op) == 3)
+            baseline_count++;
+    }
+    fclose(in);
+    return 0;
+}
+
+// Returns the baseline entry for a case, or NULL when the baseline does not have it
+static const BaselineEntry *find_baseline(const char *name)
+{
+    for (int i = 0; i < baseline_count; i++)
+    {
+        if (strcmp(baseline[i].name, name) == 0)
+            return &baseline[i];
+    }
+    return NULL;
+}
+
+// Times one case and prints its result; returns 1 when it regressed against the baseline
+static int run_case(const BenchCase *bench)
+{
+    long iterations = 1;
+    double best_ns = 0;
+    double best_allocs = 0;
+
+    // Double the iterations until a round is long enough for the clock, which also warms up caches and tables
+    while (1)
+    {
+        double start = now_seconds();
+        bench->run(iterations);
+        if (now_seconds() - start >= MIN_ROUND_SECONDS)
+            break;
+        iterations *= 2;
+    }
+
+    double ops = (double)iterations * bench->ops_per_iteration;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        unsigned long allocations_before = allocations;
+        double start = now_seconds();
+        bench->run(iterations);
+        double ns = (now_seconds() - start) * 1e9 / ops;
+        double allocs = (allocations - allocations_before) / ops;
+
+        if (round == 0 || ns < best_ns)
+            best_ns = ns;
+        if (round == 0 || allocs < best_allocs)
+            best_allocs = allocs;
+    }
+
+    printf("%-18s %12.1f ns/op %8.2f allocs/op", bench->name, best_ns, best_allocs);
+
+    const BaselineEntry *before = find_baseline(bench->name);
+    int regressed = 0;
+    if (before != NULL)
+    {
+        double change = before->ns_per_op > 0 ? (best_ns / before->ns_per_op - 1) * 100 : 0;
+        regressed = change > REGRESSION_PERCENT || best_allocs > before->allocs_per_op + 0.005;
+        printf(" %+7.1f%%%s", change, regressed ? " REGRESSION" : "");
+    }
+    printf("\n");
+    fflush(stdout);
+    return regressed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && load_baseline(argv[1]) == -1)
+        return 2;
+
+    char *history_path = setup();
+    int regressions = 0;
+
+    printf("micro benchmark: best of %d rounds of at least %.0f ms each\n", ROUNDS, MIN_ROUND_SECONDS * 1000);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        regressions += run_case(&cases[i]);
+
+    unlink(history_path);
+    if (regressions > 0)
+    {
+        printf("%d case(s) regressed more than %d%% or allocate more than the baseline\n", regressions,
+               REGRESSION_PERCENT);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Measures pipeline throughput: gigabytes of zeros pushed through four stages, with the default pipe
+// buffers, with set pipebuf=1M, and with a tee stage run by the builtin (tee(2) and splice(2)) against
+// the external tee copying through user space
+
+#define DEFAULT_GIGABYTES 2
+
+// Writes a script of an optional setup line and a pipeline, with %ld in the pipeline replaced by bytes
+static int write_script(char *path, const char *setup, const char *pipeline, long bytes)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    if (setup != NULL)
+        fprintf(out, "%s\n", setup);
+    fprintf(out, pipeline, bytes);
+    fprintf(out, "\n");
+    fclose(out);
+    return 0;
+}
+
+// Times one pipeline and prints its throughput
+static void run_case(const char *shell, const char *label, const char *setup, const char *pipeline, long bytes)
+{
+    char script_path[] = "/tmp/myshell_pipe_script_XXXXXX";
+    if (write_script(script_path, setup, pipeline, bytes) == -1)
+    {
+        perror("mkstemp");
+        return;
+    }
+
+    double elapsed = run_shell(shell, script_path, 0);
+    printf("%-14s %8.3f s %8.2f GB/s\n", label, elapsed, bytes / elapsed / 1e9);
+    unlink(script_path);
+}
+
+int main(int argc, char *argv[])
+{
+    int gigabytes = argc > 1 ? atoi(argv[1]) : DEFAULT_GIGABYTES;
+    const char *shell = argc > 2 ? argv[2] : "./myshell";
+    long bytes = gigabytes * 1000000000L;
+
+    printf("pipe benchmark: %d GB through 4 stages with %s\n", gigabytes, shell);
+    run_case(shell, "default", NULL, "head -c %ld /dev/zero | cat | cat | cat > /dev/null", bytes);
+    run_case(shell, "pipebuf=1M", "set pipebuf=1M", "head -c %ld /dev/zero | cat | cat | cat > /dev/null", bytes);
+    run_case(shell, "tee builtin", NULL, "head -c %ld /dev/zero | tee /dev/null | cat | cat > /dev/null", bytes);
+    run_case(shell, "tee external", NULL, "head -c %ld /dev/zero | /usr/bin/tee /dev/null | cat | cat > /dev/null",
+             bytes);
+    run_case(shell, "tee 1M", "set pipebuf=1M", "head -c %ld /dev/zero | tee /dev/null | cat | cat > /dev/null",
+             bytes);
+    return 0;
+}
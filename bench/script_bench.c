@@ -0,0 +1,62 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Measures non-interactive throughput: a generated script of builtin-only lines is run
+// by the shell as a script file and again through a pipe on stdin
+
+#define DEFAULT_LINES 100000
+
+// Writes a script of lines lines mixing assignments, echo, comments and ';' lists
+static int write_script(char *path, int lines)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    for (int i = 0; i < lines; i++)
+    {
+        switch (i % 4)
+        {
+        case 0:
+            fprintf(out, "$v%d = value%d\n", i % 100, i);
+            break;
+        case 1:
+            fprintf(out, "echo line %d $v%d\n", i, (i - 1) % 100);
+            break;
+        case 2:
+            fprintf(out, "# comment %d\n", i);
+            break;
+        default:
+            fprintf(out, "$a = \"quoted | text\" ; echo $a\n");
+            break;
+        }
+    }
+    fclose(out);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : DEFAULT_LINES;
+    const char *shell = argc > 2 ? argv[2] : "./myshell";
+    char path[] = "/tmp/myshell_script_bench_XXXXXX";
+
+    if (write_script(path, lines) == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+
+    printf("script benchmark: %d lines through %s\n", lines, shell);
+    double file_time = run_shell(shell, path, 0);
+    printf("%-10s %8.3f s %10.0f lines/s %8.2f us/line\n", "file", file_time, lines / file_time,
+           file_time * 1e6 / lines);
+    double pipe_time = run_shell(shell, path, 1);
+    printf("%-10s %8.3f s %10.0f lines/s %8.2f us/line\n", "stdin", pipe_time, lines / pipe_time,
+           pipe_time * 1e6 / lines);
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Compares fork() + execvp() against the posix_spawn launcher from a process with a large, touched heap,
+// which is what makes fork expensive for the shell (page tables are copied, spawn shares them)
+
+#define DEFAULT_SPAWNS 2000
+#define DEFAULT_HEAP_MB 64
+
+// The old exec path: fork a full copy of the process, then exec
+static void spawn_with_fork(char **argv)
+{
+    int status;
+    pid_t child = fork();
+    if (child == 0)
+    {
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    waitpid(child, &status, 0);
+}
+
+// The new exec path through the launcher subsystem
+static void spawn_with_launcher(char **argv)
+{
+    LaunchPlan plan;
+    int status;
+
+    launch_plan_init(&plan, -1);
+    pid_t child = launch_command(argv, &plan);
+    if (child > 0)
+        waitpid(child, &status, 0);
+}
+
+// Times count launches through one path and prints the spawn rate
+static double run(const char *label, void (*spawn)(char **), char **argv, int count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < count; i++)
+        spawn(argv);
+    double elapsed = now_seconds() - start;
+
+    printf("%-10s %8d spawns %8.3f s %10.0f spawns/s %8.1f us/spawn\n", label, count, elapsed, count / elapsed,
+           elapsed * 1e6 / count);
+    return count / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_SPAWNS;
+    size_t heap_mb = argc > 2 ? (size_t)atoi(argv[2]) : DEFAULT_HEAP_MB;
+    char *command[] = {"true", NULL};
+
+    // Simulate a bloated shell: touch every page so it is really mapped
+    char *heap = malloc(heap_mb << 20);
+    if (heap == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    memset(heap, 1, heap_mb << 20);
+
+    printf("spawn benchmark: %d x '%s' with %zu MB resident heap\n", count, command[0], heap_mb);
+    double before = run("fork", spawn_with_fork, command, count);
+    double after = run("launcher", spawn_with_launcher, command, count);
+    printf("speedup    %.2fx\n", after / before);
+
+    free(heap);
+    return 0;
+}
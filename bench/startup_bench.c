@@ -0,0 +1,143 @@
+#include "myshell.h"
+
+#include <pty.h>
+
+#include "harness.h"
+
+// Measures startup: the latency and peak memory of "myshell -c true", and of an interactive shell on a
+// pseudo-terminal loading a generated rc file, once run line by line and once replayed from its snapshot
+
+#define DEFAULT_RUNS 200
+#define RC_LINES 300
+
+// Waits for child and returns the elapsed time since start, storing its peak memory
+static double finish(pid_t child, double start, long *max_rss)
+{
+    struct rusage usage;
+    int status;
+
+    wait4(child, &status, 0, &usage);
+    *max_rss = usage.ru_maxrss;
+    return now_seconds() - start;
+}
+
+// Starts the shell for a single command and waits for it
+static double run_command(const char *shell, long *max_rss)
+{
+    double start = now_seconds();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        execl(shell, shell, "-c", "true", (char *)NULL);
+        _exit(127);
+    }
+    return finish(child, start, max_rss);
+}
+
+// Starts an interactive shell reading rc_path on a pseudo-terminal, has it quit, and waits for it
+static double run_interactive(const char *shell, const char *rc_path, long *max_rss)
+{
+    char buffer[4096];
+    int master;
+
+    double start = now_seconds();
+    pid_t child = forkpty(&master, NULL, NULL, NULL);
+    if (child == 0)
+    {
+        setenv("MYSHELLRC", rc_path, 1);
+        setenv("HISTFILE", "/dev/null", 1);
+        execl(shell, shell, (char *)NULL);
+        _exit(127);
+    }
+    if (child == -1)
+    {
+        perror("forkpty");
+        exit(1);
+    }
+
+    // Typed ahead, the line waits in the terminal until the shell reads it
+    if (write(master, "quit\n", 5) != 5)
+        perror("write");
+    while (read(master, buffer, sizeof(buffer)) > 0)
+        ;
+    close(master);
+    return finish(child, start, max_rss);
+}
+
+// Writes an rc file of RC_LINES lines that only set variables and options, so it can be snapshotted
+static int write_rc(char *path)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    fprintf(out, "# generated rc file\nset -o pipefail\nprompt = bench:\n");
+    for (int i = 0; i < RC_LINES; i++)
+    {
+        if (i % 3 == 2)
+            fprintf(out, "export v%d\n", i - 1);
+        else
+            fprintf(out, "$v%d = \"$HOME/value %d\"\n", i, i);
+    }
+    fclose(out);
+    return 0;
+}
+
+// Prints the mean latency of a case and the largest peak memory seen
+static void report(const char *label, double total, long max_rss, int runs)
+{
+    printf("%-18s %10.1f us/start %8ld KB max RSS\n", label, total * 1e6 / runs, max_rss);
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = argc > 1 ? atoi(argv[1]) : DEFAULT_RUNS;
+    const char *shell = argc > 2 ? argv[2] : "./myshell";
+    char rc_path[] = "/tmp/myshell_startup_rc_XXXXXX";
+    char snapshot_path[sizeof(rc_path) + sizeof(".snapshot")];
+    double total;
+    long rss;
+    long max_rss;
+
+    if (write_rc(rc_path) == -1)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s.snapshot", rc_path);
+
+    printf("startup benchmark: %d starts of %s, rc file of %d lines\n", runs, shell, RC_LINES);
+
+    total = 0;
+    max_rss = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        total += run_command(shell, &rss);
+        max_rss = rss > max_rss ? rss : max_rss;
+    }
+    report("-c true", total, max_rss, runs);
+
+    total = 0;
+    max_rss = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        unlink(snapshot_path);
+        total += run_interactive(shell, rc_path, &rss);
+        max_rss = rss > max_rss ? rss : max_rss;
+    }
+    report("rc run", total, max_rss, runs);
+
+    total = 0;
+    max_rss = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        total += run_interactive(shell, rc_path, &rss);
+        max_rss = rss > max_rss ? rss : max_rss;
+    }
+    report("rc snapshot", total, max_rss, runs);
+
+    unlink(snapshot_path);
+    unlink(rc_path);
+    return 0;
+}
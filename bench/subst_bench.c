@@ -0,0 +1,79 @@
+#include "myshell.h"
+
+#include "harness.h"
+
+// Measures command substitution on multi-megabyte outputs: capturing a file's contents into a variable,
+// and capturing and splitting them into words, against plain cat with its output thrown away
+
+#define REPEAT 10
+
+static const int sizes_mb[] = {1, 8, 32};
+
+// Writes size_mb megabytes of short words, eight to a line
+static int write_data(char *path, int size_mb)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    long written = 0;
+    for (long i = 0; written < size_mb * 1048576L; i++)
+        written += fprintf(out, i % 8 == 7 ? "w%06ld\n" : "w%06ld ", i % 1000000);
+    fclose(out);
+    return 0;
+}
+
+// Writes a script running command REPEAT times, with %s in it replaced by the data file
+static int write_script(char *path, const char *command, const char *data_path)
+{
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+
+    FILE *out = fdopen(fd, "w");
+    for (int i = 0; i < REPEAT; i++)
+    {
+        fprintf(out, command, data_path);
+        fprintf(out, "\n");
+    }
+    fclose(out);
+    return 0;
+}
+
+// Times one command over the data file and prints its throughput
+static void run_case(const char *shell, const char *label, const char *command, const char *data_path, int size_mb)
+{
+    char script_path[] = "/tmp/myshell_subst_script_XXXXXX";
+    if (write_script(script_path, command, data_path) == -1)
+    {
+        perror("mkstemp");
+        return;
+    }
+
+    double elapsed = run_shell(shell, script_path, 0);
+    printf("%-10s %4d MB %8.3f s %10.1f MB/s\n", label, size_mb, elapsed, size_mb * REPEAT / elapsed);
+    unlink(script_path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *shell = argc > 1 ? argv[1] : "./myshell";
+
+    printf("substitution benchmark: %d runs per size through %s\n", REPEAT, shell);
+    for (size_t i = 0; i < sizeof(sizes_mb) / sizeof(sizes_mb[0]); i++)
+    {
+        char data_path[] = "/tmp/myshell_subst_data_XXXXXX";
+        if (write_data(data_path, sizes_mb[i]) == -1)
+        {
+            perror("mkstemp");
+            return 1;
+        }
+
+        run_case(shell, "cat", "cat %s > /dev/null", data_path, sizes_mb[i]);
+        run_case(shell, "capture", "$x = $(cat %s)", data_path, sizes_mb[i]);
+        run_case(shell, "split", "echo $(cat %s) > /dev/null", data_path, sizes_mb[i]);
+        unlink(data_path);
+    }
+    return 0;
+}
@@ -0,0 +1,422 @@
+#include "myshell.h"
+
+// Performs one file action in the calling process, returns -1 after reporting a failure
+static int apply_action(const FdAction *action)
+{
+    int fd;
+
+    switch (action->type)
+    {
+    case FD_ACTION_DUP:
+        if (dup2(action->src_fd, action->fd) == -1)
+        {
+            perror("dup2");
+            return -1;
+        }
+        break;
+    case FD_ACTION_OPEN:
+        fd = open(action->path, action->flags, 0660);
+        if (fd == -1)
+        {
+            perror(action->path);
+            return -1;
+        }
+        if (fd != action->fd)
+        {
+            dup2(fd, action->fd);
+            close(fd);
+        }
+        break;
+    case FD_ACTION_CLOSE:
+        close(action->fd);
+        break;
+    }
+    return 0;
+}
+
+// Returns 1 when the plan changes descriptor fd
+static int plan_touches(const LaunchPlan *plan, int fd)
+{
+    for (int i = 0; i < plan->action_count; i++)
+    {
+        if (plan->actions[i].fd == fd)
+            return 1;
+    }
+    return 0;
+}
+
+// Status of the command before the running builtin, which starts from 0
+int status_before_builtin = 0;
+
+// Runs a builtin inside the shell with the plan's descriptors swapped in, then puts the shell's own back
+// The builtin's status is left in last_exit_status
+void run_builtin(const Builtin *builtin, char **argv, const LaunchPlan *plan)
+{
+    int inline_fds[MAX_FD_ACTIONS * 2];
+    int *fds = inline_fds;
+    int saved_count = 0;
+    struct sigaction ignore;
+    struct sigaction old_pipe;
+
+    status_before_builtin = last_exit_status;
+    last_exit_status = 0;
+    if (plan->action_count == 0)
+    {
+        builtin->run(argv);
+        return;
+    }
+
+    // Each descriptor the plan changes is saved once; a plan that outgrew its inline actions needs more room
+    if (plan->action_count > MAX_FD_ACTIONS)
+        fds = arena_alloc(&line_arena, plan->action_count * 2 * sizeof(int));
+    int *saved = fds + plan->action_count;
+
+    // A reader that is gone makes writes fail with EPIPE instead of killing the shell
+    fflush(stdout);
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &old_pipe);
+
+    int failed = 0;
+    for (int i = 0; i < plan->action_count && !failed; i++)
+    {
+        const FdAction *action = &plan->actions[i];
+        int known = 0;
+        for (int j = 0; j < saved_count; j++)
+            known |= fds[j] == action->fd;
+        if (!known)
+        {
+            // -1 records a descriptor that was closed, to be closed again
+            fds[saved_count] = action->fd;
+            saved[saved_count++] = fcntl(action->fd, F_DUPFD_CLOEXEC, 10);
+        }
+        failed = apply_action(action) == -1;
+    }
+
+    if (failed)
+        last_exit_status = 1;
+    else
+    {
+        input_redirected = plan_touches(plan, STDIN_FILENO);
+        builtin->run(argv);
+        input_redirected = 0;
+    }
+
+    fflush(stdout);
+    clearerr(stdout);
+    for (int j = saved_count - 1; j >= 0; j--)
+    {
+        if (saved[j] == -1)
+            close(fds[j]);
+        else
+        {
+            dup2(saved[j], fds[j]);
+            close(saved[j]);
+        }
+    }
+    sigaction(SIGPIPE, &old_pipe, NULL);
+}
+
+// Runs a builtin in a forked copy of the shell, for a pipeline stage that has to run alongside the others
+// Returns the child pid, or -1 with errno set
+pid_t launch_builtin(const Builtin *builtin, char **argv, const LaunchPlan *plan)
+{
+    sigset_t mask;
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child != 0)
+    {
+        // Set the group from both sides so it is in place whichever runs first
+        if (child > 0 && plan->pgid >= 0)
+            setpgid(child, plan->pgid == 0 ? child : plan->pgid);
+        return child;
+    }
+
+    if (plan->pgid >= 0)
+        setpgid(0, plan->pgid);
+    for (int i = 0; child_default_signals[i] != 0; i++)
+        signal(child_default_signals[i], SIG_DFL);
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    for (int i = 0; i < plan->action_count; i++)
+    {
+        if (apply_action(&plan->actions[i]) == -1)
+            _exit(1);
+    }
+
+    // Only the stage's own descriptors stay open, so the pipes it does not use see their end of file; the
+    // trace descriptor goes with them
+    close_range(3, ~0U, 0);
+    trace_fd = -1;
+    interactive = 0;
+
+    // A builtin that starts commands of its own, like a function or parallel, reaps them with a fresh job table
+    jobs_forget();
+    jobs_init();
+    coprocs_forget();
+    input_redirected = plan_touches(plan, STDIN_FILENO);
+    last_exit_status = 0;
+    builtin->run(argv);
+    fflush(stdout);
+    _exit(last_exit_status);
+}
+
+// Returns the number of words in argv
+static int word_count(char **argv)
+{
+    int argc = 0;
+    while (argv[argc] != NULL)
+        argc++;
+    return argc;
+}
+
+// prompt = name: changes the prompt to the last word
+static void prompt_builtin(char **argv)
+{
+    int argc = word_count(argv);
+    if (argc < 2)
+    {
+        fprintf(stderr, "prompt: usage: prompt = name\n");
+        last_exit_status = 2;
+        return;
+    }
+
+    char *name = my_strdup(argv[argc - 1]);
+    if (name == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    free(prompt_name);
+    prompt_name = name;
+}
+
+// Prints the arguments separated by spaces
+static void echo_builtin(char **argv)
+{
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        printf(i > 1 ? " %s" : "%s", argv[i]);
+    }
+    printf("\n");
+}
+
+// Changes directory, to $HOME without an argument
+static void cd_builtin(char **argv)
+{
+    const char *dir = argv[1] != NULL ? argv[1] : get_variable_value("$HOME");
+    if (dir == NULL)
+    {
+        fprintf(stderr, "cd: HOME not set\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (chdir(dir) != 0)
+    {
+        perror("chdir failed");
+        last_exit_status = 1;
+    }
+}
+
+// Applies set pipebuf=SIZE: SIZE in bytes with an optional K, M or G suffix, 0 for the system default
+// The size is tried on a scratch pipe first, so a size the system refuses is reported here, once
+static void set_pipe_buffer(const char *value)
+{
+    char *end;
+    long size = strtol(value, &end, 10);
+    int shift = end == value ? 0 : *end == 'K' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : 0;
+    int fildes[2];
+
+    if (shift > 0)
+        end++;
+    if (end == value || size < 0 || *end != '\0' || size > (INT_MAX >> shift))
+    {
+        fprintf(stderr, "set: pipebuf: invalid size '%s'\n", value);
+        last_exit_status = 2;
+        return;
+    }
+    size <<= shift;
+    if (size == 0)
+    {
+        pipe_buffer_size = 0;
+        return;
+    }
+
+    if (pipe2(fildes, O_CLOEXEC) == -1)
+    {
+        perror("set: pipebuf");
+        last_exit_status = 1;
+        return;
+    }
+    // The kernel rounds the size up to a power of two pages, keep what it actually gives
+    int granted = fcntl(fildes[1], F_SETPIPE_SZ, (int)size);
+    if (granted == -1)
+    {
+        perror("set: pipebuf");
+        last_exit_status = 1;
+    }
+    else
+        pipe_buffer_size = granted;
+    close(fildes[0]);
+    close(fildes[1]);
+}
+
+// set -o|+o pipefail / set -o|+o noglob / set pipebuf=SIZE / set trace=FILE, with an empty FILE to stop tracing
+static void set_builtin(char **argv)
+{
+    if (word_count(argv) == 3 && strcmp(argv[2], "pipefail") == 0 && strcmp(argv[1], "-o") == 0)
+        pipefail = 1;
+    else if (word_count(argv) == 3 && strcmp(argv[2], "pipefail") == 0 && strcmp(argv[1], "+o") == 0)
+        pipefail = 0;
+    else if (word_count(argv) == 3 && strcmp(argv[2], "noglob") == 0 && strcmp(argv[1], "-o") == 0)
+        noglob = 1;
+    else if (word_count(argv) == 3 && strcmp(argv[2], "noglob") == 0 && strcmp(argv[1], "+o") == 0)
+        noglob = 0;
+    else if (word_count(argv) == 2 && strncmp(argv[1], "pipebuf=", 8) == 0)
+        set_pipe_buffer(argv[1] + 8);
+    else if (word_count(argv) == 2 && strncmp(argv[1], "trace=", 6) == 0)
+    {
+        if (argv[1][6] == '\0')
+            trace_close();
+        else if (trace_open(argv[1] + 6) == -1)
+            last_exit_status = 1;
+    }
+    else
+    {
+        fprintf(stderr, "set: usage: set -o|+o pipefail|noglob, set pipebuf=SIZE, set trace=FILE\n");
+        last_exit_status = 2;
+    }
+}
+
+// Shows the memory used by the current line
+static void memstats_builtin(char **argv)
+{
+    (void)argv;
+    arena_stats(&line_arena);
+}
+
+// Leaves the shell
+static void quit_builtin(char **argv)
+{
+    (void)argv;
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+}
+
+// exit [n]: leaves the shell with status n, or with the last command's status
+static void exit_builtin(char **argv)
+{
+    fflush(stdout);
+    exit(argv[1] != NULL ? atoi(argv[1]) & 0xff : status_before_builtin);
+}
+
+// read [-u fd] name: reads one line, from descriptor fd instead of standard input with -u, into $name,
+// failing at end of input so "while read line" loops stop
+static void read_builtin(char **argv)
+{
+    char value[MAX_COMMAND_LENGTH];
+    char name[MAX_COMMAND_LENGTH];
+    int fd = -1;
+
+    if (argv[1] != NULL && strcmp(argv[1], "-u") == 0)
+    {
+        fd = argv[2] != NULL ? redirect_source(argv[2]) : -2;
+        if (fd < 0)
+        {
+            fprintf(stderr, "read: -u: invalid file descriptor '%s'\n", argv[2] != NULL ? argv[2] : "");
+            last_exit_status = 1;
+            return;
+        }
+        argv += 2;
+    }
+    if (argv[1] == NULL)
+    {
+        fprintf(stderr, "read: usage: read [-u fd] name\n");
+        last_exit_status = 2;
+        return;
+    }
+    if ((fd != -1 ? read_fd_line(fd, value, sizeof(value)) : read_plain_line(value, sizeof(value))) == -1)
+    {
+        value[0] = '\0';
+        last_exit_status = 1;
+    }
+
+    snprintf(name, sizeof(name), "$%s", argv[1]);
+    set_variable_value(name, value);
+}
+
+// $name = value: sets a variable, the name word keeping its '$'
+static void assign_builtin(char **argv)
+{
+    int argc = word_count(argv);
+    set_variable_value(argv[argc - 3], argv[argc - 1]);
+}
+
+// Every command the shell runs itself, by name
+static const Builtin builtin_table[] = {
+    {"echo", echo_builtin, STAGE_ANY},
+    {"test", test_builtin, STAGE_ANY},
+    {"[", test_builtin, STAGE_ANY},
+    {"[[", test_builtin, STAGE_ANY},
+    {"read", read_builtin, STAGE_LAST},
+    {"cd", cd_builtin, STAGE_FORKED},
+    {"prompt", prompt_builtin, STAGE_FORKED},
+    {"set", set_builtin, STAGE_FORKED},
+    {"export", export_builtin, STAGE_FORKED},
+    {"unset", unset_builtin, STAGE_FORKED},
+    {"hash", hash_builtin, STAGE_FORKED},
+    {"jobs", jobs_builtin, STAGE_ANY},
+    {"fg", fg_builtin, STAGE_FORKED},
+    {"bg", bg_builtin, STAGE_FORKED},
+    {"wait", wait_builtin, STAGE_FORKED},
+    {"tee", tee_builtin, STAGE_ANY},
+    {"parallel", parallel_builtin, STAGE_ANY},
+    {"coproc", coproc_builtin, STAGE_FORKED},
+    {"local", local_builtin, STAGE_FORKED},
+    {"alias", alias_builtin, STAGE_FORKED},
+    {"unalias", unalias_builtin, STAGE_FORKED},
+    {"memstats", memstats_builtin, STAGE_ANY},
+    {"quit", quit_builtin, STAGE_FORKED},
+    {"exit", exit_builtin, STAGE_FORKED},
+    {NULL, NULL, STAGE_FORKED},
+};
+
+// Calls visit with the name of every builtin command
+void for_each_builtin(void (*visit)(const char *name))
+{
+    for (const Builtin *builtin = builtin_table; builtin->name != NULL; builtin++)
+        visit(builtin->name);
+}
+
+// A command of redirections only: nothing is left to run once its files are opened
+static void empty_builtin(char **argv)
+{
+    (void)argv;
+}
+
+static const Builtin assignment = {"=", assign_builtin, STAGE_FORKED};
+static const Builtin empty_command = {"", empty_builtin, STAGE_ANY};
+static const Builtin function_call = {"function", function_builtin, STAGE_FORKED};
+
+// Returns the builtin that runs argv, or NULL for an external command; "$name = value" is an assignment
+// A shell function comes first, so it can stand in for a builtin or a command of the same name
+const Builtin *find_builtin(char **argv)
+{
+    if (argv[0] == NULL)
+        return &empty_command;
+    if (is_function(argv[0]))
+        return &function_call;
+
+    for (const Builtin *builtin = builtin_table; builtin->name != NULL; builtin++)
+    {
+        if (strcmp(argv[0], builtin->name) == 0)
+            return builtin;
+    }
+
+    int argc = word_count(argv);
+    if (argc > 2 && strcmp(argv[argc - 2], "=") == 0)
+        return &assignment;
+    return NULL;
+}
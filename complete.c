@@ -0,0 +1,440 @@
+#include "myshell.h"
+
+#define MAX_PATH_DIRS 64
+
+// The names read from a directory, each NUL-terminated after the inode number of its entry
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+} NamePool;
+
+// The names in a directory as last read, and what identified the directory then; it is read again only once
+// its mtime or inode changes
+typedef struct
+{
+    char *path;
+    struct timespec mtime;
+    ino_t inode;
+    int scanned;
+    NamePool names;
+    char **entries; // the names in the pool, sorted
+    int count;
+} DirListing;
+
+// The executables of each PATH directory
+static DirListing path_dirs[MAX_PATH_DIRS];
+static int path_dir_count = 0;
+static char *indexed_path = NULL;
+
+// Every executable on PATH, sorted and unique, merged from the directories' entries
+static char **command_index = NULL;
+static int command_count = 0;
+
+// The directory file names were last completed in, kept so pressing Tab again does not read it again
+static DirListing file_dir;
+
+// Candidates gathered by the visit callbacks of the builtin, function and alias tables
+static const char *visit_prefix;
+static size_t visit_prefix_len;
+static char **visit_matches;
+static int visit_count;
+static int visit_capacity;
+
+// Characters that end a word, unless escaped
+static const char word_breaks[] = " \t;|&<>";
+
+// Makes sure array, holding count elements of size bytes, has room for one more; grows it on the heap
+static void *reserve(void *array, int count, int *capacity, size_t size)
+{
+    if (count < *capacity)
+        return array;
+    int grown_capacity = *capacity == 0 ? 256 : *capacity * 2;
+    void *grown = realloc(array, grown_capacity * size);
+    if (grown == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = grown_capacity;
+    return grown;
+}
+
+// Appends a name and its inode number to a pool, with a '/' after the name when is_dir is set
+static void pool_add(NamePool *pool, const char *name, ino_t inode, int is_dir)
+{
+    size_t len = strlen(name);
+    size_t needed = pool->len + sizeof(inode) + len + 2;
+    if (needed > pool->capacity)
+    {
+        size_t capacity = pool->capacity == 0 ? 4096 : pool->capacity * 2;
+        while (capacity < needed)
+            capacity *= 2;
+        char *grown = realloc(pool->data, capacity);
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        pool->data = grown;
+        pool->capacity = capacity;
+    }
+    char *out = pool->data + pool->len;
+    memcpy(out, &inode, sizeof(inode));
+    memcpy(out + sizeof(inode), name, len);
+    out[sizeof(inode) + len] = '/';
+    out[sizeof(inode) + len + is_dir] = '\0';
+    pool->len += sizeof(inode) + len + is_dir + 1;
+}
+
+// Returns 1 when the last read of dir kept name as an executable with the same inode number
+static int known_executable(const DirListing *dir, const char *name, ino_t inode)
+{
+    char *const *found = bsearch(&name, dir->entries, dir->count, sizeof(char *), compare_strings);
+    ino_t known;
+
+    if (found == NULL)
+        return 0;
+    memcpy(&known, *found - sizeof(known), sizeof(known));
+    return known == inode;
+}
+
+// A directory being read into a new name pool
+typedef struct
+{
+    const DirListing *dir;
+    NamePool *pool;
+    int executables;
+} DirScan;
+
+// Adds one entry of the directory being read to its pool. With executables set only the executables are kept:
+// the type in the entry rules out directories and the like, and files and links are checked with one
+// fstatat(2) each, except the ones kept last time under an unchanged inode number. Otherwise every name is
+// kept, and links are followed to find directories
+static void dir_scan_entry(int fd, const struct dirent64 *entry, void *context)
+{
+    DirScan *scan = context;
+    struct stat st;
+    const char *name = entry->d_name;
+    int followed = entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN;
+
+    if (!scan->executables)
+    {
+        int is_dir = entry->d_type == DT_DIR;
+        if (followed)
+            is_dir = fstatat(fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        pool_add(scan->pool, name, entry->d_ino, is_dir);
+        return;
+    }
+    if (name[0] == '.' || (entry->d_type != DT_REG && !followed))
+        return;
+    if (!known_executable(scan->dir, name, entry->d_ino) &&
+        (fstatat(fd, name, &st, 0) == -1 || !S_ISREG(st.st_mode) || !(st.st_mode & 0111)))
+        return;
+    pool_add(scan->pool, name, entry->d_ino, 0);
+}
+
+// Reads a directory into a new pool of names, sorted, in place of what it held
+static void dir_scan(DirListing *dir, int executables)
+{
+    NamePool pool = {NULL, 0, 0};
+    DirScan scan = {dir, &pool, executables};
+    int capacity = 0;
+
+    read_directory(dir->path, dir_scan_entry, &scan);
+
+    // The pool is complete, so pointers into it stay valid
+    free(dir->names.data);
+    free(dir->entries);
+    dir->names = pool;
+    dir->entries = NULL;
+    dir->count = 0;
+    for (size_t offset = 0; offset < pool.len; offset += strlen(pool.data + offset) + 1)
+    {
+        offset += sizeof(ino_t);
+        dir->entries = reserve(dir->entries, dir->count, &capacity, sizeof(char *));
+        dir->entries[dir->count++] = pool.data + offset;
+    }
+    qsort(dir->entries, dir->count, sizeof(char *), compare_strings);
+}
+
+// Reads the directory again when it changed since it was last read, returns 1 when it did
+static int dir_refresh(DirListing *dir, int executables)
+{
+    struct stat st;
+
+    if (stat(dir->path[0] != '\0' ? dir->path : ".", &st) == -1)
+    {
+        int changed = dir->count > 0;
+        dir->count = 0;
+        dir->scanned = 0;
+        return changed;
+    }
+    if (dir->scanned && st.st_ino == dir->inode && st.st_mtim.tv_sec == dir->mtime.tv_sec &&
+        st.st_mtim.tv_nsec == dir->mtime.tv_nsec)
+        return 0;
+
+    // What was learned about the entries of a directory that has been replaced says nothing about this one
+    if (st.st_ino != dir->inode)
+        dir->count = 0;
+    dir_scan(dir, executables);
+    dir->mtime = st.st_mtim;
+    dir->inode = st.st_ino;
+    dir->scanned = 1;
+    return 1;
+}
+
+// Frees what a directory holds
+static void dir_free(DirListing *dir)
+{
+    free(dir->path);
+    free(dir->names.data);
+    free(dir->entries);
+    memset(dir, 0, sizeof(*dir));
+}
+
+// Takes the directories from a new PATH, keeping the ones already read that it still names
+static void index_set_path(const char *path_env)
+{
+    DirListing dirs[MAX_PATH_DIRS];
+    int count = 0;
+
+    for (const char *dir = path_env; count < MAX_PATH_DIRS;)
+    {
+        const char *end = strchrnul(dir, ':');
+        DirListing *kept = NULL;
+        for (int i = 0; i < path_dir_count && kept == NULL; i++)
+        {
+            if (path_dirs[i].path != NULL && (size_t)(end - dir) == strlen(path_dirs[i].path) &&
+                strncmp(path_dirs[i].path, dir, end - dir) == 0)
+                kept = &path_dirs[i];
+        }
+        if (kept != NULL)
+        {
+            dirs[count++] = *kept;
+            kept->path = NULL;
+        }
+        else
+        {
+            memset(&dirs[count], 0, sizeof(DirListing));
+            dirs[count++].path = strndup(dir, end - dir);
+        }
+        if (*end == '\0')
+            break;
+        dir = end + 1;
+    }
+
+    for (int i = 0; i < path_dir_count; i++)
+    {
+        if (path_dirs[i].path != NULL)
+            dir_free(&path_dirs[i]);
+    }
+    memcpy(path_dirs, dirs, count * sizeof(DirListing));
+    path_dir_count = count;
+    free(indexed_path);
+    indexed_path = strdup(path_env);
+}
+
+// Brings the command index up to date: a changed PATH is split again, and only the directories whose mtime
+// or inode changed since they were read are read again. Returns 1 when the index changed
+int command_index_refresh()
+{
+    const char *path_env = getenv("PATH");
+    int changed = 0;
+
+    if (path_env == NULL)
+        path_env = "/bin:/usr/bin";
+    if (indexed_path == NULL || strcmp(indexed_path, path_env) != 0)
+    {
+        index_set_path(path_env);
+        changed = 1;
+    }
+
+    for (int i = 0; i < path_dir_count; i++)
+        changed |= dir_refresh(&path_dirs[i], 1);
+    if (!changed)
+        return 0;
+
+    // Merge the directories into one sorted list without repeats
+    int total = 0;
+    for (int i = 0; i < path_dir_count; i++)
+        total += path_dirs[i].count;
+    free(command_index);
+    command_index = malloc((total + 1) * sizeof(char *));
+    if (command_index == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    command_count = 0;
+    for (int i = 0; i < path_dir_count; i++)
+    {
+        memcpy(command_index + command_count, path_dirs[i].entries, path_dirs[i].count * sizeof(char *));
+        command_count += path_dirs[i].count;
+    }
+    qsort(command_index, command_count, sizeof(char *), compare_strings);
+
+    int unique = 0;
+    for (int i = 0; i < command_count; i++)
+    {
+        if (unique == 0 || strcmp(command_index[unique - 1], command_index[i]) != 0)
+            command_index[unique++] = command_index[i];
+    }
+    command_count = unique;
+    return 1;
+}
+
+// Adds name to the candidates when it starts with the word being completed
+static void visit_name(const char *name)
+{
+    if (strncmp(name, visit_prefix, visit_prefix_len) != 0)
+        return;
+    if (visit_count == visit_capacity)
+    {
+        int capacity = visit_capacity * 2 + 16;
+        char **grown = arena_alloc(&line_arena, capacity * sizeof(char *));
+        memcpy(grown, visit_matches, visit_count * sizeof(char *));
+        visit_matches = grown;
+        visit_capacity = capacity;
+    }
+    visit_matches[visit_count++] = (char *)name;
+}
+
+// Returns the index of the first of the count sorted names not sorting before prefix
+static int lower_bound(char **names, int count, const char *prefix)
+{
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (strcmp(names[mid], prefix) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Gathers the commands starting with prefix: executables on PATH from the index, found with a binary search,
+// then builtins, functions and aliases
+static void complete_command(const char *prefix)
+{
+    command_index_refresh();
+    for (int i = lower_bound(command_index, command_count, prefix); i < command_count; i++)
+    {
+        if (strncmp(command_index[i], prefix, visit_prefix_len) != 0)
+            break;
+        visit_name(command_index[i]);
+    }
+    for_each_builtin(visit_name);
+    for_each_function(visit_name);
+    for_each_alias(visit_name);
+}
+
+// Gathers the names in directory dir starting with prefix, a directory with a '/' after its name. Names
+// starting with '.' only match a prefix that does too
+static void complete_file(const char *dir, const char *prefix)
+{
+    if (file_dir.path == NULL || strcmp(file_dir.path, dir) != 0)
+    {
+        dir_free(&file_dir);
+        file_dir.path = my_strdup(dir);
+        if (file_dir.path == NULL)
+            return;
+    }
+    dir_refresh(&file_dir, 0);
+
+    for (int i = lower_bound(file_dir.entries, file_dir.count, prefix); i < file_dir.count; i++)
+    {
+        const char *name = file_dir.entries[i];
+        if (strncmp(name, prefix, visit_prefix_len) != 0)
+            break;
+        if (name[0] != '.' || prefix[0] == '.')
+            visit_name(name);
+    }
+}
+
+// Returns 1 when the word starting at start in line is in command position: first on the line, after a
+// ';', '|' or '&', or after a keyword that a command follows
+static int at_command_position(const char *line, int start)
+{
+    int end = start;
+    while (end > 0 && (line[end - 1] == ' ' || line[end - 1] == '\t'))
+        end--;
+    if (end == 0 || strchr(";|&", line[end - 1]) != NULL)
+        return 1;
+
+    int word = end;
+    while (word > 0 && strchr(word_breaks, line[word - 1]) == NULL)
+        word--;
+    for (int i = 0; command_keywords[i] != NULL; i++)
+    {
+        size_t len = strlen(command_keywords[i]);
+        if ((int)len == end - word && strncmp(line + word, command_keywords[i], len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Finds what the word ending at pos in line can be completed to: a command name in command position, a
+// file name otherwise or when the word holds a '/'. The word runs back to an unescaped blank or operator
+void complete_word(const char *line, int pos, Completion *completion)
+{
+    int start = pos;
+    while (start > 0 && (strchr(word_breaks, line[start - 1]) == NULL || (start > 1 && line[start - 2] == '\\')))
+        start--;
+    if (start < pos && (line[start] == '"' || line[start] == '\''))
+        start++;
+
+    // The word as typed, without its escapes
+    char *word = arena_alloc(&line_arena, pos - start + 1);
+    int len = 0;
+    for (int i = start; i < pos; i++)
+    {
+        if (line[i] == '\\' && i + 1 < pos)
+            i++;
+        word[len++] = line[i];
+    }
+    word[len] = '\0';
+
+    visit_matches = NULL;
+    visit_count = 0;
+    visit_capacity = 0;
+    const char *slash = strrchr(word, '/');
+    completion->files = slash != NULL || !at_command_position(line, start);
+    if (!completion->files)
+    {
+        visit_prefix = word;
+        visit_prefix_len = len;
+        complete_command(word);
+    }
+    else
+    {
+        // A leading ~/ is looked up in $HOME but stays as typed
+        const char *base = slash != NULL ? slash + 1 : word;
+        char *dir = arena_strndup(&line_arena, word, base - word);
+        const char *home = get_variable_value("$HOME");
+        if (strncmp(dir, "~/", 2) == 0 && home != NULL)
+        {
+            char *expanded = arena_alloc(&line_arena, strlen(home) + strlen(dir));
+            sprintf(expanded, "%s%s", home, dir + 1);
+            dir = expanded;
+        }
+        visit_prefix = base;
+        visit_prefix_len = strlen(base);
+        complete_file(dir, base);
+    }
+
+    qsort(visit_matches, visit_count, sizeof(char *), compare_strings);
+    int unique = 0;
+    for (int i = 0; i < visit_count; i++)
+    {
+        if (unique == 0 || strcmp(visit_matches[unique - 1], visit_matches[i]) != 0)
+            visit_matches[unique++] = visit_matches[i];
+    }
+    completion->matches = visit_matches;
+    completion->count = unique;
+    completion->typed = visit_prefix_len;
+}
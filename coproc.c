@@ -0,0 +1,394 @@
+#include "myshell.h"
+
+#define COPROC_BUFFER_SIZE 4096
+#define COPROC_MIN_FD 10
+
+// A command started by coproc, kept running with a pipe to its standard input and one from its standard
+// output until the shell closes it
+typedef struct Coproc
+{
+    char *name;
+    char *command;
+    pid_t pid;
+    int in_fd;     // the shell's end of the pipe to the coprocess's standard input
+    int out_fd;    // the shell's end of the pipe from its standard output
+    ino_t out_ino; // the output pipe, recognised when it reaches read as standard input
+    int running;
+    int status;
+    char buffer[COPROC_BUFFER_SIZE]; // output read past the last line read returned
+    size_t start;
+    size_t end;
+    struct Coproc *next;
+} Coproc;
+
+static Coproc *coprocs = NULL;
+
+// Process group of the coprocess the shell is waiting on to finish, so Control-C reaches it
+pid_t coproc_pgid = -1;
+
+// Finds the coprocess called name, or returns NULL
+static Coproc *coproc_find(const char *name)
+{
+    for (Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next)
+    {
+        if (strcmp(coproc->name, name) == 0)
+            return coproc;
+    }
+    return NULL;
+}
+
+// Sets $NAME_suffix, one of the variables a coprocess exposes, to value, or removes it when value is negative
+static void coproc_variable(const Coproc *coproc, const char *suffix, long value)
+{
+    char name[MAX_COMMAND_LENGTH];
+    char text[32];
+
+    snprintf(name, sizeof(name), "$%s_%s", coproc->name, suffix);
+    if (value < 0)
+    {
+        unset_variable(name);
+        return;
+    }
+    snprintf(text, sizeof(text), "%ld", value);
+    set_variable_value(name, text);
+}
+
+// Closes the shell's ends of a coprocess's pipes, which it sees as the end of its input, and drops its
+// variables; the entry stays until the process is reaped
+static void coproc_close(Coproc *coproc)
+{
+    if (coproc->in_fd != -1)
+        close(coproc->in_fd);
+    if (coproc->out_fd != -1)
+        close(coproc->out_fd);
+    coproc->in_fd = -1;
+    coproc->out_fd = -1;
+    coproc->start = coproc->end = 0;
+    coproc_variable(coproc, "IN", -1);
+    coproc_variable(coproc, "OUT", -1);
+    coproc_variable(coproc, "PID", -1);
+}
+
+// Frees a coprocess entry
+static void coproc_free(Coproc *coproc)
+{
+    free(coproc->name);
+    free(coproc->command);
+    free(coproc);
+}
+
+// Unlinks a coprocess from the list and frees it
+static void coproc_remove(Coproc *coproc)
+{
+    Coproc **link = &coprocs;
+    while (*link != coproc)
+        link = &(*link)->next;
+    *link = coproc->next;
+    coproc_free(coproc);
+}
+
+// Records that pid finished, when it is a coprocess; called as its exit is collected, with SIGCHLD blocked
+// Returns 1 when pid was a coprocess
+int coproc_exited(pid_t pid, int status)
+{
+    for (Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next)
+    {
+        if (coproc->pid == pid && coproc->running)
+        {
+            coproc->running = 0;
+            coproc->status = status;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Forgets every coprocess without closing anything, in a forked shell where they are not its own and where
+// reading ahead into a buffer would take lines from the shell's
+void coprocs_forget()
+{
+    while (coprocs != NULL)
+    {
+        Coproc *coproc = coprocs;
+        coprocs = coproc->next;
+        coproc_free(coproc);
+    }
+}
+
+// Returns the coprocess whose output fd reads, directly or through a copy made by a redirection
+static Coproc *coproc_reading(int fd)
+{
+    struct stat st;
+    int stated = 0;
+
+    for (Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next)
+    {
+        if (coproc->out_fd == -1)
+            continue;
+        if (coproc->out_fd == fd)
+            return coproc;
+        if (!stated && fstat(fd, &st) == -1)
+            return NULL;
+        stated = 1;
+        if (S_ISFIFO(st.st_mode) && st.st_ino == coproc->out_ino)
+            return coproc;
+    }
+    return NULL;
+}
+
+// Reads one line from fd into out for read: a coprocess's output is read in blocks and the rest of a block
+// kept for the next line, since nothing else reads it; anything else a byte at a time. Control-C while waiting
+// for a coprocess only stops the wait, the coprocess stays warm. Returns the length, or -1 at the end of the
+// input or when interrupted
+int read_fd_line(int fd, char *out, int size)
+{
+    Coproc *coproc = coproc_reading(fd);
+    int len = 0;
+
+    // Whatever was printed goes out before waiting, so a function running as a coprocess answers each line
+    fflush(stdout);
+
+    if (coproc == NULL)
+        return read_unbuffered_line(fd, out, size);
+
+    while (1)
+    {
+        char *data = coproc->buffer + coproc->start;
+        size_t available = coproc->end - coproc->start;
+        char *nl = memchr(data, '\n', available);
+        size_t take = nl != NULL ? (size_t)(nl - data) : available;
+        size_t room = (size_t)(size - 1 - len);
+
+        memcpy(out + len, data, take < room ? take : room);
+        len += take < room ? take : room;
+        coproc->start += nl != NULL ? take + 1 : take;
+        if (nl != NULL)
+            break;
+
+        coproc->start = coproc->end = 0;
+        ssize_t n = read(fd, coproc->buffer, sizeof(coproc->buffer));
+        if (n == -1 && errno == EINTR && !interrupted)
+            continue;
+        if (n <= 0)
+        {
+            if (len == 0)
+                return -1;
+            break;
+        }
+        coproc->end = n;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// Moves a descriptor above the ones redirections name, keeping it close-on-exec; returns -1 on failure
+static int move_fd(int fd)
+{
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, COPROC_MIN_FD);
+    close(fd);
+    return moved;
+}
+
+// Starts argv as coprocess name, in a process group of its own on a terminal so Control-C at the prompt or
+// in a foreground command leaves it running
+static void coproc_start(const char *name, char **argv)
+{
+    int to_child[2];
+    int from_child[2];
+    LaunchPlan plan;
+    sigset_t old_mask;
+    struct stat st;
+
+    if (pipe2(to_child, O_CLOEXEC) == -1)
+    {
+        perror("coproc: pipe");
+        last_exit_status = 1;
+        return;
+    }
+    if (pipe2(from_child, O_CLOEXEC) == -1)
+    {
+        perror("coproc: pipe");
+        close(to_child[0]);
+        close(to_child[1]);
+        last_exit_status = 1;
+        return;
+    }
+    to_child[1] = move_fd(to_child[1]);
+    from_child[0] = move_fd(from_child[0]);
+    if (to_child[1] == -1 || from_child[0] == -1)
+    {
+        perror("coproc");
+        int fds[] = {to_child[0], to_child[1], from_child[0], from_child[1]};
+        for (int i = 0; i < 4; i++)
+        {
+            if (fds[i] != -1)
+                close(fds[i]);
+        }
+        last_exit_status = 1;
+        return;
+    }
+
+    Coproc *coproc = calloc(1, sizeof(Coproc));
+    size_t len = 0;
+    for (int i = 0; argv[i] != NULL; i++)
+        len += strlen(argv[i]) + 1;
+    char *command = malloc(len + 1);
+    if (coproc == NULL || command == NULL || (coproc->name = my_strdup(name)) == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    command[0] = '\0';
+    for (int i = 0; argv[i] != NULL; i++)
+    {
+        if (i > 0)
+            strcat(command, " ");
+        strcat(command, argv[i]);
+    }
+    coproc->command = command;
+    coproc->in_fd = to_child[1];
+    coproc->out_fd = from_child[0];
+    coproc->out_ino = fstat(from_child[0], &st) == 0 ? st.st_ino : 0;
+
+    launch_plan_init(&plan, interactive ? 0 : -1);
+    launch_plan_dup(&plan, to_child[0], STDIN_FILENO);
+    launch_plan_dup(&plan, from_child[1], STDOUT_FILENO);
+
+    // Hold SIGCHLD back until the coprocess is in the list, so its exit cannot be missed
+    block_child_signal(&old_mask);
+    const Builtin *builtin = find_builtin(argv);
+    long long spawn_start = trace_start();
+    coproc->pid = builtin != NULL ? launch_builtin(builtin, argv, &plan) : launch_command(argv, &plan);
+    trace_span("spawn", spawn_start, argv[0], 0);
+    int err = errno;
+    close(to_child[0]);
+    close(from_child[1]);
+
+    if (coproc->pid == -1)
+    {
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        fprintf(stderr, "coproc: %s: %s\n", argv[0], strerror(err));
+        close(coproc->in_fd);
+        close(coproc->out_fd);
+        coproc_free(coproc);
+        last_exit_status = status_to_exit_code(launch_failure_status(err));
+        return;
+    }
+    coproc->running = 1;
+    coproc->next = coprocs;
+    coprocs = coproc;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    coproc_variable(coproc, "IN", coproc->in_fd);
+    coproc_variable(coproc, "OUT", coproc->out_fd);
+    coproc_variable(coproc, "PID", coproc->pid);
+    char pid_text[32];
+    snprintf(pid_text, sizeof(pid_text), "%d", coproc->pid);
+    set_variable_value("$!", pid_text);
+}
+
+// Closes coprocess name and waits for it to finish, its status becoming the command's. Its input ends first
+// and what it still prints is read and dropped, so a filter finishes normally rather than by SIGPIPE.
+// Control-C while waiting interrupts it and leaves it to be reaped later
+static void coproc_finish(const char *name)
+{
+    Coproc *coproc = coproc_find(name);
+    if (coproc == NULL)
+    {
+        fprintf(stderr, "coproc: %s: no such coprocess\n", name);
+        last_exit_status = 1;
+        return;
+    }
+
+    coproc_pgid = coproc->pid;
+    if (coproc->in_fd != -1)
+        close(coproc->in_fd);
+    coproc->in_fd = -1;
+    while (coproc->out_fd != -1 && !interrupted)
+    {
+        ssize_t n = read(coproc->out_fd, coproc->buffer, sizeof(coproc->buffer));
+        if (n == 0 || (n == -1 && errno != EINTR))
+            break;
+    }
+    coproc_close(coproc);
+    wait_until_reaped(&coproc->running);
+    coproc_pgid = -1;
+    if (coproc->running)
+    {
+        last_exit_status = 128 + SIGINT;
+        return;
+    }
+    last_exit_status = status_to_exit_code(coproc->status);
+    coproc_remove(coproc);
+}
+
+// Prints one line per coprocess: its name, process ID, state and command
+static void coproc_list()
+{
+    char state[64];
+
+    job_collect();
+    for (const Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next)
+    {
+        if (coproc->running)
+            snprintf(state, sizeof(state), "%s", coproc->in_fd != -1 ? "Running" : "Closing");
+        else if (WIFSIGNALED(coproc->status))
+            snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(coproc->status)));
+        else if (WEXITSTATUS(coproc->status) != 0)
+            snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(coproc->status));
+        else
+            snprintf(state, sizeof(state), "Done");
+        printf("%-12s %7d  %-10s  %s\n", coproc->name, coproc->pid, state, coproc->command);
+    }
+}
+
+// Returns 1 when name can be part of a variable name
+static int valid_name(const char *name)
+{
+    if (!isalpha((unsigned char)name[0]) && name[0] != '_')
+        return 0;
+    for (const char *p = name; *p != '\0'; p++)
+    {
+        if (!isalnum((unsigned char)*p) && *p != '_')
+            return 0;
+    }
+    return 1;
+}
+
+// coproc NAME command [word...] / coproc -c NAME / coproc: starts command as a coprocess that stays running,
+// its standard input written through descriptor $NAME_IN and its output read from $NAME_OUT, its process ID
+// in $NAME_PID; -c closes both and waits for it; without arguments lists the coprocesses
+void coproc_builtin(char **argv)
+{
+    if (argv[1] == NULL)
+    {
+        coproc_list();
+        return;
+    }
+    if (strcmp(argv[1], "-c") == 0 && argv[2] != NULL && argv[3] == NULL)
+    {
+        coproc_finish(argv[2]);
+        return;
+    }
+    if (argv[2] == NULL || !valid_name(argv[1]))
+    {
+        fprintf(stderr, "coproc: usage: coproc NAME command [word...], coproc -c NAME\n");
+        last_exit_status = 2;
+        return;
+    }
+
+    job_collect();
+    Coproc *coproc = coproc_find(argv[1]);
+    if (coproc != NULL && coproc->running)
+    {
+        fprintf(stderr, "coproc: %s: already running\n", argv[1]);
+        last_exit_status = 1;
+        return;
+    }
+    if (coproc != NULL)
+    {
+        coproc_close(coproc);
+        coproc_remove(coproc);
+    }
+    coproc_start(argv[1], argv + 2);
+}
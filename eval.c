@@ -0,0 +1,401 @@
+#include "myshell.h"
+
+#include <time.h>
+
+// Loops currently running, and the levels a pending break or continue still has to unwind
+static int loop_depth = 0;
+static int break_levels = 0;
+static int continue_levels = 0;
+
+// Set by return until the running function's body has unwound
+static int returning = 0;
+
+// Returns 1 when the last command exited with status 0
+static int succeeded()
+{
+    return last_exit_status == 0;
+}
+
+// Implements break [n] and continue [n] by recording how many enclosing loops they apply to
+static void loop_control(char **argv)
+{
+    int levels = argv[1] != NULL ? atoi(argv[1]) : 1;
+
+    if (loop_depth == 0)
+    {
+        fprintf(stderr, "%s: only meaningful in a loop\n", argv[0]);
+        return;
+    }
+    if (levels < 1)
+    {
+        fprintf(stderr, "%s: %s: loop count out of range\n", argv[0], argv[1]);
+        last_exit_status = 1;
+        return;
+    }
+    if (levels > loop_depth)
+        levels = loop_depth;
+
+    if (strcmp(argv[0], "break") == 0)
+        break_levels = levels;
+    else
+        continue_levels = levels;
+    last_exit_status = 0;
+}
+
+// Implements return [n]: ends the running function with status n, or with the last command's status
+static void function_return(char **argv)
+{
+    if (function_depth == 0)
+    {
+        fprintf(stderr, "return: can only be used in a function\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (argv[1] != NULL)
+        last_exit_status = atoi(argv[1]) & 0xff;
+    returning = 1;
+}
+
+// Returns 1 while commands must be skipped: after Control-C, or until a break, continue or return unwinds
+static int unwinding()
+{
+    return interrupted || break_levels > 0 || continue_levels > 0 || returning;
+}
+
+// Consumes a pending break or continue aimed at the loop that just ran its body; returns 1 when that loop must end
+static int loop_should_stop()
+{
+    if (break_levels > 0)
+    {
+        break_levels--;
+        return 1;
+    }
+    if (continue_levels > 0)
+    {
+        // A continue for an outer loop ends this one first
+        continue_levels--;
+        return continue_levels > 0;
+    }
+    return interrupted || returning;
+}
+
+// Returns 1 for the [[ ]] operators whose right-hand side is a pattern
+static int is_pattern_operator(const char *word)
+{
+    return strcmp(word, "==") == 0 || strcmp(word, "=") == 0 || strcmp(word, "!=") == 0;
+}
+
+// Expands the marked words of an argv row into a new row in the arena; an unquoted command substitution
+// or a pattern can turn one word into several or none. With assignments, the name in "$x = value" is only
+// unmarked and the value is never split or globbed, and nothing is inside [[ ]], where a pattern on the right
+// of == or != keeps its quoted wildcards escaped. The patterns of one command share its directory listings.
+// Returns NULL when an expansion failed
+static char **expand_row(char **row, int *argc, int assignments)
+{
+    int i = 0;
+    while (i < *argc && row[i][0] != EXPAND_MARK)
+        i++;
+    if (i == *argc)
+        return row;
+
+    glob_cache_reset();
+    int assignment = assignments && *argc > 2 && strcmp(row[*argc - 2], "=") == 0;
+    int split = strcmp(row[0], "[[") != 0;
+    int capacity = *argc + 1;
+    char **out = arena_alloc(&line_arena, capacity * sizeof(char *));
+    int count = 0;
+
+    for (i = 0; i < *argc; i++)
+    {
+        char *word = row[i];
+        char **fields = &word;
+        int n = 1;
+
+        if (word[0] == EXPAND_MARK)
+        {
+            if (assignment && i == *argc - 3)
+                word++;
+            else if (!split && i > 0 && is_pattern_operator(row[i - 1]))
+                word = expand_pattern(word + 1);
+            else if ((assignment && i == *argc - 1) || !split)
+                word = expand_word(word + 1);
+            else
+                n = expand_fields(word + 1, &fields);
+            if (word == NULL || n == -1)
+                return NULL;
+        }
+
+        if (count + n + 1 > capacity)
+        {
+            char **grown = arena_alloc(&line_arena, (capacity * 2 + n) * sizeof(char *));
+            memcpy(grown, out, count * sizeof(char *));
+            out = grown;
+            capacity = capacity * 2 + n;
+        }
+        memcpy(out + count, fields, n * sizeof(char *));
+        count += n;
+    }
+    out[count] = NULL;
+    *argc = count;
+    return out;
+}
+
+// Runs one pipeline node; expansion rewrites argv rows in place, so it works on copies that are
+// released straight after, letting a loop body run any number of times in bounded memory
+static void eval_pipeline(Node *node)
+{
+    char **rows[MAX_ARG_COUNT];
+    int argc[MAX_SUBCOMMAND_COUNTER];
+    ArenaMark mark = arena_mark(&line_arena);
+    long long expand_start = trace_start();
+
+    for (int i = 0; i < node->argv_count; i++)
+    {
+        argc[i] = node->argc[i];
+        rows[i] = arena_alloc(&line_arena, (argc[i] + 1) * sizeof(char *));
+        memcpy(rows[i], node->argv[i], (argc[i] + 1) * sizeof(char *));
+        rows[i] = expand_row(rows[i], &argc[i], 1);
+        if (rows[i] == NULL || interrupted)
+        {
+            // A failed expansion, or a substitution stopped by Control-C, cancels the command
+            if (rows[i] == NULL)
+                last_exit_status = 1;
+            arena_rewind(&line_arena, mark);
+            return;
+        }
+    }
+    trace_span("expand", expand_start, node->argv_count > 0 && argc[0] > 0 ? rows[0][0] : NULL, 0);
+
+    // A command that expanded to nothing, like $(true), leaves the status of its substitutions
+    if (node->argv_count == 1 && argc[0] == 0 && node->redirects[0] == NULL)
+    {
+        arena_rewind(&line_arena, mark);
+        return;
+    }
+
+    if (node->argv_count == 1 && argc[0] > 0 &&
+        (strcmp(rows[0][0], "break") == 0 || strcmp(rows[0][0], "continue") == 0))
+    {
+        loop_control(rows[0]);
+        arena_rewind(&line_arena, mark);
+        return;
+    }
+    if (node->argv_count == 1 && argc[0] > 0 && strcmp(rows[0][0], "return") == 0)
+    {
+        function_return(rows[0]);
+        arena_rewind(&line_arena, mark);
+        return;
+    }
+
+    amper = node->background;
+    handle_pipes(rows, node->redirects, node->argv_count);
+    arena_rewind(&line_arena, mark);
+
+    // A foreground command killed by Control-C stops the whole tree, not just itself
+    if (last_exit_status == 128 + SIGINT)
+        interrupted = 1;
+}
+
+// Runs the branch of an if node chosen by its condition
+static void eval_if(Node *node)
+{
+    eval_tree(node->cond);
+    if (unwinding())
+        return;
+
+    if (succeeded())
+        eval_tree(node->body);
+    else if (node->else_part != NULL)
+        eval_tree(node->else_part);
+    else
+        last_exit_status = 0;
+}
+
+// Runs a while or until loop; the status is that of the last body command run
+static void eval_loop(Node *node)
+{
+    int status = 0;
+
+    loop_depth++;
+    while (!interrupted)
+    {
+        eval_tree(node->cond);
+        if (break_levels > 0 || continue_levels > 0)
+        {
+            if (loop_should_stop())
+                break;
+            continue;
+        }
+        if (interrupted || returning || succeeded() != (node->type == NODE_WHILE))
+            break;
+
+        eval_tree(node->body);
+        status = last_exit_status;
+        if (loop_should_stop())
+            break;
+    }
+    loop_depth--;
+    last_exit_status = status;
+}
+
+// Runs a for loop body once per word, or once per positional parameter when the loop has no word list
+static void eval_for(Node *node)
+{
+    char name[32];
+    char **words = node->words;
+    int count = node->words != NULL ? node->word_count : 0;
+    int status = 0;
+    ArenaMark mark = arena_mark(&line_arena);
+
+    if (node->words == NULL && get_variable_value("$#") != NULL)
+        count = atoi(get_variable_value("$#"));
+
+    // The word list is expanded once, before the first iteration
+    if (words != NULL && (words = expand_row(words, &count, 0)) == NULL)
+    {
+        last_exit_status = 1;
+        return;
+    }
+
+    loop_depth++;
+    for (int i = 0; i < count && !interrupted; i++)
+    {
+        const char *word;
+        if (words != NULL)
+            word = words[i];
+        else
+        {
+            snprintf(name, sizeof(name), "$%d", i + 1);
+            word = get_variable_value(name) != NULL ? get_variable_value(name) : "";
+        }
+
+        set_variable_value(node->name, word);
+        eval_tree(node->body);
+        status = last_exit_status;
+        if (loop_should_stop())
+            break;
+    }
+    loop_depth--;
+    last_exit_status = status;
+    arena_rewind(&line_arena, mark);
+}
+
+// Runs one command of a list according to its type
+static void eval_node(Node *node)
+{
+    switch (node->type)
+    {
+    case NODE_PIPELINE:
+        eval_pipeline(node);
+        break;
+    case NODE_IF:
+        eval_if(node);
+        break;
+    case NODE_WHILE:
+    case NODE_UNTIL:
+        eval_loop(node);
+        break;
+    case NODE_FOR:
+        eval_for(node);
+        break;
+    case NODE_GROUP:
+        eval_tree(node->body);
+        break;
+    case NODE_FUNCTION:
+        // Defining a function runs nothing, but an rc file defining one cannot be replayed from builtins alone
+        if (rc_recording)
+            rc_record(NULL, NULL);
+        define_function(node->name, node->body);
+        last_exit_status = 0;
+        break;
+    }
+}
+
+// Returns a struct timeval in seconds
+static double timeval_seconds(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+// Prints one line of the time report, in minutes and seconds
+static void print_time(const char *label, double seconds)
+{
+    int minutes = (int)(seconds / 60);
+    fprintf(stderr, "%s\t%dm%.3fs\n", label, minutes, seconds - minutes * 60);
+}
+
+// Runs a command preceded by time, then reports on stderr the wall clock time and the CPU time of the shell
+// and of every child reaped meanwhile. A pipeline also gets a line per stage from the usage wait4() returned
+// for it: CPU time, peak memory and context switches
+static void eval_timed(Node *node)
+{
+    struct rusage self_before;
+    struct rusage children_before;
+    struct rusage self_after;
+    struct rusage children_after;
+    struct timespec start;
+    struct timespec end;
+    int kept = keep_finished_job;
+
+    getrusage(RUSAGE_SELF, &self_before);
+    getrusage(RUSAGE_CHILDREN, &children_before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    keep_finished_job = node->type == NODE_PIPELINE;
+    finished_job.count = 0;
+
+    eval_node(node);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &self_after);
+    getrusage(RUSAGE_CHILDREN, &children_after);
+    keep_finished_job = kept;
+
+    double user = timeval_seconds(&self_after.ru_utime) - timeval_seconds(&self_before.ru_utime) +
+                  timeval_seconds(&children_after.ru_utime) - timeval_seconds(&children_before.ru_utime);
+    double sys = timeval_seconds(&self_after.ru_stime) - timeval_seconds(&self_before.ru_stime) +
+                 timeval_seconds(&children_after.ru_stime) - timeval_seconds(&children_before.ru_stime);
+    fprintf(stderr, "\n");
+    print_time("real", end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+    print_time("user", user);
+    print_time("sys", sys);
+
+    // A lone builtin makes no job, and a stopped pipeline has not finished
+    for (int i = 0; node->type == NODE_PIPELINE && i < finished_job.count && i < node->argv_count; i++)
+    {
+        const struct rusage *usage = &finished_job.usage[i];
+        const char *name = node->argc[i] > 0 ? node->argv[i][0] : "";
+        if (name[0] == EXPAND_MARK)
+            name++;
+        fprintf(stderr, "stage %d (%s): user %.3fs sys %.3fs, max RSS %ld KB, %ld voluntary + %ld involuntary context "
+                        "switches\n",
+                i + 1, name, timeval_seconds(&usage->ru_utime), timeval_seconds(&usage->ru_stime), usage->ru_maxrss,
+                usage->ru_nvcsw, usage->ru_nivcsw);
+    }
+}
+
+// Walks a list of parsed commands, running each in turn; loop bodies are run from the tree without re-parsing
+void eval_tree(Node *list)
+{
+    for (Node *node = list; node != NULL; node = node->next)
+    {
+        if (unwinding())
+            return;
+
+        if (node->timed)
+            eval_timed(node);
+        else
+            eval_node(node);
+    }
+}
+
+// Runs the body of a called function: a break or continue inside it cannot reach the caller's loops, and a
+// return ends just this call
+void eval_function(Node *body)
+{
+    int depth = loop_depth;
+
+    loop_depth = 0;
+    eval_tree(body);
+    loop_depth = depth;
+    returning = 0;
+}
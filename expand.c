@@ -0,0 +1,581 @@
+#include "myshell.h"
+
+#define CAPTURE_CHUNK 65536
+
+// Output of an expansion, grown inside the line arena; with split set, unquoted command substitutions
+// break it into fields, each ended by a NUL written over the first blank after it
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+    int split;
+    size_t *starts; // offset of every finished field
+    int field_count;
+    int field_capacity;
+    size_t field_start; // offset of the field being built
+    int field_live;     // the field being built exists, even if it is still empty
+    int here_document;  // quotes are ordinary characters, as in a here-document body
+    int glob;           // the fields are patterns: backslashes, and wildcards that were quoted, get a backslash
+    int escaped;        // a backslash was added, to be taken out of fields that match no file
+    int wild;           // an unquoted wildcard was added
+} WordBuffer;
+
+// Makes room for len more bytes and the terminating NUL, moving to a larger arena chunk when needed
+static void word_reserve(WordBuffer *word, size_t len)
+{
+    if (word->len + len + 1 <= word->capacity)
+        return;
+
+    size_t capacity = word->capacity * 2;
+    while (capacity < word->len + len + 1)
+        capacity *= 2;
+    char *data = arena_alloc(&line_arena, capacity);
+    memcpy(data, word->data, word->len);
+    word->data = data;
+    word->capacity = capacity;
+}
+
+// Appends len bytes to the field being built
+static void word_append(WordBuffer *word, const char *s, size_t len)
+{
+    word_reserve(word, len);
+    memcpy(word->data + word->len, s, len);
+    word->len += len;
+    word->field_live = 1;
+}
+
+// Returns 1 when the len bytes at s, quoted or not, can go into word as they are, noting unquoted wildcards
+static int word_takes_raw(WordBuffer *word, const char *s, size_t len, int quoted)
+{
+    if (!word->glob)
+        return 1;
+    int wild = memchr(s, '*', len) != NULL || memchr(s, '?', len) != NULL || memchr(s, '[', len) != NULL;
+    if (memchr(s, '\\', len) != NULL || (quoted && wild))
+        return 0;
+    word->wild |= wild;
+    return 1;
+}
+
+// Copies len bytes that came out of quotes or an expansion to the end of word; in a word that globs, each
+// backslash and each quoted wildcard gets a backslash in front, so only its own unquoted wildcards match
+static void word_copy(WordBuffer *word, const char *s, size_t len, int quoted)
+{
+    if (word_takes_raw(word, s, len, quoted))
+    {
+        word_reserve(word, len);
+        memcpy(word->data + word->len, s, len);
+        word->len += len;
+        return;
+    }
+
+    word_reserve(word, len * 2);
+    char *out = word->data + word->len;
+    for (size_t i = 0; i < len; i++)
+    {
+        int wild = s[i] == '*' || s[i] == '?' || s[i] == '[';
+        if (s[i] == '\\' || (quoted && wild))
+        {
+            *out++ = '\\';
+            word->escaped = 1;
+        }
+        else
+            word->wild |= wild;
+        *out++ = s[i];
+    }
+    word->len = out - word->data;
+}
+
+// Appends len bytes that came out of quotes or an expansion to the field being built
+static void word_append_text(WordBuffer *word, const char *s, size_t len, int quoted)
+{
+    word_copy(word, s, len, quoted);
+    word->field_live = 1;
+}
+
+// Ends the field being built at the current end of the buffer
+static void word_end_field(WordBuffer *word)
+{
+    if (word->field_count == word->field_capacity)
+    {
+        int capacity = word->field_capacity * 2;
+        size_t *starts = arena_alloc(&line_arena, capacity * sizeof(size_t));
+        memcpy(starts, word->starts, word->field_count * sizeof(size_t));
+        word->starts = starts;
+        word->field_capacity = capacity;
+    }
+    word->starts[word->field_count++] = word->field_start;
+}
+
+// Splits the text from offset from to the end of the buffer on blanks and newlines, in place: the first
+// blank after a field becomes its NUL and the rest of the run is skipped over, not moved
+static void word_split(WordBuffer *word, size_t from)
+{
+    char *data = word->data;
+    size_t p = from;
+
+    while (p < word->len)
+    {
+        if (data[p] != ' ' && data[p] != '\t' && data[p] != '\n')
+        {
+            word->field_live = 1;
+            p++;
+            continue;
+        }
+        if (word->field_live)
+        {
+            data[p] = '\0';
+            word_end_field(word);
+            word->field_live = 0;
+        }
+        while (p < word->len && (data[p] == ' ' || data[p] == '\t' || data[p] == '\n' || data[p] == '\0'))
+            p++;
+        word->field_start = p;
+    }
+}
+
+// Reads fd to its end into the line arena with as few read() calls as possible: expected is the size when it
+// is known (a memfd), so one read fills the buffer and a second sees the end; pipes grow it as they go
+static char *read_all(int fd, size_t expected, size_t *len, size_t *capacity)
+{
+    size_t size = expected + 1 > CAPTURE_CHUNK ? expected + 1 : CAPTURE_CHUNK;
+    char *data = arena_alloc(&line_arena, size);
+    size_t used = 0;
+
+    while (1)
+    {
+        if (used + 1 == size)
+        {
+            char *grown = arena_alloc(&line_arena, size * 2);
+            memcpy(grown, data, used);
+            data = grown;
+            size *= 2;
+        }
+        ssize_t n = read(fd, data + used, size - used - 1);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        used += n;
+    }
+
+    *len = used;
+    *capacity = size;
+    return data;
+}
+
+// Runs text in a forked copy of the shell with its standard output going into a memfd (a pipe when
+// memfds are not available) and returns everything it printed; the status goes to last_exit_status
+static char *capture_output(const char *text, size_t text_len, size_t *len, size_t *capacity)
+{
+    int fildes[2] = {-1, -1};
+    sigset_t old_mask;
+    int status;
+
+    int fd = memfd_create("substitution", MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        if (pipe2(fildes, O_CLOEXEC) == -1)
+        {
+            perror("pipe");
+            last_exit_status = 1;
+            *len = 0;
+            return NULL;
+        }
+        fd = fildes[1];
+    }
+
+    // Output that can differ from one run to the next keeps the rc file out of its snapshot
+    if (rc_recording)
+        rc_record(NULL, NULL);
+
+    // Keep the SIGCHLD handler from reaping the child before it is waited for here
+    fflush(stdout);
+    block_child_signal(&old_mask);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        // The text lives in the arena, which the child's first command empties
+        char *script = malloc(text_len + 1);
+        if (script == NULL)
+            _exit(1);
+        memcpy(script, text, text_len);
+        script[text_len] = '\0';
+
+        dup2(fd, STDOUT_FILENO);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        interactive = 0;
+        jobs_forget();
+        coprocs_forget();
+        run_script_buffer(script, text_len);
+        fflush(stdout);
+        _exit(last_exit_status);
+    }
+    if (child == -1)
+    {
+        perror("fork");
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        close(fd);
+        if (fildes[0] != -1)
+            close(fildes[0]);
+        last_exit_status = 1;
+        *len = 0;
+        return NULL;
+    }
+
+    char *data = NULL;
+    if (fildes[0] != -1)
+    {
+        // A pipe has to be drained while the child writes
+        close(fildes[1]);
+        data = read_all(fildes[0], 0, len, capacity);
+        close(fildes[0]);
+    }
+    while (waitpid(child, &status, 0) == -1 && errno == EINTR)
+        ;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    if (fildes[0] == -1)
+    {
+        struct stat st;
+        fstat(fd, &st);
+        lseek(fd, 0, SEEK_SET);
+        data = read_all(fd, st.st_size, len, capacity);
+        close(fd);
+    }
+
+    last_exit_status = status_to_exit_code(status);
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)
+        interrupted = 1;
+
+    // The command may have changed directories that patterns later in the same command look into
+    glob_cache_reset();
+    return data;
+}
+
+// Runs a command substitution and adds its output, without trailing newlines, to word; outside double
+// quotes the output is split into fields. An empty buffer takes over the captured text instead of copying it
+static void expand_command(WordBuffer *word, const char *text, size_t text_len, int in_double)
+{
+    size_t len;
+    size_t capacity;
+    char *data = capture_output(text, text_len, &len, &capacity);
+
+    while (len > 0 && data[len - 1] == '\n')
+        len--;
+
+    size_t from = word->len;
+    if (word->len == 0 && len > 0 && word_takes_raw(word, data, len, in_double))
+    {
+        word->data = data;
+        word->len = len;
+        word->capacity = capacity;
+    }
+    else if (len > 0)
+    {
+        word_copy(word, data, len, in_double);
+    }
+
+    if (in_double || !word->split)
+        word->field_live = 1;
+    else
+        word_split(word, from);
+}
+
+// Expands the $ reference at *p into word and moves *p past it; returns -1 on an arithmetic error
+static int expand_dollar(const char **p, WordBuffer *word, int in_double)
+{
+    const char *s = *p + 1;
+    char name[MAX_COMMAND_LENGTH];
+    char number[32];
+    const char *value = NULL;
+
+    if (s[0] == '(' && s[1] == '(')
+    {
+        // $(( expression ))
+        const char *end = arith_end(s + 2);
+        if (end == NULL)
+        {
+            fprintf(stderr, "Syntax error: missing '))'\n");
+            return -1;
+        }
+        long result;
+        char *expr = arena_strndup(&line_arena, s + 2, end - s - 2);
+        if (arith_eval(expr, &result) == -1)
+            return -1;
+        snprintf(number, sizeof(number), "%ld", result);
+        word_append(word, number, strlen(number));
+        *p = end + 2;
+        return 0;
+    }
+
+    if (*s == '(')
+    {
+        // $( command )
+        const char *end = command_end(s + 1);
+        if (end == NULL)
+        {
+            fprintf(stderr, "Syntax error: missing ')'\n");
+            return -1;
+        }
+        expand_command(word, s + 1, end - s - 1, in_double);
+        *p = end + 1;
+        return 0;
+    }
+
+    if (*s == '?')
+    {
+        snprintf(number, sizeof(number), "%d", last_exit_status);
+        value = number;
+        s++;
+    }
+    else if (*s == '$')
+    {
+        snprintf(number, sizeof(number), "%d", (int)getpid());
+        value = number;
+        s++;
+    }
+    else if (*s == '#' || *s == '!' || isdigit((unsigned char)*s))
+    {
+        // Special and positional parameters are one character long
+        snprintf(name, sizeof(name), "$%c", *s++);
+        value = get_variable_value(name);
+    }
+    else if (*s == '{' && strchr(s, '}') != NULL)
+    {
+        const char *close = strchr(s, '}');
+        snprintf(name, sizeof(name), "$%.*s", (int)(close - s - 1), s + 1);
+        value = get_variable_value(name);
+        s = close + 1;
+    }
+    else if (isalpha((unsigned char)*s) || *s == '_')
+    {
+        size_t len = 1;
+        name[0] = '$';
+        while ((isalnum((unsigned char)*s) || *s == '_') && len < sizeof(name) - 1)
+            name[len++] = *s++;
+        name[len] = '\0';
+        value = get_variable_value(name);
+    }
+    else
+    {
+        // A lone '$' is literal
+        word_append(word, "$", 1);
+        *p = s;
+        return 0;
+    }
+
+    word_append_text(word, value != NULL ? value : "", value != NULL ? strlen(value) : 0, in_double);
+    *p = s;
+    return 0;
+}
+
+// Runs a `command`, whose backslashes only escape '$', '`' and another backslash
+static int expand_backquote(const char **p, WordBuffer *word, int in_double)
+{
+    const char *end = backquote_end(*p + 1);
+    if (end == NULL)
+    {
+        fprintf(stderr, "Syntax error: missing '`'\n");
+        return -1;
+    }
+
+    char *text = arena_alloc(&line_arena, end - *p);
+    size_t len = 0;
+    for (const char *s = *p + 1; s < end; s++)
+    {
+        if (*s == '\\' && (s[1] == '$' || s[1] == '`' || s[1] == '\\'))
+            s++;
+        text[len++] = *s;
+    }
+    text[len] = '\0';
+
+    expand_command(word, text, len, in_double);
+    *p = end + 1;
+    return 0;
+}
+
+// Expands raw into word: parameters, $(( )) arithmetic and command substitutions outside single quotes,
+// then quote removal; returns -1 when an error was reported
+static int expand_into(WordBuffer *word, const char *raw)
+{
+    // A here-document body expands as if it were inside double quotes that never close
+    int in_double = word->here_document;
+    const char *escapable = word->here_document ? "\\$`" : "\"\\$`";
+    const char *p = raw;
+
+    while (*p != '\0')
+    {
+        if (*p == '\'' && !in_double)
+        {
+            // Single quotes keep everything up to the closing quote as it is
+            const char *close = strchr(p + 1, '\'');
+            if (close == NULL)
+                close = p + strlen(p);
+            word_append_text(word, p + 1, close - p - 1, 1);
+            p = *close != '\0' ? close + 1 : close;
+        }
+        else if (*p == '"' && !word->here_document)
+        {
+            in_double = !in_double;
+            word->field_live = 1;
+            p++;
+        }
+        else if (*p == '\\' && p[1] != '\0')
+        {
+            // Inside double quotes a backslash only escapes characters that would otherwise be special
+            if (in_double && strchr(escapable, p[1]) == NULL)
+                word_append_text(word, p, 2, 1);
+            else
+                word_append_text(word, p + 1, 1, 1);
+            p += 2;
+        }
+        else if (*p == '$')
+        {
+            if (expand_dollar(&p, word, in_double) == -1)
+                return -1;
+        }
+        else if (*p == '`')
+        {
+            if (expand_backquote(&p, word, in_double) == -1)
+                return -1;
+        }
+        else
+        {
+            // This character and the plain run after it
+            size_t run = strcspn(p + 1, "'\"\\$`") + 1;
+            word_append_text(word, p, run, in_double);
+            p += run;
+        }
+    }
+    word_reserve(word, 0);
+    word->data[word->len] = '\0';
+    return 0;
+}
+
+// Prepares an empty buffer for a word of about len bytes
+static void word_init(WordBuffer *word, size_t len, int split)
+{
+    word->capacity = len + 32;
+    word->data = arena_alloc(&line_arena, word->capacity);
+    word->len = 0;
+    word->split = split;
+    word->field_capacity = 4;
+    word->starts = arena_alloc(&line_arena, word->field_capacity * sizeof(size_t));
+    word->field_count = 0;
+    word->field_start = 0;
+    word->field_live = 0;
+    word->here_document = 0;
+    word->glob = 0;
+    word->escaped = 0;
+    word->wild = 0;
+}
+
+// Expands a word kept raw by the parser into one word with nothing split; the result lives in the line
+// arena, NULL means an error was reported
+char *expand_word(const char *raw)
+{
+    WordBuffer word;
+
+    word_init(&word, strlen(raw), 0);
+    if (expand_into(&word, raw) == -1)
+        return NULL;
+    return word.data;
+}
+
+// Expands the right-hand side of a [[ ]] pattern match into one word that fnmatch() reads as a pattern: its
+// backslashes and the wildcards that were quoted get a backslash, so only unquoted wildcards match
+char *expand_pattern(const char *raw)
+{
+    WordBuffer word;
+
+    word_init(&word, strlen(raw), 0);
+    word.glob = 1;
+    if (expand_into(&word, raw) == -1)
+        return NULL;
+    return word.data;
+}
+
+// Takes the backslashes word_copy() added back out of a field, in place
+static void unescape_field(char *field)
+{
+    char *out = field;
+    for (const char *p = field; *p != '\0'; p++)
+    {
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        *out++ = *p;
+    }
+    *out = '\0';
+}
+
+// Expands a word kept raw by the parser into fields: the output of an unquoted command substitution is
+// split on blanks and newlines, so the word can become several fields or none; everything else stays
+// together. A field with an unquoted '*', '?' or '[...]' is then replaced by the sorted paths it matches,
+// unless it matches none. Returns the number of fields, stored in the line arena, or -1 when an error was
+// reported
+int expand_fields(const char *raw, char ***fields)
+{
+    WordBuffer word;
+
+    word_init(&word, strlen(raw), 1);
+    word.glob = !noglob;
+    if (expand_into(&word, raw) == -1)
+        return -1;
+    if (word.field_live)
+        word_end_field(&word);
+
+    int count = word.field_count;
+    *fields = arena_alloc(&line_arena, (count + 1) * sizeof(char *));
+    for (int i = 0; i < word.field_count; i++)
+        (*fields)[i] = word.data + word.starts[i];
+    (*fields)[count] = NULL;
+    if (!word.wild && !word.escaped)
+        return count;
+
+    // Globbing can turn a field into any number of paths, so the fields are gathered again
+    char **out = *fields;
+    int capacity = count + 1;
+    count = 0;
+    for (int i = 0; i < word.field_count; i++)
+    {
+        char *field = word.data + word.starts[i];
+        char **paths = &field;
+        int n = 1;
+        if (word.wild && is_glob_pattern(field))
+            n = glob_expand(field, &paths);
+        if (n == 0 || paths == &field)
+        {
+            unescape_field(field);
+            paths = &field;
+            n = 1;
+        }
+
+        if (count + n + 1 > capacity)
+        {
+            capacity = capacity * 2 + n;
+            char **grown = arena_alloc(&line_arena, capacity * sizeof(char *));
+            memcpy(grown, out, count * sizeof(char *));
+            out = grown;
+        }
+        memcpy(out + count, paths, n * sizeof(char *));
+        count += n;
+    }
+    out[count] = NULL;
+    *fields = out;
+    return count;
+}
+
+// Expands a here-document body marked by the parser: parameters, arithmetic and command substitutions, with
+// quotes left as they are. The result lives in the line arena, NULL means an error was reported
+char *expand_here_document(const char *raw)
+{
+    WordBuffer word;
+
+    word_init(&word, strlen(raw), 0);
+    word.here_document = 1;
+    if (expand_into(&word, raw) == -1)
+        return NULL;
+    return word.data;
+}
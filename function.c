@@ -0,0 +1,326 @@
+#include "myshell.h"
+
+#define FUNCTION_BUCKETS 64
+
+// A shell function: its body is parsed once, when the definition runs, and copied out of the line arena
+// into an arena of its own, so every call just walks the same tree
+typedef struct Function
+{
+    char *name;
+    Node *body;
+    Arena arena;
+    int active;   // calls currently running its body
+    int replaced; // redefined or unset while running, freed when the last call returns
+    struct Function *next;
+} Function;
+
+// A variable hidden by local, put back when the function that declared it returns
+typedef struct
+{
+    char *name;
+    char *value; // NULL when it was unset
+    int exported;
+    int depth;
+} LocalSave;
+
+static Function *function_table[FUNCTION_BUCKETS];
+static int function_count = 0;
+
+// Function calls currently running, 0 outside any function
+int function_depth = 0;
+
+// Saved locals, innermost call last; their strings live in local_arena, rewound as each call returns
+static LocalSave *local_saves = NULL;
+static int local_count = 0;
+static int local_capacity = 0;
+static Arena local_arena;
+
+// Bucket of a function name
+static unsigned int function_hash(const char *name)
+{
+    return hash_bytes(name, strlen(name)) % FUNCTION_BUCKETS;
+}
+
+// Copies the count words of an argv row, and its NULL terminator, into arena
+static char **copy_words(Arena *arena, char **words, int count)
+{
+    char **copy = arena_alloc(arena, (count + 1) * sizeof(char *));
+    for (int i = 0; i < count; i++)
+        copy[i] = arena_strdup(arena, words[i]);
+    copy[count] = NULL;
+    return copy;
+}
+
+// Copies a stage's chain of redirections into arena
+static Redirect *copy_redirects(Arena *arena, const Redirect *redirect)
+{
+    Redirect *head = NULL;
+    Redirect **tail = &head;
+
+    for (; redirect != NULL; redirect = redirect->next)
+    {
+        Redirect *copy = arena_alloc(arena, sizeof(Redirect));
+        *copy = *redirect;
+        copy->word = redirect->word != NULL ? arena_strdup(arena, redirect->word) : NULL;
+        copy->next = NULL;
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+// Copies a parsed list, with everything its nodes point to, into arena
+static Node *copy_tree(Arena *arena, const Node *list)
+{
+    Node *head = NULL;
+    Node **tail = &head;
+
+    for (const Node *node = list; node != NULL; node = node->next)
+    {
+        Node *copy = arena_alloc(arena, sizeof(Node));
+        *copy = *node;
+        copy->next = NULL;
+        if (node->type == NODE_PIPELINE)
+        {
+            copy->argv = arena_alloc(arena, (node->argv_count + 1) * sizeof(char **));
+            copy->argc = arena_alloc(arena, (node->argv_count + 1) * sizeof(int));
+            copy->redirects = arena_alloc(arena, (node->argv_count + 1) * sizeof(Redirect *));
+            for (int i = 0; i < node->argv_count; i++)
+            {
+                copy->argv[i] = copy_words(arena, node->argv[i], node->argc[i]);
+                copy->argc[i] = node->argc[i];
+                copy->redirects[i] = copy_redirects(arena, node->redirects[i]);
+            }
+        }
+        copy->cond = copy_tree(arena, node->cond);
+        copy->body = copy_tree(arena, node->body);
+        copy->else_part = copy_tree(arena, node->else_part);
+        copy->name = node->name != NULL ? arena_strdup(arena, node->name) : NULL;
+        copy->words = node->words != NULL ? copy_words(arena, node->words, node->word_count) : NULL;
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+// Frees a function, or leaves that to its last running call
+static void function_release(Function *function)
+{
+    if (function->active > 0)
+    {
+        function->replaced = 1;
+        return;
+    }
+    arena_free(&function->arena);
+    free(function);
+}
+
+// Finds the function called name and the link pointing to it, or returns NULL
+static Function *function_find(const char *name, Function ***link_out)
+{
+    Function **link = &function_table[function_hash(name)];
+    while (*link != NULL)
+    {
+        if (strcmp((*link)->name, name) == 0)
+        {
+            if (link_out != NULL)
+                *link_out = link;
+            return *link;
+        }
+        link = &(*link)->next;
+    }
+    return NULL;
+}
+
+// Returns 1 when name is a defined function; free of any lookup while no function is defined
+int is_function(const char *name)
+{
+    return function_count > 0 && function_find(name, NULL) != NULL;
+}
+
+// Calls visit with the name of every function
+void for_each_function(void (*visit)(const char *name))
+{
+    for (int i = 0; i < FUNCTION_BUCKETS; i++)
+    {
+        for (const Function *function = function_table[i]; function != NULL; function = function->next)
+            visit(function->name);
+    }
+}
+
+// Defines (or redefines) the function name with a copy of body
+void define_function(const char *name, const Node *body)
+{
+    Function *function = calloc(1, sizeof(Function));
+    if (function == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    function->name = arena_strdup(&function->arena, name);
+    function->body = copy_tree(&function->arena, body);
+
+    Function **link;
+    Function *old = function_find(name, &link);
+    if (old != NULL)
+    {
+        *link = old->next;
+        function_release(old);
+        function_count--;
+    }
+    unsigned int bucket = function_hash(name);
+    function->next = function_table[bucket];
+    function_table[bucket] = function;
+    function_count++;
+}
+
+// Removes the function name, returns 0 if it existed and -1 otherwise
+int unset_function(const char *name)
+{
+    Function **link;
+    Function *function = function_find(name, &link);
+    if (function == NULL)
+        return -1;
+    *link = function->next;
+    function_release(function);
+    function_count--;
+    return 0;
+}
+
+// Sets $1.. from args and $# to count, unsetting the parameters up to previous that are left over
+static void set_parameters(char **args, int count, int previous)
+{
+    char name[32];
+    char value[32];
+
+    for (int i = 1; i <= count || i <= previous; i++)
+    {
+        snprintf(name, sizeof(name), "$%d", i);
+        if (i <= count)
+            set_variable_value(name, args[i - 1]);
+        else
+            unset_variable(name);
+    }
+    snprintf(value, sizeof(value), "%d", count);
+    set_variable_value("$#", value);
+}
+
+// Puts back every variable a local of the call at depth, or deeper, has hidden
+static void locals_restore(int depth)
+{
+    while (local_count > 0 && local_saves[local_count - 1].depth >= depth)
+    {
+        LocalSave *save = &local_saves[--local_count];
+        if (save->value == NULL)
+            unset_variable(save->name);
+        else
+        {
+            set_variable_value(save->name, save->value);
+            if (save->exported)
+                export_variable(save->name);
+        }
+    }
+}
+
+// Runs the function argv[0] with argv[1].. as its positional parameters, which are put back afterwards
+// along with every variable it made local. The status is that of its last command, or the one return gave
+void function_builtin(char **argv)
+{
+    Function *function = function_find(argv[0], NULL);
+    const char *count_value = get_variable_value("$#");
+    int saved_count = count_value != NULL ? atoi(count_value) : 0;
+    int count = 0;
+    char name[32];
+
+    if (function == NULL)
+        return;
+
+    // The caller's parameters are copied before the call overwrites them
+    char **saved = arena_alloc(&line_arena, (saved_count + 1) * sizeof(char *));
+    for (int i = 1; i <= saved_count; i++)
+    {
+        snprintf(name, sizeof(name), "$%d", i);
+        const char *value = get_variable_value(name);
+        saved[i - 1] = arena_strdup(&line_arena, value != NULL ? value : "");
+    }
+    while (argv[count + 1] != NULL)
+        count++;
+    set_parameters(argv + 1, count, saved_count);
+
+    // The body starts out seeing the status of the command before the call in $?
+    function->active++;
+    function_depth++;
+    last_exit_status = status_before_builtin;
+    ArenaMark locals = arena_mark(&local_arena);
+    eval_function(function->body);
+    locals_restore(function_depth);
+    arena_rewind(&local_arena, locals);
+    function_depth--;
+    function->active--;
+
+    int status = last_exit_status;
+    set_parameters(saved, saved_count, count);
+    if (count_value == NULL)
+        unset_variable("$#");
+    if (function->replaced && function->active == 0)
+        function_release(function);
+    last_exit_status = status;
+}
+
+// Remembers the current value of the variable name, once per call, for locals_restore()
+static void local_save(const char *name)
+{
+    for (int i = local_count - 1; i >= 0 && local_saves[i].depth == function_depth; i--)
+    {
+        if (strcmp(local_saves[i].name, name) == 0)
+            return;
+    }
+
+    if (local_count == local_capacity)
+    {
+        int capacity = local_capacity == 0 ? 16 : local_capacity * 2;
+        LocalSave *grown = realloc(local_saves, capacity * sizeof(LocalSave));
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        local_saves = grown;
+        local_capacity = capacity;
+    }
+
+    const char *value = get_variable_value(name);
+    LocalSave *save = &local_saves[local_count++];
+    save->name = arena_strdup(&local_arena, name);
+    save->value = value != NULL ? arena_strdup(&local_arena, value) : NULL;
+    save->exported = value != NULL && is_exported(name);
+    save->depth = function_depth;
+}
+
+// local name[=value]...: makes each variable local to the running function, unset or set to value until
+// the function returns
+void local_builtin(char **argv)
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    if (function_depth == 0)
+    {
+        fprintf(stderr, "local: can only be used in a function\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        const char *arg = argv[i][0] == '$' ? argv[i] + 1 : argv[i];
+        const char *eq = strchr(arg, '=');
+        int len = eq != NULL ? (int)(eq - arg) : (int)strlen(arg);
+
+        snprintf(name, sizeof(name), "$%.*s", len, arg);
+        local_save(name);
+        if (eq != NULL)
+            set_variable_value(name, eq + 1);
+        else
+            unset_variable(name);
+    }
+}
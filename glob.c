@@ -0,0 +1,728 @@
+#include "myshell.h"
+
+#include <pthread.h>
+
+#define LISTING_BUCKETS 1024
+#define DIRENT_BUFFER_SIZE 65536
+#define MAX_SEGMENTS 256
+#define PARALLEL_WALK_THRESHOLD 64 // directories a ** walk reads alone before it shares the rest out
+#define MAX_WALKERS 8
+
+// Kinds of compiled pattern operations
+enum
+{
+    GLOB_LITERAL,
+    GLOB_ANY,
+    GLOB_STAR,
+    GLOB_CLASS
+};
+
+// One operation of a compiled path segment
+typedef struct
+{
+    int type;
+    const char *text; // GLOB_LITERAL: the unescaped bytes to match
+    int len;
+    const unsigned char *set; // GLOB_CLASS: a bitmap of the 256 bytes it matches
+} GlobOp;
+
+// One '/'-separated part of a pattern, compiled once per expansion
+typedef struct
+{
+    const char *literal; // unescaped text when it has no wildcards, NULL otherwise
+    GlobOp *ops;
+    int count;
+    int globstar; // exactly "**"
+    int dot;      // starts with a literal '.', so it can match names starting with one
+} Segment;
+
+// One name in a directory listing
+typedef struct
+{
+    const char *name;
+    unsigned char type; // the d_type of the entry, never DT_UNKNOWN
+    signed char is_dir; // for a link, whether it leads to a directory; -1 until looked up
+} GlobEntry;
+
+// The entries of one directory, read once per command and shared by every pattern that looks into it
+typedef struct Listing
+{
+    const char *path; // "" for the current directory, otherwise ending in '/'
+    unsigned int hash;
+    GlobEntry *entries;
+    int count;
+    struct Listing *next;   // in its bucket
+    struct Listing *walked; // in the list a ** walker read it into
+} Listing;
+
+// Shared by the threads walking a tree for **: the directories still to read and the listings read so far
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    char **queue;
+    int next; // first directory no walker has taken
+    int count;
+    int capacity;
+    int busy; // walkers reading a directory, whose subdirectories are not queued yet
+    Listing *done;
+} Walk;
+
+typedef struct
+{
+    Walk *walk;
+    Arena *arena;
+} Walker;
+
+// Set with set -o noglob: words are never expanded to file names
+int noglob = 0;
+
+// The listings read for the current command, in their own arena so the line arena can be rewound under them
+static Listing *listings[LISTING_BUCKETS];
+static Arena glob_arena;
+static Arena walker_arenas[MAX_WALKERS];
+static int cache_used = 0;
+
+// The expansion in progress: its segments and the paths matched so far, in the line arena
+static Segment segments[MAX_SEGMENTS];
+static int segment_count;
+static int trailing_globstar; // the pattern ended in "**", which matches the directory it starts from too
+static char **matches;
+static int match_count;
+static int match_capacity;
+
+// Forgets every directory listing, so the next command reads the directories again
+void glob_cache_reset()
+{
+    if (!cache_used)
+        return;
+    memset(listings, 0, sizeof(listings));
+    arena_reset(&glob_arena);
+    for (int i = 0; i < MAX_WALKERS; i++)
+        arena_reset(&walker_arenas[i]);
+    cache_used = 0;
+}
+
+// Reads the directory path with getdents64(2), many entries per system call, and calls visit with every entry
+// but "." and "..", and the open directory for fstatat(2) to look at it. Returns -1 when it cannot be opened
+int read_directory(const char *path, void (*visit)(int fd, const struct dirent64 *entry, void *context),
+                   void *context)
+{
+    char buffer[DIRENT_BUFFER_SIZE];
+
+    int fd = open(path[0] != '\0' ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    ssize_t n;
+    while ((n = getdents64(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t offset = 0; offset < n;)
+        {
+            const struct dirent64 *entry = (const struct dirent64 *)(buffer + offset);
+            offset += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            visit(fd, entry, context);
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// A listing being read and the arena it grows in
+typedef struct
+{
+    Arena *arena;
+    Listing *listing;
+    int capacity;
+} ListingRead;
+
+// Adds one entry to the listing being read. The type comes from d_type, so nothing is stat'ed unless the
+// file system leaves the type unknown
+static void listing_add(int fd, const struct dirent64 *entry, void *context)
+{
+    ListingRead *read = context;
+    Listing *listing = read->listing;
+    struct stat st;
+
+    if (listing->count == read->capacity)
+    {
+        read->capacity = read->capacity == 0 ? 64 : read->capacity * 2;
+        GlobEntry *grown = arena_alloc(read->arena, read->capacity * sizeof(GlobEntry));
+        memcpy(grown, listing->entries, listing->count * sizeof(GlobEntry));
+        listing->entries = grown;
+    }
+
+    GlobEntry *out = &listing->entries[listing->count++];
+    out->name = arena_strdup(read->arena, entry->d_name);
+    out->type = entry->d_type;
+    if (out->type == DT_UNKNOWN)
+    {
+        // Only some file systems leave the type out
+        out->type = DT_REG;
+        if (fstatat(fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+            out->type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+    }
+    out->is_dir = out->type == DT_DIR ? 1 : out->type == DT_LNK ? -1 : 0;
+}
+
+// Reads the directory path into a listing allocated from arena, "." and ".." left out. Only touches arena, so
+// walkers can read directories at the same time. A directory that cannot be read gives an empty listing
+static Listing *listing_read(Arena *arena, const char *path)
+{
+    Listing *listing = arena_alloc(arena, sizeof(Listing));
+    ListingRead read = {arena, listing, 0};
+
+    listing->path = path;
+    listing->hash = hash_bytes(path, strlen(path));
+    listing->entries = NULL;
+    listing->count = 0;
+    listing->next = NULL;
+    listing->walked = NULL;
+
+    read_directory(path, listing_add, &read);
+    return listing;
+}
+
+// Adds a listing to the cache
+static void listing_insert(Listing *listing)
+{
+    Listing **bucket = &listings[listing->hash % LISTING_BUCKETS];
+    listing->next = *bucket;
+    *bucket = listing;
+    cache_used = 1;
+}
+
+// Returns the listing of directory path, read at most once per command
+static Listing *listing_get(const char *path)
+{
+    unsigned int hash = hash_bytes(path, strlen(path));
+    for (Listing *listing = listings[hash % LISTING_BUCKETS]; listing != NULL; listing = listing->next)
+    {
+        if (listing->hash == hash && strcmp(listing->path, path) == 0)
+            return listing;
+    }
+
+    Listing *listing = listing_read(&glob_arena, arena_strdup(&glob_arena, path));
+    listing_insert(listing);
+    return listing;
+}
+
+// Returns 1 when the entry whose full path is in path is a directory, following a link the first time
+static int entry_is_dir(GlobEntry *entry, const char *path)
+{
+    struct stat st;
+    if (entry->is_dir == -1)
+        entry->is_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    return entry->is_dir;
+}
+
+// Parses the bracket expression whose '[' is just before p into set, returns the character after its ']'
+// or NULL when it is not closed. "[!...]" and "[^...]" negate, a ']' first is a member, and ranges,
+// backslash escapes and the classes [:alpha:] and the like are understood
+static const char *parse_class(const char *p, unsigned char *set)
+{
+    static const struct
+    {
+        const char *name;
+        int (*test)(int c);
+    } classes[] = {{"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum}, {"upper", isupper},
+                   {"lower", islower}, {"space", isspace}, {"punct", ispunct}, {"xdigit", isxdigit},
+                   {"blank", isblank}, {"cntrl", iscntrl}, {"print", isprint}, {"graph", isgraph}};
+    int negate = *p == '!' || *p == '^';
+
+    memset(set, 0, 32);
+    p += negate;
+    for (int first = 1; *p != '\0' && (*p != ']' || first); first = 0)
+    {
+        const char *close = p[0] == '[' && p[1] == ':' ? strstr(p + 2, ":]") : NULL;
+        if (close != NULL)
+        {
+            size_t len = close - p - 2;
+            for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++)
+            {
+                if (strlen(classes[i].name) != len || strncmp(classes[i].name, p + 2, len) != 0)
+                    continue;
+                for (int c = 1; c < 256; c++)
+                {
+                    if (classes[i].test(c))
+                        set[c / 8] |= 1 << (c % 8);
+                }
+            }
+            p = close + 2;
+            continue;
+        }
+
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        unsigned char low = *p++;
+        unsigned char high = low;
+        if (*p == '-' && p[1] != ']' && p[1] != '\0')
+        {
+            p++;
+            if (*p == '\\' && p[1] != '\0')
+                p++;
+            high = *p++;
+        }
+        for (int c = low; c <= high; c++)
+            set[c / 8] |= 1 << (c % 8);
+    }
+    if (*p != ']')
+        return NULL;
+
+    for (int i = 0; negate && i < 32; i++)
+        set[i] = ~set[i];
+    set[0] &= ~1;
+    return p + 1;
+}
+
+// Returns 1 when word holds an unescaped '*' or '?', or a closed '[' bracket expression
+int is_glob_pattern(const char *word)
+{
+    unsigned char set[32];
+
+    for (const char *p = word; *p != '\0'; p++)
+    {
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        else if (*p == '*' || *p == '?' || (*p == '[' && parse_class(p + 1, set) != NULL))
+            return 1;
+    }
+    return 0;
+}
+
+// Compiles the len bytes of pattern at text into seg: a segment without wildcards becomes its unescaped
+// text, anything else a list of operations with runs of literal bytes merged and runs of '*' collapsed
+static void compile_segment(Segment *seg, const char *text, size_t len)
+{
+    char *segment = arena_strndup(&line_arena, text, len);
+    char *literal = arena_alloc(&line_arena, len + 1);
+    GlobOp *ops = arena_alloc(&line_arena, (len + 1) * sizeof(GlobOp));
+    unsigned char *set = NULL;
+    int count = 0;
+    int wild = 0;
+    size_t used = 0;
+
+    seg->globstar = strcmp(segment, "**") == 0;
+    for (const char *p = segment; *p != '\0';)
+    {
+        const char *end = NULL;
+        if (*p == '[')
+        {
+            set = arena_alloc(&line_arena, 32);
+            end = parse_class(p + 1, set);
+        }
+
+        if (*p == '*' || *p == '?' || end != NULL)
+        {
+            wild = 1;
+            if (*p == '*' && count > 0 && ops[count - 1].type == GLOB_STAR)
+            {
+                p++;
+                continue;
+            }
+            GlobOp *op = &ops[count++];
+            op->type = *p == '*' ? GLOB_STAR : *p == '?' ? GLOB_ANY : GLOB_CLASS;
+            op->set = set;
+            p = end != NULL ? end : p + 1;
+            continue;
+        }
+
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        if (count == 0 || ops[count - 1].type != GLOB_LITERAL)
+        {
+            ops[count].type = GLOB_LITERAL;
+            ops[count].text = literal + used;
+            ops[count++].len = 0;
+        }
+        literal[used++] = *p++;
+        ops[count - 1].len++;
+    }
+    literal[used] = '\0';
+
+    seg->literal = wild ? NULL : literal;
+    seg->ops = ops;
+    seg->count = count;
+    seg->dot = used > 0 && count > 0 && ops[0].type == GLOB_LITERAL && ops[0].text[0] == '.';
+}
+
+// Whether the operation at op matches the one byte at s
+static int op_matches_byte(const GlobOp *op, const char *s)
+{
+    unsigned char c = (unsigned char)*s;
+    return c != '\0' && (op->type == GLOB_ANY || (op->type == GLOB_CLASS && (op->set[c / 8] & (1 << (c % 8)))));
+}
+
+// Matches name against a compiled segment, going back to the last '*' on a mismatch, so no name is
+// looked at more than once per '*'. A literal end is checked first, which rules out most names at once
+static int segment_match(const Segment *seg, const char *name)
+{
+    const GlobOp *ops = seg->ops;
+    int count = seg->count;
+
+    if (name[0] == '.' && !seg->dot)
+        return 0;
+    if (count > 1 && ops[count - 1].type == GLOB_LITERAL)
+    {
+        size_t len = strlen(name);
+        const GlobOp *last = &ops[count - 1];
+        if (len < (size_t)last->len || memcmp(name + len - last->len, last->text, last->len) != 0)
+            return 0;
+    }
+
+    const char *s = name;
+    const char *star_s = NULL;
+    int star_op = -1;
+    int op = 0;
+    while (1)
+    {
+        if (op < count)
+        {
+            const GlobOp *o = &ops[op];
+            if (o->type == GLOB_STAR)
+            {
+                // A '*' at the end matches whatever is left
+                if (op == count - 1)
+                    return 1;
+                star_op = op++;
+                star_s = s;
+                continue;
+            }
+            if (o->type == GLOB_LITERAL && strncmp(s, o->text, o->len) == 0)
+            {
+                s += o->len;
+                op++;
+                continue;
+            }
+            if (op_matches_byte(o, s))
+            {
+                s++;
+                op++;
+                continue;
+            }
+        }
+        else if (*s == '\0')
+        {
+            return 1;
+        }
+
+        // Let the last '*' take one more character and try again from the operation after it
+        if (star_op == -1 || *star_s == '\0')
+            return 0;
+        s = ++star_s;
+        op = star_op + 1;
+    }
+}
+
+// Adds the len bytes of path to the matches
+static void add_match(const char *path, size_t len)
+{
+    if (match_count == match_capacity)
+    {
+        int capacity = match_capacity == 0 ? 16 : match_capacity * 2;
+        char **grown = arena_alloc(&line_arena, capacity * sizeof(char *));
+        memcpy(grown, matches, match_count * sizeof(char *));
+        matches = grown;
+        match_capacity = capacity;
+    }
+    matches[match_count++] = arena_strndup(&line_arena, path, len);
+}
+
+// Takes directories off the shared queue and reads them until none is left and no walker can queue more
+static void *walker_run(void *arg)
+{
+    Walker *walker = arg;
+    Walk *walk = walker->walk;
+
+    pthread_mutex_lock(&walk->lock);
+    while (1)
+    {
+        while (walk->next == walk->count && walk->busy > 0 && !interrupted)
+            pthread_cond_wait(&walk->wake, &walk->lock);
+        if (walk->next == walk->count || interrupted)
+            break;
+
+        const char *path = walk->queue[walk->next++];
+        walk->busy++;
+        pthread_mutex_unlock(&walk->lock);
+
+        Listing *listing = listing_read(walker->arena, path);
+        char **subdirs = arena_alloc(walker->arena, (listing->count + 1) * sizeof(char *));
+        int subdir_count = 0;
+        size_t path_len = strlen(path);
+        for (int i = 0; i < listing->count; i++)
+        {
+            const GlobEntry *entry = &listing->entries[i];
+            if (entry->type != DT_DIR || entry->name[0] == '.')
+                continue;
+            size_t len = strlen(entry->name);
+            char *subdir = arena_alloc(walker->arena, path_len + len + 2);
+            memcpy(subdir, path, path_len);
+            memcpy(subdir + path_len, entry->name, len);
+            memcpy(subdir + path_len + len, "/", 2);
+            subdirs[subdir_count++] = subdir;
+        }
+
+        pthread_mutex_lock(&walk->lock);
+        if (walk->count + subdir_count > walk->capacity)
+        {
+            int capacity = walk->capacity * 2 + subdir_count;
+            char **grown = realloc(walk->queue, capacity * sizeof(char *));
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            walk->queue = grown;
+            walk->capacity = capacity;
+        }
+        memcpy(walk->queue + walk->count, subdirs, subdir_count * sizeof(char *));
+        walk->count += subdir_count;
+        listing->walked = walk->done;
+        walk->done = listing;
+        walk->busy--;
+        pthread_cond_broadcast(&walk->wake);
+    }
+    pthread_cond_broadcast(&walk->wake);
+    pthread_mutex_unlock(&walk->lock);
+    return NULL;
+}
+
+// Returns how many threads walk a large tree: one per processor, up to MAX_WALKERS
+static int walker_count()
+{
+    static int count = 0;
+    if (count == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus > MAX_WALKERS ? MAX_WALKERS : cpus > 1 ? (int)cpus : 1;
+    }
+    return count;
+}
+
+// Reads the directories in queue from first on, and every directory below them, with walker_count()
+// threads, each on its own arena; the listings join the cache and the directories are added to *tree
+static void walk_parallel(char **queue, int first, int count, char ***tree, int *tree_count, int *tree_capacity)
+{
+    int threads = walker_count();
+    pthread_t ids[MAX_WALKERS];
+    Walker walkers[MAX_WALKERS];
+    Walk walk;
+    sigset_t all;
+    sigset_t old_mask;
+
+    walk.queue = malloc((count - first) * 2 * sizeof(char *));
+    if (walk.queue == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(walk.queue, queue + first, (count - first) * sizeof(char *));
+    walk.next = 0;
+    walk.count = count - first;
+    walk.capacity = (count - first) * 2;
+    walk.busy = 0;
+    walk.done = NULL;
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.wake, NULL);
+
+    // Signals stay with the shell's own thread, whose handlers expect it
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old_mask);
+    int started = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        walkers[i].walk = &walk;
+        walkers[i].arena = &walker_arenas[i];
+        if (pthread_create(&ids[started], NULL, walker_run, &walkers[i]) == 0)
+            started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (started == 0)
+        walker_run(&walkers[0]);
+    for (int i = 0; i < started; i++)
+        pthread_join(ids[i], NULL);
+
+    for (Listing *listing = walk.done; listing != NULL; listing = listing->walked)
+    {
+        listing_insert(listing);
+        if (*tree_count == *tree_capacity)
+        {
+            *tree_capacity *= 2;
+            char **grown = arena_alloc(&line_arena, *tree_capacity * sizeof(char *));
+            memcpy(grown, *tree, *tree_count * sizeof(char *));
+            *tree = grown;
+        }
+        (*tree)[(*tree_count)++] = (char *)listing->path;
+    }
+    pthread_cond_destroy(&walk.wake);
+    pthread_mutex_destroy(&walk.lock);
+    free(walk.queue);
+}
+
+// Collects base and every directory below it that does not start with '.', links not followed, into *tree.
+// A tree larger than PARALLEL_WALK_THRESHOLD directories is finished by walk_parallel() when there is more
+// than one processor
+static int collect_tree(const char *base, char ***tree)
+{
+    int capacity = PARALLEL_WALK_THRESHOLD * 2;
+    char **queue = arena_alloc(&line_arena, capacity * sizeof(char *));
+    int count = 0;
+    int tree_capacity = capacity;
+    int tree_count = 0;
+
+    *tree = arena_alloc(&line_arena, tree_capacity * sizeof(char *));
+    queue[count++] = arena_strdup(&glob_arena, base);
+    for (int next = 0; next < count && !interrupted; next++)
+    {
+        if (next >= PARALLEL_WALK_THRESHOLD && count - next > 1 && walker_count() > 1)
+        {
+            walk_parallel(queue, next, count, tree, &tree_count, &tree_capacity);
+            break;
+        }
+
+        Listing *listing = listing_get(queue[next]);
+        (*tree)[tree_count++] = (char *)listing->path;
+        if (tree_count == tree_capacity)
+        {
+            char **grown = arena_alloc(&line_arena, tree_capacity * 2 * sizeof(char *));
+            memcpy(grown, *tree, tree_count * sizeof(char *));
+            *tree = grown;
+            tree_capacity *= 2;
+        }
+
+        size_t path_len = strlen(listing->path);
+        for (int i = 0; i < listing->count; i++)
+        {
+            const GlobEntry *entry = &listing->entries[i];
+            if (entry->type != DT_DIR || entry->name[0] == '.')
+                continue;
+            if (count == capacity)
+            {
+                char **grown = arena_alloc(&line_arena, capacity * 2 * sizeof(char *));
+                memcpy(grown, queue, count * sizeof(char *));
+                queue = grown;
+                capacity *= 2;
+            }
+            size_t len = strlen(entry->name);
+            char *subdir = arena_alloc(&glob_arena, path_len + len + 2);
+            memcpy(subdir, listing->path, path_len);
+            memcpy(subdir + path_len, entry->name, len);
+            memcpy(subdir + path_len + len, "/", 2);
+            queue[count++] = subdir;
+        }
+    }
+    return tree_count;
+}
+
+// Matches segments from index on below the directory whose path, ending in '/' unless empty, fills the
+// first len bytes of path, a buffer of PATH_MAX bytes, adding every path that matches them all
+static void walk(char *path, size_t len, int index)
+{
+    const Segment *seg = &segments[index];
+    int last = index == segment_count - 1;
+    struct stat st;
+
+    if (seg->literal != NULL)
+    {
+        // A segment without wildcards is not looked up in its directory: the next one, or lstat(), shows
+        // whether it is there
+        size_t n = strlen(seg->literal);
+        if (len + n + 2 > PATH_MAX)
+            return;
+        memcpy(path + len, seg->literal, n);
+        path[len + n] = '\0';
+        if (last && lstat(path, &st) == 0)
+            add_match(path, len + n);
+        else if (!last)
+        {
+            path[len + n] = '/';
+            walk(path, len + n + 1, index + 1);
+        }
+        return;
+    }
+
+    if (seg->globstar)
+    {
+        // ** matches this directory and every one below it
+        char **tree;
+        path[len] = '\0';
+        if (trailing_globstar && index == segment_count - 2 && len > 0)
+            add_match(path, len);
+        int count = collect_tree(path, &tree);
+        for (int i = 0; i < count && !interrupted; i++)
+        {
+            size_t n = strlen(tree[i]);
+            if (n + 2 > PATH_MAX)
+                continue;
+            memcpy(path, tree[i], n);
+            walk(path, n, index + 1);
+        }
+        return;
+    }
+
+    path[len] = '\0';
+    Listing *listing = listing_get(path);
+    for (int i = 0; i < listing->count; i++)
+    {
+        GlobEntry *entry = &listing->entries[i];
+        if (!segment_match(seg, entry->name))
+            continue;
+        size_t n = strlen(entry->name);
+        if (len + n + 2 > PATH_MAX)
+            continue;
+        memcpy(path + len, entry->name, n);
+        path[len + n] = '\0';
+        if (last)
+            add_match(path, len + n);
+        else if (entry_is_dir(entry, path))
+        {
+            path[len + n] = '/';
+            walk(path, len + n + 1, index + 1);
+        }
+    }
+}
+
+// Expands pattern, in which a backslash escapes the character after it, to the paths it matches, sorted,
+// stored in the line arena. Directories read for one command are read only once, whatever the number of
+// patterns looking into them. "**" as a whole segment matches any number of directories, and alone at the
+// end every file below them. Returns the number of matches, 0 when there are none
+int glob_expand(const char *pattern, char ***out)
+{
+    char path[PATH_MAX];
+    long long start = trace_start();
+
+    // Where a file list ends up depends on the file system, which a snapshot would not see change
+    if (rc_recording)
+        rc_record(NULL, NULL);
+
+    segment_count = 0;
+    for (const char *p = pattern; segment_count < MAX_SEGMENTS - 1;)
+    {
+        const char *end = p;
+        while (*end != '\0' && *end != '/')
+            end += end[0] == '\\' && end[1] != '\0' ? 2 : 1;
+        compile_segment(&segments[segment_count++], p, end - p);
+        if (*end == '\0')
+            break;
+        p = end + 1;
+    }
+    trailing_globstar = segments[segment_count - 1].globstar;
+    if (trailing_globstar)
+        compile_segment(&segments[segment_count++], "*", 1);
+
+    matches = NULL;
+    match_count = 0;
+    match_capacity = 0;
+    walk(path, 0, 0);
+    if (match_count > 1)
+        qsort(matches, match_count, sizeof(char *), compare_strings);
+    trace_span("glob", start, pattern, 0);
+
+    *out = matches;
+    return match_count;
+}
@@ -0,0 +1,326 @@
+#include "myshell.h"
+
+#define DEFAULT_HISTORY_SIZE 1000
+#define HISTORY_MAP_WINDOW ((size_t)64 << 20) // address space reserved for the file, remapped if it outgrows it
+#define TRIGRAM_BUCKETS 65536
+
+// Where one history entry lives in the log, the trailing newline is not counted
+typedef struct
+{
+    size_t offset;
+    int length;
+} HistoryEntry;
+
+// Entry sequence numbers (ascending) that contain a given trigram bucket
+typedef struct
+{
+    int *seqs;
+    int count;
+    int capacity;
+} PostingList;
+
+// The log: an append-only file mapped read-only, or a heap buffer when no file can be used
+static int history_fd = -1;
+static char *history_base = NULL;
+static size_t history_window = 0;
+static size_t history_bytes = 0;
+
+// Ring buffer of the newest entries; entry seq lives in slot seq % history_capacity
+static HistoryEntry *history_ring = NULL;
+static int history_capacity = 0;
+static int history_next_seq = 0;
+int history_count = 0;
+
+// Trigram index over the live entries so a search only verifies candidate entries
+static PostingList trigram_index[TRIGRAM_BUCKETS];
+
+// Sequence number of the oldest live entry
+static int oldest_seq()
+{
+    return history_next_seq - history_count;
+}
+
+// Pointer to the text of entry seq
+static const char *entry_text(int seq, int *length)
+{
+    HistoryEntry *entry = &history_ring[seq % history_capacity];
+    *length = entry->length;
+    return history_base + entry->offset;
+}
+
+// Bucket of the trigram starting at s
+static unsigned int trigram_bucket(const char *s)
+{
+    unsigned int t = (unsigned char)s[0] << 16 | (unsigned char)s[1] << 8 | (unsigned char)s[2];
+    return (t * 2654435761u) >> 16 & (TRIGRAM_BUCKETS - 1);
+}
+
+// Records that entry seq contains every trigram of its text
+static void index_entry(int seq, const char *text, int length)
+{
+    for (int i = 0; i + 3 <= length; i++)
+    {
+        PostingList *list = &trigram_index[trigram_bucket(text + i)];
+        if (list->count > 0 && list->seqs[list->count - 1] == seq)
+            continue;
+
+        if (list->count == list->capacity)
+        {
+            // Drop entries that fell out of the ring before deciding to grow
+            int live = 0;
+            while (live < list->count && list->seqs[live] < oldest_seq())
+                live++;
+            memmove(list->seqs, list->seqs + live, (list->count - live) * sizeof(int));
+            list->count -= live;
+
+            if (list->count * 2 > list->capacity || list->capacity == 0)
+            {
+                int capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+                int *seqs = realloc(list->seqs, capacity * sizeof(int));
+                if (seqs == NULL)
+                    return; // The index is only a filter, a missing posting just costs a slower search
+                list->seqs = seqs;
+                list->capacity = capacity;
+            }
+        }
+        list->seqs[list->count++] = seq;
+    }
+}
+
+// Adds an entry that is already in the log to the ring and the index
+static void remember_entry(size_t offset, int length)
+{
+    int seq = history_next_seq++;
+    history_ring[seq % history_capacity].offset = offset;
+    history_ring[seq % history_capacity].length = length;
+    if (history_count < history_capacity)
+        history_count++;
+
+    index_entry(seq, history_base + offset, length);
+}
+
+// Maps the history file with room to grow, returns 0 on success
+static int map_history_file(size_t size)
+{
+    size_t window = HISTORY_MAP_WINDOW;
+    while (window < size * 2)
+        window *= 2;
+
+    void *base = mmap(NULL, window, PROT_READ, MAP_SHARED, history_fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    if (history_base != NULL)
+        munmap(history_base, history_window);
+    history_base = base;
+    history_window = window;
+    return 0;
+}
+
+// Rewrites the log keeping only the bytes from keep_from on, so the file does not grow forever
+// Returns 0 when the compacted file is now the one mapped
+static int compact_history_file(const char *path, size_t keep_from)
+{
+    char tmp_path[MAX_COMMAND_LENGTH];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+        return -1;
+
+    size_t len = history_bytes - keep_from;
+    if (write(fd, history_base + keep_from, len) != (ssize_t)len || rename(tmp_path, path) != 0)
+    {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+
+    // Switch over to the compacted file
+    int new_fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC);
+    if (new_fd == -1)
+        return -1;
+
+    int old_fd = history_fd;
+    history_fd = new_fd;
+    if (map_history_file(len) == -1)
+    {
+        close(new_fd);
+        history_fd = old_fd;
+        return -1;
+    }
+    close(old_fd);
+    history_bytes = len;
+    return 0;
+}
+
+// Opens the history log ($HISTFILE, default ~/.myshell_history) and loads its newest $HISTSIZE entries
+void history_init()
+{
+    char path[MAX_COMMAND_LENGTH];
+    const char *histfile = get_variable_value("$HISTFILE");
+    const char *histsize = get_variable_value("$HISTSIZE");
+    const char *home = getenv("HOME");
+
+    history_capacity = histsize != NULL && atoi(histsize) > 0 ? atoi(histsize) : DEFAULT_HISTORY_SIZE;
+    history_ring = malloc(history_capacity * sizeof(HistoryEntry));
+    if (history_ring == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (histfile != NULL)
+        snprintf(path, sizeof(path), "%s", histfile);
+    else if (home != NULL)
+        snprintf(path, sizeof(path), "%s/.myshell_history", home);
+    else
+        return;
+
+    struct stat st;
+    history_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (history_fd == -1 || fstat(history_fd, &st) == -1 || map_history_file(st.st_size) == -1)
+    {
+        if (history_fd != -1)
+            close(history_fd);
+        history_fd = -1;
+        return;
+    }
+    history_bytes = st.st_size;
+
+    // Walk back from the end to find where the newest history_capacity entries start
+    size_t keep_from = history_bytes;
+    int found = 0;
+    while (keep_from > 0 && found < history_capacity)
+    {
+        const char *nl = keep_from > 1 ? memrchr(history_base, '\n', keep_from - 1) : NULL;
+        keep_from = nl != NULL ? (size_t)(nl - history_base) + 1 : 0;
+        found++;
+    }
+
+    // Once most of the file is entries nobody will see again, rewrite it
+    if (keep_from > history_bytes / 2 && compact_history_file(path, keep_from) == 0)
+        keep_from = 0;
+
+    for (size_t offset = keep_from; offset < history_bytes;)
+    {
+        const char *nl = memchr(history_base + offset, '\n', history_bytes - offset);
+        size_t end = nl != NULL ? (size_t)(nl - history_base) : history_bytes;
+        if (end > offset)
+            remember_entry(offset, (int)(end - offset));
+        offset = end + 1;
+    }
+}
+
+// Appends a command to the history log; the ring drops the oldest entry when full, nothing is shifted
+void add_to_history(const char *command)
+{
+    int length = strlen(command);
+    size_t offset;
+
+    if (history_ring == NULL || length == 0)
+        return;
+
+    if (history_fd != -1)
+    {
+        char line[MAX_COMMAND_LENGTH + 1];
+        if (length > MAX_COMMAND_LENGTH - 1)
+            length = MAX_COMMAND_LENGTH - 1;
+        memcpy(line, command, length);
+        line[length] = '\n';
+
+        // O_APPEND puts the entry at the real end even if another shell wrote meanwhile
+        if (write(history_fd, line, length + 1) != length + 1)
+            return;
+        history_bytes = lseek(history_fd, 0, SEEK_CUR);
+        offset = history_bytes - length - 1;
+
+        // The entry is in the file either way, but it can only be shown once it is inside the mapping
+        if (history_bytes > history_window && map_history_file(history_bytes) == -1)
+            return;
+    }
+    else
+    {
+        // No file: keep the log in a growing heap buffer
+        if (history_bytes + length + 1 > history_window)
+        {
+            size_t window = history_window == 0 ? 4096 : history_window * 2;
+            while (window < history_bytes + length + 1)
+                window *= 2;
+            char *base = realloc(history_base, window);
+            if (base == NULL)
+                return;
+            history_base = base;
+            history_window = window;
+        }
+        offset = history_bytes;
+        memcpy(history_base + offset, command, length);
+        history_base[offset + length] = '\n';
+        history_bytes += length + 1;
+    }
+
+    remember_entry(offset, length);
+}
+
+// Copies history entry index (0 is the oldest kept) into out, returns its length or -1
+int history_get(int index, char *out, size_t size)
+{
+    int length;
+
+    if (index < 0 || index >= history_count)
+        return -1;
+
+    const char *text = entry_text(oldest_seq() + index, &length);
+    if ((size_t)length >= size)
+        length = size - 1;
+    memcpy(out, text, length);
+    out[length] = '\0';
+    return length;
+}
+
+// Finds the newest entry older than index before that contains query, returns its index or -1
+int history_search(const char *query, int before)
+{
+    int query_len = strlen(query);
+    int oldest = oldest_seq();
+    int length;
+
+    if (before > history_count)
+        before = history_count;
+
+    if (query_len < 3)
+    {
+        // Too short for the index, scan back from the newest entry
+        for (int seq = oldest + before - 1; seq >= oldest; seq--)
+        {
+            const char *text = entry_text(seq, &length);
+            if (memmem(text, length, query, query_len) != NULL)
+                return seq - oldest;
+        }
+        return -1;
+    }
+
+    // Only entries in the shortest posting list of the query's trigrams can match
+    PostingList *best = &trigram_index[trigram_bucket(query)];
+    for (int i = 1; i + 3 <= query_len; i++)
+    {
+        PostingList *list = &trigram_index[trigram_bucket(query + i)];
+        if (list->count < best->count)
+            best = list;
+    }
+
+    for (int i = best->count - 1; i >= 0; i--)
+    {
+        int seq = best->seqs[i];
+        if (seq < oldest)
+            break;
+        if (seq - oldest >= before)
+            continue;
+
+        const char *text = entry_text(seq, &length);
+        if (memmem(text, length, query, query_len) != NULL)
+            return seq - oldest;
+    }
+    return -1;
+}
@@ -0,0 +1,641 @@
+#include "myshell.h"
+
+#define CHILD_EVENT_RING 256
+
+// A child state change collected by the SIGCHLD handler
+typedef struct
+{
+    pid_t pid;
+    int status;
+    struct rusage usage;
+} ChildEvent;
+
+// Ring filled by the handler and drained by the shell; the handler only ever moves the head
+static ChildEvent child_events[CHILD_EVENT_RING];
+static volatile sig_atomic_t events_head = 0;
+static volatile sig_atomic_t events_overflow = 0;
+static int events_tail = 0;
+
+// Jobs in launch order, plus released jobs kept for reuse
+static Job **job_table = NULL;
+static int job_count = 0;
+static int job_capacity = 0;
+static Job *free_jobs = NULL;
+
+// Set while time runs a pipeline, so the job is copied into finished_job when it finishes
+int keep_finished_job = 0;
+Job finished_job;
+
+// Reaps every child that changed state into the ring, so finished children never linger as zombies
+// A full ring leaves the remaining children for collect_child_events to pick up
+static void handle_sigchld()
+{
+    int saved_errno = errno;
+    int status;
+
+    while (1)
+    {
+        if ((events_head + 1) % CHILD_EVENT_RING == events_tail)
+        {
+            events_overflow = 1;
+            break;
+        }
+
+        ChildEvent *event = &child_events[events_head];
+        pid_t child = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &event->usage);
+        if (child <= 0)
+            break;
+        event->pid = child;
+        event->status = status;
+        events_head = (events_head + 1) % CHILD_EVENT_RING;
+    }
+    errno = saved_errno;
+}
+
+// Applies one state change to the job owning pid, keeping what a finished stage used and closing its
+// exec span; a child that belongs to no job may be a coprocess, anything else is dropped
+static void job_update(pid_t child, int status, const struct rusage *usage)
+{
+    for (int j = 0; j < job_count; j++)
+    {
+        Job *job = job_table[j];
+        for (int i = 0; i < job->count; i++)
+        {
+            if (job->pids[i] != child || (job->reaped & (1u << i)))
+                continue;
+
+            if (WIFSTOPPED(status))
+                job->stopped = 1;
+            else if (WIFCONTINUED(status))
+                job->stopped = 0;
+            else
+            {
+                job->statuses[i] = status;
+                job->usage[i] = *usage;
+                job->reaped |= 1u << i;
+                trace_span("exec", job->launched[i], job->command, child);
+                job->running--;
+            }
+            return;
+        }
+    }
+    if (!WIFSTOPPED(status) && !WIFCONTINUED(status))
+        coproc_exited(child, status);
+}
+
+// Moves collected state changes into the job table; must run with SIGCHLD blocked
+static void collect_child_events()
+{
+    int status;
+    struct rusage usage;
+    pid_t child;
+
+    while (events_tail != events_head)
+    {
+        const ChildEvent *event = &child_events[events_tail];
+        job_update(event->pid, event->status, &event->usage);
+        events_tail = (events_tail + 1) % CHILD_EVENT_RING;
+    }
+
+    // Anything the handler had no room for is still waiting to be reaped
+    events_overflow = 0;
+    while ((child = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0)
+        job_update(child, status, &usage);
+}
+
+// Blocks SIGCHLD, saving the previous mask in old
+void block_child_signal(sigset_t *old)
+{
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, old);
+}
+
+// Applies the child state changes collected so far, for the coprocesses, which are outside the job table
+void job_collect()
+{
+    sigset_t old;
+    block_child_signal(&old);
+    collect_child_events();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+// Sends the stopped jobs SIGHUP and SIGCONT so they do not outlive the shell stopped
+static void hangup_stopped_jobs()
+{
+    for (int j = 0; j < job_count; j++)
+    {
+        Job *job = job_table[j];
+        if (job->stopped && job->pgid > 0)
+        {
+            killpg(job->pgid, SIGHUP);
+            killpg(job->pgid, SIGCONT);
+        }
+    }
+}
+
+// Installs the SIGCHLD handler; SA_RESTART keeps a pending read going when a child finishes
+void jobs_init()
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigchld;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+
+    if (interactive)
+        atexit(hangup_stopped_jobs);
+}
+
+// Adds a job for the pipeline argv to the table; the caller fills in the pids as stages start
+// SIGCHLD should be blocked until then so no stage can be reaped before it is known
+Job *job_create(char ***argv, int argv_count)
+{
+    Job *job = free_jobs;
+    if (job != NULL)
+        free_jobs = job->next;
+    else
+    {
+        job = malloc(sizeof(Job));
+        if (job == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (job_count == job_capacity)
+    {
+        int capacity = job_capacity == 0 ? 8 : job_capacity * 2;
+        Job **table = realloc(job_table, capacity * sizeof(Job *));
+        if (table == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        job_table = table;
+        job_capacity = capacity;
+    }
+
+    // Job numbers continue from the newest job, like other shells
+    job->id = job_count > 0 ? job_table[job_count - 1]->id + 1 : 1;
+    job->pgid = 0;
+    job->count = argv_count;
+    job->running = 0;
+    job->reaped = 0;
+    job->stopped = 0;
+    job->background = 0;
+    job->next = NULL;
+
+    // The command text shown by jobs, stages joined back together
+    size_t len = 0;
+    job->command[0] = '\0';
+    for (int i = 0; i < argv_count; i++)
+    {
+        job->pids[i] = -1;
+        job->statuses[i] = 0;
+        job->launched[i] = 0;
+        memset(&job->usage[i], 0, sizeof(job->usage[i]));
+        for (int w = 0; argv[i][w] != NULL && len < sizeof(job->command); w++)
+        {
+            const char *sep = w > 0 ? " " : i > 0 ? " | " : "";
+            len += snprintf(job->command + len, sizeof(job->command) - len, "%s%s", sep, argv[i][w]);
+        }
+    }
+
+    job_table[job_count++] = job;
+    return job;
+}
+
+// Drops a job from the table and keeps its memory for the next one
+void job_remove(Job *job)
+{
+    for (int j = 0; j < job_count; j++)
+    {
+        if (job_table[j] == job)
+        {
+            memmove(job_table + j, job_table + j + 1, (job_count - j - 1) * sizeof(Job *));
+            job_count--;
+            job->next = free_jobs;
+            free_jobs = job;
+            return;
+        }
+    }
+}
+
+// Forgets every job without signalling it, in a forked shell whose children they are not
+void jobs_forget()
+{
+    while (job_count > 0)
+        job_remove(job_table[job_count - 1]);
+}
+
+// Sleeps until job finishes or stops, or with job NULL until any running background job does; with
+// interruptible set, Control-C ends the wait too, which a background job in its own group never sees
+// Returns the job that changed, or NULL when there was nothing to wait for or the wait was interrupted
+static Job *wait_for_change(Job *job, int interruptible)
+{
+    sigset_t old;
+    sigset_t wait_mask;
+    Job *found = NULL;
+
+    block_child_signal(&old);
+    wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    while (1)
+    {
+        collect_child_events();
+        if (interruptible && interrupted)
+            break;
+
+        if (job != NULL)
+        {
+            if (job->running == 0 || job->stopped)
+            {
+                found = job;
+                break;
+            }
+        }
+        else
+        {
+            int pending = 0;
+            for (int j = 0; j < job_count && found == NULL; j++)
+            {
+                if (!job_table[j]->background)
+                    continue;
+                if (job_table[j]->running == 0)
+                    found = job_table[j];
+                else if (!job_table[j]->stopped)
+                    pending = 1;
+            }
+            if (found != NULL || !pending)
+                break;
+        }
+
+        // Atomically let SIGCHLD in and sleep, so a child finishing now cannot be missed
+        sigsuspend(&wait_mask);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return found;
+}
+
+// Sleeps until one of the count jobs has no stage left running, and returns it, or NULL once Control-C
+// interrupts the wait
+Job *job_wait_any(Job *const *jobs, int count)
+{
+    sigset_t old;
+    sigset_t wait_mask;
+    Job *found = NULL;
+
+    block_child_signal(&old);
+    wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    while (1)
+    {
+        collect_child_events();
+        if (interrupted)
+            break;
+        for (int i = 0; i < count && found == NULL; i++)
+        {
+            if (jobs[i]->running == 0)
+                found = jobs[i];
+        }
+        if (found != NULL)
+            break;
+        sigsuspend(&wait_mask);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return found;
+}
+
+// Sleeps until *running is cleared by the exit of the child it stands for, one that has no job, or until
+// Control-C interrupts the wait
+void wait_until_reaped(const int *running)
+{
+    sigset_t old;
+    sigset_t wait_mask;
+
+    block_child_signal(&old);
+    wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    collect_child_events();
+    while (*running && !interrupted)
+    {
+        sigsuspend(&wait_mask);
+        collect_child_events();
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+// Continues every stage of a stopped job
+static void job_continue(Job *job)
+{
+    job->stopped = 0;
+    if (job->pgid > 0)
+    {
+        killpg(job->pgid, SIGCONT);
+        return;
+    }
+    for (int i = 0; i < job->count; i++)
+    {
+        if (job->pids[i] != -1 && !(job->reaped & (1u << i)))
+            kill(job->pids[i], SIGCONT);
+    }
+}
+
+// Sets the status of a job whose stages have all finished and drops it, first keeping a copy when time
+// wants to report on its stages
+void job_finish(Job *job)
+{
+    if (keep_finished_job)
+        finished_job = *job;
+    set_pipeline_status(job->statuses, job->count);
+    job_remove(job);
+}
+
+// Runs a job in the foreground until it finishes or is stopped, continuing it first if asked
+// A finished job sets the exit status and leaves the table, a stopped one stays as a background job
+void job_foreground(Job *job, int cont)
+{
+    job->background = 0;
+    pipe_pid = job->pgid > 0 ? job->pgid : -1;
+    if (interactive && job->pgid > 0)
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    if (cont)
+        job_continue(job);
+
+    long long wait_start = trace_start();
+    wait_for_change(job, 0);
+    trace_span("wait", wait_start, job->command, 0);
+
+    if (interactive)
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    pipe_pid = -1;
+
+    if (job->stopped)
+    {
+        job->background = 1;
+        printf("\n[%d]+  Stopped                 %s\n", job->id, job->command);
+        last_exit_status = 128 + SIGTSTP;
+        return;
+    }
+
+    job_finish(job);
+}
+
+// Leaves a freshly launched job running in the background, announcing it on a terminal
+void job_background(Job *job)
+{
+    char value[32];
+
+    job->background = 1;
+    for (int i = job->count - 1; i >= 0; i--)
+    {
+        if (job->pids[i] != -1)
+        {
+            snprintf(value, sizeof(value), "%d", job->pids[i]);
+            set_variable_value("$!", value);
+            break;
+        }
+    }
+    if (interactive)
+        printf("[%d] %s\n", job->id, value);
+}
+
+// Returns the process that stands for a job: its group leader, or its first process, builtins run
+// by the shell having none
+static pid_t job_leader(const Job *job)
+{
+    if (job->pgid > 0)
+        return job->pgid;
+    for (int i = 0; i < job->count; i++)
+    {
+        if (job->pids[i] != -1)
+            return job->pids[i];
+    }
+    return -1;
+}
+
+// Describes a job's state the way jobs and the completion notices show it
+static void job_state(const Job *job, char *out, size_t size)
+{
+    if (job->stopped)
+        snprintf(out, size, "Stopped");
+    else if (job->running > 0)
+        snprintf(out, size, "Running");
+    else
+    {
+        int status = pipeline_status(job->statuses, job->count);
+        if (WIFSIGNALED(status))
+            snprintf(out, size, "%s", strsignal(WTERMSIG(status)));
+        else if (WEXITSTATUS(status) != 0)
+            snprintf(out, size, "Exit %d", WEXITSTATUS(status));
+        else
+            snprintf(out, size, "Done");
+    }
+}
+
+// Prints one line of jobs output; long adds the process IDs
+static void job_print(const Job *job, int long_format)
+{
+    char state[64];
+    char mark = job == job_table[job_count - 1] ? '+' : job_count > 1 && job == job_table[job_count - 2] ? '-' : ' ';
+
+    job_state(job, state, sizeof(state));
+    printf("[%d]%c  ", job->id, mark);
+    if (long_format)
+        printf("%d ", job_leader(job));
+    printf("%-22s  %s%s\n", state, job->command, job->running > 0 && !job->stopped ? " &" : "");
+}
+
+// Reports and forgets background jobs that finished since the last prompt; silent without a terminal
+void job_notify()
+{
+    sigset_t old;
+
+    // Runs before every line, so stay off the system calls when nothing can have changed; a coprocess that
+    // finished is collected here too, with no job to report
+    if (events_head != events_tail || events_overflow)
+    {
+        block_child_signal(&old);
+        collect_child_events();
+        sigprocmask(SIG_SETMASK, &old, NULL);
+    }
+
+    for (int j = 0; j < job_count;)
+    {
+        Job *job = job_table[j];
+        if (!job->background || job->running > 0)
+        {
+            j++;
+            continue;
+        }
+        if (interactive)
+            job_print(job, 0);
+        job_remove(job);
+    }
+    fflush(stdout);
+}
+
+// Finds the job a %n, %+, %% or %- spec names; with allow_pid a plain number is a process ID instead
+static Job *job_find(const char *spec, int allow_pid)
+{
+    if (job_count == 0)
+        return NULL;
+
+    if (strcmp(spec, "%+") == 0 || strcmp(spec, "%%") == 0)
+        return job_table[job_count - 1];
+    if (strcmp(spec, "%-") == 0)
+        return job_count > 1 ? job_table[job_count - 2] : NULL;
+
+    char *end;
+    long number = strtol(spec[0] == '%' ? spec + 1 : spec, &end, 10);
+    if (*end != '\0' || end == spec)
+        return NULL;
+
+    for (int j = 0; j < job_count; j++)
+    {
+        Job *job = job_table[j];
+        if (spec[0] == '%' || !allow_pid)
+        {
+            if (job->id == number)
+                return job;
+            continue;
+        }
+        for (int i = 0; i < job->count; i++)
+        {
+            if (job->pids[i] == number)
+                return job;
+        }
+    }
+    return NULL;
+}
+
+// Implements jobs [-l|-p]: lists every job, forgetting the finished ones once shown
+void jobs_builtin(char **argv)
+{
+    int long_format = argv[1] != NULL && strcmp(argv[1], "-l") == 0;
+    int pids_only = argv[1] != NULL && strcmp(argv[1], "-p") == 0;
+    sigset_t old;
+
+    block_child_signal(&old);
+    collect_child_events();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    for (int j = 0; j < job_count;)
+    {
+        Job *job = job_table[j];
+        if (pids_only)
+            printf("%d\n", job_leader(job));
+        else
+            job_print(job, long_format);
+
+        if (job->running == 0)
+            job_remove(job);
+        else
+            j++;
+    }
+    last_exit_status = 0;
+}
+
+// Implements fg [job]: brings a job (the newest by default) to the foreground and waits for it
+void fg_builtin(char **argv)
+{
+    Job *job = argv[1] != NULL ? job_find(argv[1], 0) : job_count > 0 ? job_table[job_count - 1] : NULL;
+    if (job == NULL)
+    {
+        fprintf(stderr, "fg: %s: no such job\n", argv[1] != NULL ? argv[1] : "current");
+        last_exit_status = 1;
+        return;
+    }
+
+    printf("%s\n", job->command);
+    fflush(stdout);
+    disable_raw_mode();
+    job_foreground(job, 1);
+}
+
+// Implements bg [job]: lets a stopped job (the newest by default) continue in the background
+void bg_builtin(char **argv)
+{
+    Job *job = argv[1] != NULL ? job_find(argv[1], 0) : job_count > 0 ? job_table[job_count - 1] : NULL;
+    if (job == NULL)
+    {
+        fprintf(stderr, "bg: %s: no such job\n", argv[1] != NULL ? argv[1] : "current");
+        last_exit_status = 1;
+        return;
+    }
+
+    last_exit_status = 0;
+    if (!job->stopped)
+    {
+        fprintf(stderr, "bg: job %d already in background\n", job->id);
+        return;
+    }
+    job->background = 1;
+    job_continue(job);
+    printf("[%d]+ %s &\n", job->id, job->command);
+}
+
+// Implements wait: no arguments waits for every background job, -n for the next one to finish,
+// and job specs or process IDs for those jobs; the status is that of the last job waited for, or
+// 128 + SIGINT when Control-C stops the wait, leaving the jobs running
+void wait_builtin(char **argv)
+{
+    last_exit_status = 0;
+
+    if (argv[1] == NULL)
+    {
+        Job *job;
+        while ((job = wait_for_change(NULL, 1)) != NULL)
+            job_remove(job);
+        if (interrupted)
+            last_exit_status = 128 + SIGINT;
+        return;
+    }
+
+    if (strcmp(argv[1], "-n") == 0)
+    {
+        Job *job = wait_for_change(NULL, 1);
+        if (job == NULL)
+        {
+            last_exit_status = interrupted ? 128 + SIGINT : 127;
+            return;
+        }
+        last_exit_status = status_to_exit_code(pipeline_status(job->statuses, job->count));
+        job_remove(job);
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        Job *job = job_find(argv[i], 1);
+        if (job == NULL)
+        {
+            fprintf(stderr, "wait: %s: no such job\n", argv[i]);
+            last_exit_status = 127;
+            continue;
+        }
+
+        if (wait_for_change(job, 1) == NULL)
+        {
+            last_exit_status = 128 + SIGINT;
+            return;
+        }
+        if (job->stopped)
+        {
+            last_exit_status = 128 + SIGTSTP;
+            continue;
+        }
+        last_exit_status = status_to_exit_code(pipeline_status(job->statuses, job->count));
+        job_remove(job);
+    }
+}
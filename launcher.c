@@ -0,0 +1,179 @@
+#include "myshell.h"
+
+#include <spawn.h>
+
+extern char **environ;
+
+// Signals the shell ignores or handles, set back to default in every child
+const int child_default_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGPIPE, 0};
+
+// Prepares an empty launch plan; pgid is -1 to stay in the shell's group, 0 to lead a new group
+void launch_plan_init(LaunchPlan *plan, pid_t pgid)
+{
+    plan->actions = plan->inline_actions;
+    plan->action_count = 0;
+    plan->action_capacity = MAX_FD_ACTIONS;
+    plan->pgid = pgid;
+}
+
+// Adds a file action to the plan, moving its actions to a larger array in the line arena when it is full
+static FdAction *launch_plan_add(LaunchPlan *plan, int type, int fd)
+{
+    if (plan->action_count == plan->action_capacity)
+    {
+        int capacity = plan->action_capacity * 2;
+        FdAction *grown = arena_alloc(&line_arena, capacity * sizeof(FdAction));
+        memcpy(grown, plan->actions, plan->action_count * sizeof(FdAction));
+        plan->actions = grown;
+        plan->action_capacity = capacity;
+    }
+
+    FdAction *action = &plan->actions[plan->action_count++];
+    action->type = type;
+    action->fd = fd;
+    action->src_fd = -1;
+    action->path = NULL;
+    action->flags = 0;
+    return action;
+}
+
+// Makes descriptor fd in the child a copy of src_fd
+void launch_plan_dup(LaunchPlan *plan, int src_fd, int fd)
+{
+    launch_plan_add(plan, FD_ACTION_DUP, fd)->src_fd = src_fd;
+}
+
+// Opens path onto descriptor fd in the child
+void launch_plan_open(LaunchPlan *plan, int fd, const char *path, int flags)
+{
+    FdAction *action = launch_plan_add(plan, FD_ACTION_OPEN, fd);
+    action->path = path;
+    action->flags = flags;
+}
+
+// Closes descriptor fd in the child
+void launch_plan_close(LaunchPlan *plan, int fd)
+{
+    launch_plan_add(plan, FD_ACTION_CLOSE, fd);
+}
+
+// Starts argv according to the plan with posix_spawn (a vfork-style clone in glibc, no page-table copy)
+// Returns the child pid, or -1 with errno set when the command could not be started
+pid_t launch_command(char **argv, const LaunchPlan *plan)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t defaults;
+    sigset_t mask;
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    pid_t child = -1;
+    int err;
+
+    // Anything the shell printed must reach the descriptor before the child writes to it
+    fflush(stdout);
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    for (int i = 0; i < plan->action_count; i++)
+    {
+        const FdAction *action = &plan->actions[i];
+        switch (action->type)
+        {
+        case FD_ACTION_DUP:
+            posix_spawn_file_actions_adddup2(&actions, action->src_fd, action->fd);
+            break;
+        case FD_ACTION_OPEN:
+            posix_spawn_file_actions_addopen(&actions, action->fd, action->path, action->flags, 0660);
+            break;
+        case FD_ACTION_CLOSE:
+            posix_spawn_file_actions_addclose(&actions, action->fd);
+            break;
+        }
+    }
+
+    // Signals the shell ignores or handles must be back to default in the child
+    sigemptyset(&defaults);
+    for (int i = 0; child_default_signals[i] != 0; i++)
+        sigaddset(&defaults, child_default_signals[i]);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    if (plan->pgid >= 0)
+    {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, plan->pgid);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    // Resolve through the command hash instead of letting posix_spawnp try every PATH directory
+    const char *path = hash_lookup(argv[0]);
+    if (path == NULL)
+    {
+        err = ENOENT;
+    }
+    else
+    {
+        err = posix_spawn(&child, path, &actions, &attr, argv, environ);
+        if (err == ENOENT && path != argv[0])
+        {
+            // The hashed file disappeared since it was checked, search again once
+            hash_forget(argv[0]);
+            path = hash_lookup(argv[0]);
+            err = path != NULL ? posix_spawn(&child, path, &actions, &attr, argv, environ) : ENOENT;
+        }
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0)
+    {
+        errno = err;
+        return -1;
+    }
+    return child;
+}
+
+// Maps a failed launch onto the wait status the shell reports (127 not found, 126 not executable)
+int launch_failure_status(int err)
+{
+    return (err == ENOENT ? 127 : 126) << 8;
+}
+
+// Runs a single command in the shell's process group and waits for it, returning the raw wait status
+int launch_and_wait(char **argv)
+{
+    LaunchPlan plan;
+    int status;
+    sigset_t block;
+    sigset_t old;
+
+    // Keep the shell's SIGCHLD handler from reaping the child before we wait for it
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &old);
+
+    launch_plan_init(&plan, -1);
+    pid_t child = launch_command(argv, &plan);
+    if (child == -1)
+    {
+        fprintf(stderr, "Command execution failed: %s\n", strerror(errno));
+        status = launch_failure_status(errno);
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        return status;
+    }
+
+    while (waitpid(child, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            status = launch_failure_status(errno);
+            break;
+        }
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return status;
+}
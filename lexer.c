@@ -0,0 +1,680 @@
+#include "myshell.h"
+
+// Character classes for the scanner: blanks separate tokens, breaks end an unquoted run of word characters,
+// wildcards make a word a pattern
+#define CHAR_BLANK 1
+#define CHAR_BREAK 2
+#define CHAR_WILD 4
+
+static const unsigned char char_class[256] = {
+    ['\0'] = CHAR_BREAK, [' '] = CHAR_BLANK | CHAR_BREAK, ['\t'] = CHAR_BLANK | CHAR_BREAK, ['\n'] = CHAR_BREAK,
+    ['|'] = CHAR_BREAK,  ['&'] = CHAR_BREAK,             [';'] = CHAR_BREAK,               ['>'] = CHAR_BREAK,
+    ['\''] = CHAR_BREAK, ['"'] = CHAR_BREAK,             ['\\'] = CHAR_BREAK,              ['$'] = CHAR_BREAK,
+    ['`'] = CHAR_BREAK,  ['<'] = CHAR_BREAK,             ['*'] = CHAR_WILD,                ['?'] = CHAR_WILD,
+    ['['] = CHAR_WILD,
+};
+
+// Text of every operator token, indexed by token type
+static char *operator_text[] = {
+    [TOK_PIPE] = "|",          [TOK_AMP] = "&",         [TOK_SEMI] = ";",           [TOK_REDIRECT_OUT] = ">",
+    [TOK_APPEND] = ">>",       [TOK_REDIRECT_IN] = "<", [TOK_DUP_OUT] = ">&",       [TOK_DUP_IN] = "<&",
+    [TOK_REDIRECT_ALL] = "&>", [TOK_HEREDOC] = "<<",    [TOK_HEREDOC_TABS] = "<<-", [TOK_HERESTRING] = "<<<",
+};
+
+// Keywords after which the next word is a command again, so it can be an alias and completes as a command
+const char *const command_keywords[] = {"if", "then", "elif", "else", "while", "until", "do", "time", "{", NULL};
+
+#define MAX_HEREDOCS 16
+
+// Delimiter of the here-document the last lexed text ended in, and whether its lines drop leading tabs
+static char open_delimiter[MAX_COMMAND_LENGTH];
+static int open_strip_tabs = 0;
+
+// Appends a token span to the output array
+static void emit(Token *tokens, int *count, int type, const char *line, const char *start, int length, int quoted,
+                 int expand)
+{
+    Token *token = &tokens[(*count)++];
+    token->type = type;
+    token->offset = (int)(start - line);
+    token->length = length;
+    token->quoted = quoted;
+    token->expand = expand;
+}
+
+// Finds the "))" closing a $(( that started just before p, returns NULL when there is none
+const char *arith_end(const char *p)
+{
+    int depth = 0;
+    for (; *p != '\0'; p++)
+    {
+        if (*p == '(')
+            depth++;
+        else if (*p == ')' && depth > 0)
+            depth--;
+        else if (*p == ')' && p[1] == ')')
+            return p;
+    }
+    return NULL;
+}
+
+static const char *skip_double_quotes(const char *p, int *expand);
+
+// Finds the '`' closing a backquoted command that started just before p, returns NULL when there is none
+const char *backquote_end(const char *p)
+{
+    for (; *p != '\0'; p++)
+    {
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+        else if (*p == '`')
+            return p;
+    }
+    return NULL;
+}
+
+// Skips the '$' reference or backquoted command at p: $(( )), $( ) and ` ` whole, anything else just its '$'
+// Returns the character after it, or NULL when it is not closed
+static const char *skip_substitution(const char *p)
+{
+    if (*p == '`')
+        p = backquote_end(p + 1);
+    else if (p[1] == '(' && p[2] == '(')
+        return (p = arith_end(p + 3)) != NULL ? p + 2 : NULL;
+    else if (p[1] == '(')
+        p = command_end(p + 2);
+    return p != NULL ? p + 1 : NULL;
+}
+
+// Finds the ')' closing a $( that started just before p, skipping quotes, nested parentheses and
+// substitutions; returns NULL when there is none
+const char *command_end(const char *p)
+{
+    int depth = 0;
+    int expand;
+
+    for (; *p != '\0'; p++)
+    {
+        switch (*p)
+        {
+        case '\\':
+            if (p[1] != '\0')
+                p++;
+            break;
+        case '\'':
+            p = strchr(p + 1, '\'');
+            break;
+        case '"':
+            p = skip_double_quotes(p + 1, &expand);
+            break;
+        case '$':
+        case '`':
+            p = skip_substitution(p);
+            if (p != NULL)
+                p--;
+            break;
+        case '(':
+            depth++;
+            break;
+        case ')':
+            if (depth == 0)
+                return p;
+            depth--;
+            break;
+        }
+        if (p == NULL)
+            return NULL;
+    }
+    return NULL;
+}
+
+// Skips a double-quoted string whose opening quote is just before p, returning its closing quote or NULL
+// Only a backslash escapes inside; a '$' or '`' sets expand and substitutions are skipped whole
+static const char *skip_double_quotes(const char *p, int *expand)
+{
+    while (1)
+    {
+        p += strcspn(p, "\"\\$`");
+        if (*p == '\\' && p[1] != '\0')
+            p += 2;
+        else if (*p == '$' || *p == '`')
+        {
+            *expand = 1;
+            if ((p = skip_substitution(p)) == NULL)
+                return NULL;
+        }
+        else
+            return *p == '"' ? p : NULL;
+    }
+}
+
+// Scans one word starting at p, returning the first character after it or NULL on an unterminated quote
+// expand is set when the word holds a '$' or '`' outside single quotes, to be expanded each time it runs,
+// and wild when it holds an unquoted '*' or '?', or a '[' closed later in the word, to be globbed
+static const char *scan_word(const char *p, int *quoted, int *expand, int *wild)
+{
+    while (1)
+    {
+        // Skip the plain run with one table lookup per character
+        while (!(char_class[(unsigned char)*p] & (CHAR_BREAK | CHAR_WILD)))
+            p++;
+
+        if (char_class[(unsigned char)*p] & CHAR_WILD)
+        {
+            // A lone '[', like the test command, is no pattern
+            if (*p != '[' || p[1 + strcspn(p + 1, "] \t\n|&;<>")] == ']')
+                *wild = 1;
+            p++;
+        }
+        else if (*p == '\'')
+        {
+            // Single quotes: nothing is special until the closing quote
+            const char *close = strchr(p + 1, '\'');
+            if (close == NULL)
+                return NULL;
+            p = close + 1;
+            *quoted = 1;
+        }
+        else if (*p == '"')
+        {
+            p = skip_double_quotes(p + 1, expand);
+            if (p == NULL)
+                return NULL;
+            p++;
+            *quoted = 1;
+        }
+        else if (*p == '$' || *p == '`')
+        {
+            // Substitutions stay one word, blanks included
+            p = skip_substitution(p);
+            if (p == NULL)
+                return NULL;
+            *expand = 1;
+        }
+        else if (*p == '\\' && p[1] != '\0')
+        {
+            p += 2;
+            *quoted = 1;
+        }
+        else if (*p == '\\')
+        {
+            p++;
+        }
+        else
+        {
+            return p;
+        }
+    }
+}
+
+// Returns the length of the redirection operator starting at p, with its token type in type, or 0 when
+// there is none there
+static int redirect_operator(const char *p, int *type)
+{
+    if (*p == '>')
+    {
+        *type = p[1] == '>' ? TOK_APPEND : p[1] == '&' ? TOK_DUP_OUT : TOK_REDIRECT_OUT;
+        return *type == TOK_REDIRECT_OUT ? 1 : 2;
+    }
+    if (*p != '<')
+        return 0;
+    if (p[1] == '<')
+    {
+        *type = p[2] == '<' ? TOK_HERESTRING : p[2] == '-' ? TOK_HEREDOC_TABS : TOK_HEREDOC;
+        return *type == TOK_HEREDOC ? 2 : 3;
+    }
+    *type = p[1] == '&' ? TOK_DUP_IN : TOK_REDIRECT_IN;
+    return *type == TOK_DUP_IN ? 2 : 1;
+}
+
+// Reads the bodies of the here-documents started on the line that ended just before p, in order, and turns
+// each delimiter word into a TOK_HEREDOC_BODY token spanning its body; a delimiter that is missing is left for
+// the parser to report. Returns the character after the last delimiter line, or NULL when the text ends
+// before it, with the delimiter awaited kept for heredoc_closes()
+static const char *read_heredocs(const char *line, const char *p, Token *tokens, int count, const int *heredocs,
+                                 int heredoc_count)
+{
+    for (int i = 0; i < heredoc_count; i++)
+    {
+        Token *token = &tokens[heredocs[i]];
+        if (heredocs[i] >= count || token->type != TOK_WORD || token->length >= MAX_COMMAND_LENGTH)
+            continue;
+
+        // The delimiter is matched without its quotes
+        Token unquoted = *token;
+        unquoted.offset = 0;
+        memcpy(open_delimiter, line + token->offset, token->length);
+        token_text(open_delimiter, &unquoted);
+        open_strip_tabs = tokens[heredocs[i] - 1].type == TOK_HEREDOC_TABS;
+        size_t delimiter_len = strlen(open_delimiter);
+
+        const char *body = p;
+        while (1)
+        {
+            if (*p == '\0')
+                return NULL;
+
+            const char *eol = strchrnul(p, '\n');
+            const char *s = p;
+            while (open_strip_tabs && *s == '\t')
+                s++;
+            if ((size_t)(eol - s) == delimiter_len && strncmp(s, open_delimiter, delimiter_len) == 0)
+            {
+                token->type = TOK_HEREDOC_BODY;
+                token->offset = (int)(body - line);
+                token->length = (int)(p - body);
+                p = *eol != '\0' ? eol + 1 : eol;
+                break;
+            }
+            p = *eol != '\0' ? eol + 1 : eol;
+        }
+    }
+    return p;
+}
+
+// Returns 1 when line is the delimiter of the here-document that left the last lexed text incomplete
+int heredoc_closes(const char *line)
+{
+    while (open_strip_tabs && *line == '\t')
+        line++;
+    return strcmp(line, open_delimiter) == 0;
+}
+
+// Splits line into word and operator tokens in a single pass; the lines after one with "<<" operators are
+// taken as the bodies of its here-documents. Tokens are spans into line and are allocated from the line
+// arena; returns the count, -1 on a syntax error or LEX_INCOMPLETE when a here-document is still open
+int lex_line(const char *line, Token **tokens_out)
+{
+    size_t len = strlen(line);
+    Token *tokens = arena_alloc(&line_arena, (len + 1) * sizeof(Token));
+    const char *p = line;
+    int count = 0;
+    int in_test = 0;
+    int heredocs[MAX_HEREDOCS];
+    int heredoc_count = 0;
+
+    while (1)
+    {
+        while (char_class[(unsigned char)*p] & CHAR_BLANK)
+            p++;
+        if (*p == '\0')
+        {
+            // The text ended on the line that starts a here-document
+            if (heredoc_count > 0 && read_heredocs(line, p, tokens, count, heredocs, heredoc_count) == NULL)
+                return LEX_INCOMPLETE;
+            break;
+        }
+
+        // Between [[ and ]] the operators && || < > are words for the test builtin
+        if (in_test && (*p == '<' || *p == '>' || ((*p == '&' || *p == '|') && p[1] == *p)))
+        {
+            int length = *p == '<' || *p == '>' ? 1 : 2;
+            emit(tokens, &count, TOK_WORD, line, p, length, 0, 0);
+            p += length;
+            continue;
+        }
+
+        // A '#' at the start of a word comments out the rest of the line
+        if (*p == '#')
+        {
+            p = strchr(p, '\n');
+            if (p == NULL)
+                break;
+            continue;
+        }
+
+        switch (*p)
+        {
+        case '|':
+            emit(tokens, &count, TOK_PIPE, line, p, 1, 0, 0);
+            p++;
+            continue;
+        case '&':
+            if (p[1] == '>')
+            {
+                emit(tokens, &count, TOK_REDIRECT_ALL, line, p, 2, 0, 0);
+                p += 2;
+                continue;
+            }
+            emit(tokens, &count, TOK_AMP, line, p, 1, 0, 0);
+            p++;
+            continue;
+        case ';':
+            emit(tokens, &count, TOK_SEMI, line, p, 1, 0, 0);
+            p++;
+            continue;
+        case '\n':
+            emit(tokens, &count, TOK_SEMI, line, p, 1, 0, 0);
+            p++;
+            if (heredoc_count > 0)
+            {
+                p = read_heredocs(line, p, tokens, count, heredocs, heredoc_count);
+                if (p == NULL)
+                    return LEX_INCOMPLETE;
+                heredoc_count = 0;
+            }
+            continue;
+        }
+
+        // A redirection operator, possibly after the number of the descriptor it redirects
+        const char *op = p;
+        while (isdigit((unsigned char)*op))
+            op++;
+        int type;
+        int length = redirect_operator(op, &type);
+        if (length > 0)
+        {
+            if (type == TOK_HEREDOC || type == TOK_HEREDOC_TABS)
+            {
+                // The delimiter is the next token, its body starts after the end of the line
+                if (heredoc_count == MAX_HEREDOCS)
+                {
+                    fprintf(stderr, "Syntax error: too many here-documents\n");
+                    return -1;
+                }
+                heredocs[heredoc_count++] = count + 1;
+            }
+            emit(tokens, &count, type, line, p, (int)(op - p) + length, 0, 0);
+            p = op + length;
+            continue;
+        }
+
+        int quoted = 0;
+        int expand = 0;
+        int wild = 0;
+        const char *end = scan_word(p, &quoted, &expand, &wild);
+        if (end == NULL)
+        {
+            fprintf(stderr, "Syntax error: unterminated quote\n");
+            return -1;
+        }
+        // Nothing between [[ and ]] is globbed, a pattern there is matched against a string; its quoted words
+        // keep their quotes until they run, so a quoted part of a pattern can be matched literally
+        emit(tokens, &count, TOK_WORD, line, p, (int)(end - p), quoted,
+             expand || (in_test ? quoted : wild));
+        if (!quoted && end - p == 2 && (strncmp(p, "[[", 2) == 0 || strncmp(p, "]]", 2) == 0))
+            in_test = *p == '[';
+        p = end;
+    }
+
+    *tokens_out = tokens;
+    return count;
+}
+
+// Returns the text of a token as a NUL-terminated string inside buf, a writable copy of the lexed line
+// Quotes and escapes are removed in place, since the unquoted text is never longer than the span
+char *token_text(char *buf, const Token *token)
+{
+    if (token->type != TOK_WORD)
+        return operator_text[token->type];
+
+    char *start = buf + token->offset;
+    if (!token->quoted)
+    {
+        start[token->length] = '\0';
+        return start;
+    }
+
+    const char *src = start;
+    const char *end = start + token->length;
+    char *dst = start;
+    while (src < end)
+    {
+        if (*src == '\'')
+        {
+            const char *close = memchr(src + 1, '\'', end - src - 1);
+            memmove(dst, src + 1, close - src - 1);
+            dst += close - src - 1;
+            src = close + 1;
+        }
+        else if (*src == '"')
+        {
+            src++;
+            while (*src != '"')
+            {
+                // Inside double quotes a backslash only escapes characters that would otherwise be special
+                if (*src == '\\' && strchr("\"\\$`", src[1]) != NULL)
+                    src++;
+                *dst++ = *src++;
+            }
+            src++;
+        }
+        else if (*src == '\\' && src + 1 < end)
+        {
+            *dst++ = src[1];
+            src += 2;
+        }
+        else
+        {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+    return start;
+}
+
+// Returns the argv word for a token: its unquoted text, or for a word that is expanded each time it runs
+// a copy of the raw text behind an EXPAND_MARK byte, left for expand_word()
+char *token_word(char *buf, const Token *token)
+{
+    if (!token->expand)
+        return token_text(buf, token);
+
+    char *word = arena_alloc(&line_arena, token->length + 2);
+    word[0] = EXPAND_MARK;
+    memcpy(word + 1, buf + token->offset, token->length);
+    word[token->length + 1] = '\0';
+    return word;
+}
+
+// Returns 1 when token is the unquoted word given
+int token_is(const char *line, const Token *token, const char *word)
+{
+    return token->type == TOK_WORD && !token->quoted && token->length == (int)strlen(word) &&
+           strncmp(line + token->offset, word, token->length) == 0;
+}
+
+// Copies a here-document body once, <<- dropping the tabs that start its lines; unless the delimiter was
+// quoted, a body with anything to expand is marked to be expanded each time it runs
+static char *compile_body(const char *buf, const Token *op, const Token *word)
+{
+    const char *src = buf + word->offset;
+    const char *end = src + word->length;
+    char *body = arena_alloc(&line_arena, word->length + 2);
+    char *dst = body + 1;
+    int line_start = 1;
+    int expand = 0;
+
+    while (src < end)
+    {
+        if (line_start && *src == '\t' && op->type == TOK_HEREDOC_TABS)
+        {
+            src++;
+            continue;
+        }
+        line_start = *src == '\n';
+        expand |= *src == '$' || *src == '`' || *src == '\\';
+        *dst++ = *src++;
+    }
+    *dst = '\0';
+
+    if (!expand || word->quoted)
+        return body + 1;
+    body[0] = EXPAND_MARK;
+    return body;
+}
+
+// Reads the source of a >& or <& duplication: a descriptor number, or '-' to close; returns -2 for
+// anything else
+int redirect_source(const char *word)
+{
+    if (strcmp(word, "-") == 0)
+        return -1;
+    char *end;
+    long fd = strtol(word, &end, 10);
+    if (end == word || *end != '\0' || fd < 0 || fd > INT_MAX)
+        return -2;
+    return (int)fd;
+}
+
+// Allocates a redirection of descriptor fd
+static Redirect *new_redirect(int type, int fd, char *word)
+{
+    Redirect *redirect = arena_alloc(&line_arena, sizeof(Redirect));
+    redirect->type = type;
+    redirect->fd = fd;
+    redirect->flags = 0;
+    redirect->src_fd = -1;
+    redirect->word = word;
+    redirect->next = NULL;
+    return redirect;
+}
+
+// Compiles a redirection operator and the word after it into the stage's list at *tail, returning the new
+// tail or NULL after reporting a syntax error. The descriptor number in front of an operator is read from
+// buf, which still holds it: unquoting a word only ever writes over the character just after that word
+static Redirect **compile_redirect(char *buf, const Token *op, const Token *word, Redirect **tail)
+{
+    const char *text = buf + op->offset;
+    int input = op->type == TOK_REDIRECT_IN || op->type == TOK_DUP_IN || op->type >= TOK_HEREDOC;
+    int fd = isdigit((unsigned char)*text) ? atoi(text) : input ? STDIN_FILENO : STDOUT_FILENO;
+    Redirect *redirect;
+
+    switch (op->type)
+    {
+    case TOK_HEREDOC:
+    case TOK_HEREDOC_TABS:
+        redirect = new_redirect(REDIR_HEREDOC, fd, compile_body(buf, op, word));
+        break;
+    case TOK_HERESTRING:
+        redirect = new_redirect(REDIR_HERESTRING, fd, token_word(buf, word));
+        break;
+    case TOK_DUP_OUT:
+    case TOK_DUP_IN:
+        redirect = new_redirect(REDIR_DUP, fd, token_word(buf, word));
+        if (redirect->word[0] != EXPAND_MARK)
+        {
+            // A literal source is checked once, here; one from an expansion each time it runs
+            redirect->src_fd = redirect_source(redirect->word);
+            if (redirect->src_fd == -2)
+            {
+                fprintf(stderr, "Syntax error: '%s' is not a file descriptor\n", redirect->word);
+                return NULL;
+            }
+        }
+        break;
+    default:
+        redirect = new_redirect(REDIR_FILE, fd, token_word(buf, word));
+        redirect->flags = op->type == TOK_REDIRECT_IN ? O_RDONLY
+                          : op->type == TOK_APPEND    ? O_WRONLY | O_CREAT | O_APPEND
+                                                      : O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+    }
+    *tail = redirect;
+    tail = &redirect->next;
+
+    if (op->type == TOK_REDIRECT_ALL)
+    {
+        // &> file is > file 2>&1
+        *tail = new_redirect(REDIR_DUP, STDERR_FILENO, "1");
+        (*tail)->src_fd = STDOUT_FILENO;
+        tail = &(*tail)->next;
+    }
+    return tail;
+}
+
+// Builds the argv rows of one pipeline from tokens, stopping after a ';' or '&', with every redirection
+// compiled into its stage's list of redirects; a closing '&' sets background instead
+// Returns the tokens consumed, or -1 after reporting a syntax error, such as a '|' with no command on one side,
+// or a pipeline longer than MAX_ARG_COUNT
+int parse_tokens(char *buf, const Token *tokens, int count, char ***argv, int *argc, Redirect **redirects,
+                 int *argv_count, int *background)
+{
+    int stage = 0;
+    int used = 0;
+
+    *background = 0;
+
+    argv[0] = arena_alloc(&line_arena, (count + 1) * sizeof(char *));
+    argc[0] = 0;
+    redirects[0] = NULL;
+    Redirect **tail = &redirects[0];
+
+    while (used < count)
+    {
+        const Token *token = &tokens[used++];
+
+        if (token->type == TOK_SEMI)
+            break;
+
+        if (token->type == TOK_PIPE)
+        {
+            if (argc[stage] == 0 && redirects[stage] == NULL)
+            {
+                fprintf(stderr, "Syntax error near '|'\n");
+                return -1;
+            }
+            if (stage + 1 >= MAX_ARG_COUNT)
+            {
+                fprintf(stderr, "Too many pipeline stages\n");
+                return -1;
+            }
+            argv[stage][argc[stage]] = NULL;
+            stage++;
+            argv[stage] = arena_alloc(&line_arena, (count - used + 1) * sizeof(char *));
+            argc[stage] = 0;
+            redirects[stage] = NULL;
+            tail = &redirects[stage];
+            continue;
+        }
+
+        if (token->type == TOK_AMP)
+        {
+            *background = 1;
+            break;
+        }
+
+        if (token->type >= TOK_REDIRECT_OUT && token->type <= TOK_HERESTRING)
+        {
+            int wanted = token->type == TOK_HEREDOC || token->type == TOK_HEREDOC_TABS ? TOK_HEREDOC_BODY : TOK_WORD;
+            if (used >= count || tokens[used].type != wanted)
+            {
+                fprintf(stderr, "Syntax error near '%s', expected a word\n", operator_text[token->type]);
+                return -1;
+            }
+            tail = compile_redirect(buf, token, &tokens[used++], tail);
+            if (tail == NULL)
+                return -1;
+            continue;
+        }
+
+        argv[stage][argc[stage]++] = token_word(buf, token);
+    }
+    argv[stage][argc[stage]] = NULL;
+    if (stage > 0 && argc[stage] == 0 && redirects[stage] == NULL)
+    {
+        fprintf(stderr, "Syntax error near '|'\n");
+        return -1;
+    }
+
+    // An empty command (a lone ';') has no stages at all; one with only redirections still opens its files
+    *argv_count = (stage == 0 && argc[0] == 0 && redirects[0] == NULL) ? 0 : stage + 1;
+    return used;
+}
+
+// Parses a command string into individual commands and arguments, updating argc and argv_count
+// Only the first pipeline of the line is parsed
+void parse_command(char *command, char ****argv, int *argc, int *argv_count)
+{
+    Token *tokens;
+    Redirect *redirects[MAX_ARG_COUNT];
+    int count = lex_line(command, &tokens);
+
+    *argv_count = 0;
+    if (count <= 0)
+        return;
+
+    int background;
+    char *buf = arena_strdup(&line_arena, command);
+    parse_tokens(buf, tokens, count, *argv, argc, redirects, argv_count, &background);
+}
@@ -0,0 +1,613 @@
+#include "myshell.h"
+
+#include <sys/ioctl.h>
+
+#define INPUT_BUFFER_SIZE 4096
+#define OUTPUT_BUFFER_SIZE 8192
+#define MAX_LISTED_MATCHES 200
+
+// Decoded keys beyond the single-byte range
+enum
+{
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+    KEY_PASTE_START,
+    KEY_PASTE_END,
+    KEY_NONE
+};
+
+// Terminal modes, captured once per session
+static struct termios orig_termios;
+static struct termios raw_termios;
+static int terminal_ready = 0;
+static int terminal_raw = 0;
+
+// Bytes read from the terminal but not yet processed; they survive between lines so a pasted block is not lost
+static unsigned char input_buf[INPUT_BUFFER_SIZE];
+static int input_start = 0;
+static int input_end = 0;
+
+// Screen updates collected during a batch of input and written with one write()
+static char output_buf[OUTPUT_BUFFER_SIZE];
+static int output_len = 0;
+
+// Whether we are between the start and end markers of a bracketed paste
+static int in_paste = 0;
+
+// Set while a builtin runs with standard input redirected away from the shell's own input
+int input_redirected = 0;
+
+// State of the line being edited
+typedef struct
+{
+    char *line;
+    int len;
+    int pos;
+    const char *prompt;
+    int searching;
+    char query[MAX_COMMAND_LENGTH];
+    int query_len;
+    int match;
+    int failing;
+    char saved[MAX_COMMAND_LENGTH];
+} LineState;
+
+// Global variable to hold the index browsed with the arrow keys
+int current_history_index = -1;
+
+// Writes out everything queued in the output buffer
+static void flush_output()
+{
+    int done = 0;
+    while (done < output_len)
+    {
+        ssize_t n = write(STDOUT_FILENO, output_buf + done, output_len - done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    output_len = 0;
+}
+
+// Queues bytes for the screen, flushing early only if the buffer fills up
+static void output(const char *s, int len)
+{
+    while (len > 0)
+    {
+        if (output_len == OUTPUT_BUFFER_SIZE)
+            flush_output();
+        int chunk = OUTPUT_BUFFER_SIZE - output_len < len ? OUTPUT_BUFFER_SIZE - output_len : len;
+        memcpy(output_buf + output_len, s, chunk);
+        output_len += chunk;
+        s += chunk;
+        len -= chunk;
+    }
+}
+
+// Queues a NUL-terminated string for the screen
+static void output_str(const char *s)
+{
+    output(s, strlen(s));
+}
+
+// Captures the terminal settings once and registers the restore handler once
+static void terminal_init()
+{
+    if (terminal_ready)
+        return;
+    terminal_ready = 1;
+
+    if (tcgetattr(STDIN_FILENO, &orig_termios) == -1)
+        return;
+    atexit(disable_raw_mode);
+
+    raw_termios = orig_termios;
+    raw_termios.c_lflag &= ~(ECHO | ICANON);
+    raw_termios.c_cc[VMIN] = 1;
+    raw_termios.c_cc[VTIME] = 0;
+}
+
+// Disables raw mode and restores original terminal settings; a no-op when the terminal is not raw
+void disable_raw_mode()
+{
+    if (!terminal_raw)
+        return;
+    terminal_raw = 0;
+
+    // Turn bracketed paste off again before anything else owns the terminal
+    output_str("\033[?2004l");
+    flush_output();
+    tcsetattr(STDIN_FILENO, TCSANOW, &orig_termios);
+}
+
+// Enables raw mode for the terminal to handle each keystroke directly; stays raw until something else needs the terminal
+void enable_raw_mode()
+{
+    terminal_init();
+    if (terminal_raw || !isatty(STDIN_FILENO))
+        return;
+    terminal_raw = 1;
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw_termios);
+    output_str("\033[?2004h");
+}
+
+// Returns the next input byte, reading a whole batch from the terminal when the buffer is empty
+// Pending screen updates are flushed before blocking; returns EOF at end of input and -2 when interrupted
+static int next_byte()
+{
+    if (input_start == input_end)
+    {
+        flush_output();
+        ssize_t n = read(STDIN_FILENO, input_buf, INPUT_BUFFER_SIZE);
+        if (n == -1 && errno == EINTR)
+            return -2;
+        if (n <= 0)
+            return EOF;
+        input_start = 0;
+        input_end = n;
+    }
+    return input_buf[input_start++];
+}
+
+// Reads one key, decoding escape sequences for arrows, Home/End/Delete and bracketed paste
+static int read_key()
+{
+    int c = next_byte();
+    if (c != ESCAPE_KEY)
+        return c;
+
+    int c1 = next_byte();
+    if (c1 == 'O')
+    {
+        int c2 = next_byte();
+        return c2 == 'H' ? KEY_HOME : c2 == 'F' ? KEY_END : KEY_NONE;
+    }
+    if (c1 != '[')
+        return c1 < 0 ? c1 : KEY_NONE;
+
+    int c2 = next_byte();
+    switch (c2)
+    {
+    case 'A':
+        return KEY_UP;
+    case 'B':
+        return KEY_DOWN;
+    case 'C':
+        return KEY_RIGHT;
+    case 'D':
+        return KEY_LEFT;
+    case 'H':
+        return KEY_HOME;
+    case 'F':
+        return KEY_END;
+    }
+
+    // Numeric sequences: ESC [ n ~
+    int number = 0;
+    while (c2 >= '0' && c2 <= '9')
+    {
+        number = number * 10 + c2 - '0';
+        c2 = next_byte();
+    }
+    if (c2 != '~')
+        return KEY_NONE;
+
+    switch (number)
+    {
+    case 1:
+    case 7:
+        return KEY_HOME;
+    case 4:
+    case 8:
+        return KEY_END;
+    case 3:
+        return KEY_DELETE;
+    case 200:
+        return KEY_PASTE_START;
+    case 201:
+        return KEY_PASTE_END;
+    }
+    return KEY_NONE;
+}
+
+// Queues a redraw of the whole line with the cursor at its position
+static void refresh_line(LineState *state)
+{
+    char move[32];
+
+    output_str("\r");
+    if (state->searching)
+    {
+        output_str(state->failing ? "(failing reverse-i-search)`" : "(reverse-i-search)`");
+        output(state->query, state->query_len);
+        output_str("': ");
+    }
+    else
+    {
+        output_str(state->prompt);
+        output_str(" ");
+    }
+    output(state->line, state->len);
+    output_str("\033[K");
+
+    if (!state->searching && state->pos < state->len)
+    {
+        snprintf(move, sizeof(move), "\033[%dD", state->len - state->pos);
+        output_str(move);
+    }
+}
+
+// Replaces the line with history entry index, or clears it past the newest entry
+static void load_history_entry(LineState *state, int index)
+{
+    current_history_index = index;
+    if (history_get(index, state->line, MAX_COMMAND_LENGTH) == -1)
+        state->line[0] = '\0';
+    state->len = strlen(state->line);
+    state->pos = state->len;
+}
+
+// Inserts one character at the cursor
+static void insert_char(LineState *state, int c)
+{
+    if (state->len >= MAX_COMMAND_LENGTH - 1)
+        return;
+    memmove(state->line + state->pos + 1, state->line + state->pos, state->len - state->pos);
+    state->line[state->pos++] = c;
+    state->line[++state->len] = '\0';
+}
+
+// Deletes the character at index at, if any
+static void delete_char(LineState *state, int at)
+{
+    if (at < 0 || at >= state->len)
+        return;
+    memmove(state->line + at, state->line + at + 1, state->len - at);
+    state->len--;
+    if (state->pos > at)
+        state->pos--;
+}
+
+// Lists completion candidates below the line in columns as wide as the terminal allows
+static void list_matches(const Completion *completion)
+{
+    struct winsize size;
+    int width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 ? size.ws_col : 80;
+    int shown = completion->count < MAX_LISTED_MATCHES ? completion->count : MAX_LISTED_MATCHES;
+    int column = 0;
+
+    for (int i = 0; i < shown; i++)
+    {
+        int len = strlen(completion->matches[i]);
+        column = len > column ? len : column;
+    }
+    column += 2;
+    int per_row = width / column > 0 ? width / column : 1;
+    int rows = (shown + per_row - 1) / per_row;
+
+    // Column-major, like ls
+    output_str("\n");
+    for (int row = 0; row < rows; row++)
+    {
+        for (int i = row; i < shown; i += rows)
+        {
+            const char *match = completion->matches[i];
+            output_str(match);
+            if (i + rows < shown)
+            {
+                for (int pad = strlen(match); pad < column; pad++)
+                    output_str(" ");
+            }
+        }
+        output_str("\n");
+    }
+    if (shown < completion->count)
+    {
+        char more[64];
+        snprintf(more, sizeof(more), "... and %d more\n", completion->count - shown);
+        output_str(more);
+    }
+}
+
+// Completes the word before the cursor as far as all its candidates agree, escaping what a file name needs
+// escaped; a single candidate gets a space after it unless it is a directory. With several candidates and
+// nothing left to add, they are listed instead, and with none the terminal bell rings
+static void complete(LineState *state)
+{
+    Completion completion;
+    ArenaMark mark = arena_mark(&line_arena);
+
+    complete_word(state->line, state->pos, &completion);
+    if (completion.count == 0)
+    {
+        output_str("\a");
+        arena_rewind(&line_arena, mark);
+        return;
+    }
+
+    // The matches are sorted, so what the first and last share every one shares
+    const char *first = completion.matches[0];
+    const char *last = completion.matches[completion.count - 1];
+    int common = completion.typed;
+    while (first[common] != '\0' && first[common] == last[common])
+        common++;
+
+    for (int i = completion.typed; i < common; i++)
+    {
+        if (completion.files && strchr(" \t'\"\\$`|&;<>()", first[i]) != NULL)
+            insert_char(state, '\\');
+        insert_char(state, first[i]);
+    }
+    if (completion.count == 1 && common > 0 && first[common - 1] != '/')
+        insert_char(state, ' ');
+    else if (completion.count > 1 && common == completion.typed)
+        list_matches(&completion);
+    arena_rewind(&line_arena, mark);
+}
+
+// Handles one key in reverse search mode, returns 1 when the key should then be handled as a normal key
+static int search_key(LineState *state, int key)
+{
+    int before = state->match;
+
+    if (key == CTRL_R)
+    {
+        // Look for an older match
+    }
+    else if (key == BACKSPACE)
+    {
+        if (state->query_len > 0)
+            state->query[--state->query_len] = '\0';
+        before = history_count;
+    }
+    else if (key >= 0 && key < 256 && isprint(key))
+    {
+        if (state->query_len < MAX_COMMAND_LENGTH - 1)
+        {
+            state->query[state->query_len++] = key;
+            state->query[state->query_len] = '\0';
+        }
+        // Typing re-checks the current match first
+        before = state->match < history_count ? state->match + 1 : history_count;
+    }
+    else if (key == CTRL_G)
+    {
+        // Cancel the search and put the original line back
+        strcpy(state->line, state->saved);
+        state->len = state->pos = strlen(state->line);
+        state->searching = 0;
+        return 0;
+    }
+    else
+    {
+        // Any other key accepts the match and keeps its usual meaning
+        state->searching = 0;
+        return 1;
+    }
+
+    int found = state->query_len > 0 ? history_search(state->query, before) : -1;
+    state->failing = state->query_len > 0 && found == -1;
+    if (found != -1)
+    {
+        state->match = found;
+        load_history_entry(state, found);
+    }
+    return 0;
+}
+
+// Reads user input with command history navigation support, storing the input in the command buffer
+// Keys are taken from bulk reads and the screen is updated once per batch; returns -1 at end of input
+int read_input_with_history(char *command, const char *prompt_name)
+{
+    LineState state;
+
+    memset(command, 0, MAX_COMMAND_LENGTH);
+    state.line = command;
+    state.len = 0;
+    state.pos = 0;
+    state.prompt = prompt_name;
+    state.searching = 0;
+    current_history_index = history_count;
+
+    enable_raw_mode();
+    fflush(stdout);
+    refresh_line(&state);
+
+    while (1)
+    {
+        int key = read_key();
+
+        if (key == -2)
+        {
+            // Control-C: the handler printed its message, start over on a fresh line
+            state.len = state.pos = 0;
+            command[0] = '\0';
+            state.searching = 0;
+            in_paste = 0;
+            refresh_line(&state);
+            continue;
+        }
+        if (key == EOF)
+        {
+            flush_output();
+            return -1;
+        }
+
+        if (state.searching && !search_key(&state, key))
+        {
+            if (input_start == input_end)
+                refresh_line(&state);
+            continue;
+        }
+
+        if (in_paste && key != KEY_PASTE_END && key != '\n' && key != '\r')
+        {
+            // Pasted text is inserted literally, control characters included
+            if (key < 256)
+                insert_char(&state, key);
+        }
+        else
+        {
+            switch (key)
+            {
+            case KEY_PASTE_START:
+                in_paste = 1;
+                break;
+            case KEY_PASTE_END:
+                in_paste = 0;
+                break;
+            case '\n':
+            case '\r':
+                // Lines after this one in a paste stay buffered for the next prompt
+                state.pos = state.len;
+                refresh_line(&state);
+                output_str("\n");
+                flush_output();
+                return 0;
+            case KEY_UP:
+                if (current_history_index > 0)
+                    load_history_entry(&state, current_history_index - 1);
+                break;
+            case KEY_DOWN:
+                if (current_history_index < history_count)
+                    load_history_entry(&state, current_history_index + 1);
+                break;
+            case KEY_LEFT:
+                if (state.pos > 0)
+                    state.pos--;
+                break;
+            case KEY_RIGHT:
+                if (state.pos < state.len)
+                    state.pos++;
+                break;
+            case KEY_HOME:
+            case CTRL_A:
+                state.pos = 0;
+                break;
+            case KEY_END:
+            case CTRL_E:
+                state.pos = state.len;
+                break;
+            case BACKSPACE:
+            case '\b':
+                delete_char(&state, state.pos - 1);
+                break;
+            case KEY_DELETE:
+                delete_char(&state, state.pos);
+                break;
+            case CTRL_D:
+                // Control-D ends input on an empty line and deletes forward otherwise
+                if (state.len == 0)
+                {
+                    output_str("\n");
+                    flush_output();
+                    return -1;
+                }
+                delete_char(&state, state.pos);
+                break;
+            case '\t':
+                complete(&state);
+                break;
+            case CTRL_R:
+                strcpy(state.saved, command);
+                state.searching = 1;
+                state.query[0] = '\0';
+                state.query_len = 0;
+                state.match = history_count;
+                state.failing = 0;
+                break;
+            default:
+                if (key < 256 && isprint(key))
+                    insert_char(&state, key);
+                break;
+            }
+        }
+
+        // Redraw once for the whole batch of keys that arrived together
+        if (input_start == input_end)
+            refresh_line(&state);
+    }
+}
+
+// Reads one line straight from descriptor fd, so nothing after the newline is consumed and commands run next
+// read the rest: a seekable file a block at a time, with its offset moved back to the end of the line, anything
+// else a byte at a time. Keeps what fits in out; returns the length of the whole line, or -1 at end of input
+long read_input_line(int fd, char *out, int size)
+{
+    char block[INPUT_BUFFER_SIZE];
+    size_t want = lseek(fd, 0, SEEK_CUR) != -1 ? sizeof(block) : 1;
+    long len = 0;
+    int kept = 0;
+    ssize_t n;
+
+    while ((n = read(fd, block, want)) > 0)
+    {
+        char *nl = memchr(block, '\n', n);
+        ssize_t take = nl != NULL ? nl - block : n;
+        int room = size - 1 - kept;
+        int copied = take < room ? (int)take : room;
+
+        memcpy(out + kept, block, copied);
+        kept += copied;
+        len += take;
+        if (nl != NULL)
+        {
+            if (nl + 1 < block + n)
+                lseek(fd, nl + 1 - (block + n), SEEK_CUR);
+            out[kept] = '\0';
+            return len;
+        }
+    }
+    if (len == 0)
+        return -1;
+    out[kept] = '\0';
+    return len;
+}
+
+// Reads one line straight from descriptor fd, cut to fit in out, leaving what follows the newline unread
+int read_unbuffered_line(int fd, char *out, int size)
+{
+    long len = read_input_line(fd, out, size);
+    return len > size - 1 ? size - 1 : (int)len;
+}
+
+// Reads one plain line (for the read builtin) with the terminal in its normal mode
+// Bytes already buffered by the editor are used first; returns the length or -1 at end of input
+int read_plain_line(char *out, int size)
+{
+    int len = 0;
+
+    // The editor's buffer holds the shell's input, not whatever standard input was redirected from; without
+    // the editor, standard input is the script, whose lines after this one belong to the shell
+    if (input_redirected || !interactive)
+        return read_fd_line(STDIN_FILENO, out, size);
+
+    disable_raw_mode();
+    fflush(stdout);
+    while (1)
+    {
+        int c = next_byte();
+        if (c == -2)
+            continue;
+        if (c == EOF)
+        {
+            if (len == 0)
+                return -1;
+            break;
+        }
+        if (c == '\n')
+            break;
+        if (len < size - 1)
+            out[len++] = c;
+    }
+    out[len] = '\0';
+    return len;
+}
@@ -4,54 +4,32 @@
 pid_t pid = -1;
 pid_t pipe_pid = -1;
 
-// Global struct and variables to store user variables
-typedef struct
-{
-    char name[MAX_COMMAND_LENGTH];
-    char value[MAX_COMMAND_LENGTH];
-} Variable;
-Variable variables[MAX_ARG_COUNT];
-int variable_count = 0;
-
-// Global variable to store the exit status of the last executed command
+// Global variable to store the exit code of the last executed command (128 + signal number for a killed one)
 int last_exit_status = 0;
 
-// Global variables to be reached from any function needed
-int amper, redirect_out, redirect_err, redirect_out_app;
-char *outfile, *errfile;
+// Global flag set by Control-C so a running command list or loop stops early
+volatile sig_atomic_t interrupted = 0;
+
+// Global variables to store the exit code of every stage of the last pipeline
+int pipe_status[MAX_ARG_COUNT];
+int pipe_status_count = 0;
+int pipefail = 0;
+
+// Global buffer size given to every pipeline pipe by set pipebuf, 0 to keep the system default
+int pipe_buffer_size = 0;
+
+// Global flag set when the pipeline being run ended with '&'
+int amper;
 
 // Global variables to be handle history of commands
-char command_history[MAX_HISTORY_SIZE][MAX_COMMAND_LENGTH];
-int history_count = 0;
-int current_history_index = -1;
 char command[MAX_COMMAND_LENGTH];
-char curr_command[MAX_COMMAND_LENGTH];
 char last_command[MAX_COMMAND_LENGTH] = "";
 
 // Global variable to store prompt name
 char *prompt_name;
 
-struct termios orig_termios;
-
-// Disables raw mode and restores original terminal settings
-void disable_raw_mode()
-{
-    tcsetattr(STDIN_FILENO, TCSANOW, &orig_termios);
-}
-
-// Enables raw mode for the terminal to handle each keystroke directly
-void enable_raw_mode()
-{
-    tcgetattr(STDIN_FILENO, &orig_termios);
-    atexit(disable_raw_mode);
-
-    struct termios raw = orig_termios;
-    raw.c_lflag &= ~(ECHO | ICANON);
-    raw.c_cc[VMIN] = 1;
-    raw.c_cc[VTIME] = 0;
-
-    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
-}
+// Global flag set when reading commands from a terminal (line editing, history and job control)
+int interactive = 0;
 
 // Prints the exit status of the last executed command
 void print_status()
@@ -63,6 +41,7 @@ void print_status()
 void handle_sigint()
 {
     printf("\nYou typed Control-C!\n");
+    interrupted = 1;
 
     // Check if the process IDs are valid and active
     if (pid > 0)
@@ -76,6 +55,11 @@ void handle_sigint()
         // Kill the child process or process group
         killpg(pipe_pid, SIGKILL);
     }
+
+    // A coprocess the shell is waiting on to finish gets the interrupt; the others are in process groups of
+    // their own and stay running
+    if (coproc_pgid > 0)
+        killpg(coproc_pgid, SIGINT);
 }
 
 // Function to trim leading and trailing spaces
@@ -113,7 +97,25 @@ char *my_strdup(const char *s)
     return dup;
 }
 
-// Function to split a string by a delimiter and handle multiple spaces
+// FNV-1a hash of len bytes, shared by the shell's hash tables
+unsigned int hash_bytes(const char *s, size_t len)
+{
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Compares two strings through pointers to them, for qsort and bsearch
+int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Function to split a string by a delimiter and handle multiple spaces, tokens live in the line arena
 char **split_string(const char *str, const char delimiter, int *num_tokens)
 {
     int count = 0;
@@ -127,22 +129,11 @@ char **split_string(const char *str, const char delimiter, int *num_tokens)
         temp++;
     }
 
-    // Allocate memory for tokens
-    char **tokens = malloc((count + 1) * sizeof(char *));
-    if (tokens == NULL)
-    {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+    // Allocate memory for tokens plus the NULL terminator execv expects
+    char **tokens = arena_alloc(&line_arena, (count + 2) * sizeof(char *));
 
     int index = 0;
-    char *start = my_strdup(str); // Duplicate the input string
-    if (start == NULL)
-    {
-        fprintf(stderr, "Memory allocation failed\n");
-        free(tokens);
-        exit(EXIT_FAILURE);
-    }
+    char *start = arena_strdup(&line_arena, str); // Duplicate the input string
 
     char *end = strchr(start, delimiter);
     while (end != NULL)
@@ -153,721 +144,559 @@ char **split_string(const char *str, const char delimiter, int *num_tokens)
         end = strchr(start, delimiter);
     }
     tokens[index++] = trim(start);
+    tokens[index] = NULL;
 
     *num_tokens = index;
     return tokens;
 }
 
-// Allocates memory for a 3D array of strings to store multiple commands and arguments
-void argvAllocate(char ****argv)
+// Converts a raw wait status into a shell exit code (128 + signal number for killed children)
+int status_to_exit_code(int status)
 {
-    char ***argvVal = *argv;
-    for (int i = 0; i < MAX_ARG_COUNT; i++)
-    {
-        argvVal[i] = (char **)(malloc(sizeof(char *) * 10));
-        for (int j = 0; j < MAX_COMMAND_LENGTH; j++)
-        {
-            argvVal[i][j] = (char *)(malloc(sizeof(char *) * MAX_SUBCOMMAND_LENGTH));
-        }
-    }
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return status;
 }
 
-// Parses a command string into individual commands and arguments, updating argc and argv_count
-void parse_command(char *command, char ****argv, int *argc, int *argv_count)
+// Returns the raw status of a pipeline: the last stage's, or with pipefail the rightmost failing stage's
+int pipeline_status(const int *statuses, int count)
 {
-    int num_tokens;
-    char ***argvArray = *argv;
-    char **commands = split_string(command, '|', &num_tokens);
-
-    *argv_count = num_tokens;
-    for (int i = 0; i < num_tokens; i++)
+    int status = statuses[count - 1];
+    for (int i = 0; pipefail && i < count; i++)
     {
-        // Tokenize each command by spaces
-        int num_subtokens;
-
-        argvArray[i] = split_string(commands[i], ' ', &num_subtokens);
-        argc[i] = num_subtokens;
+        if (status_to_exit_code(statuses[i]) != 0)
+            status = statuses[i];
     }
-
-    free(commands); // Free the memory allocated for commands
+    return status;
 }
 
-// Retrieves the value of a shell variable given its name
-char *get_variable_value(const char *name)
+// Records each stage's exit code in $PIPESTATUS and the pipeline's status in last_exit_status
+void set_pipeline_status(const int *statuses, int count)
 {
-    for (int i = 0; i < variable_count; i++)
+    char pipestatus[MAX_COMMAND_LENGTH] = "";
+    pipe_status_count = count;
+    for (int i = 0; i < count; i++)
     {
-        if (strcmp(variables[i].name, name) == 0)
-        {
-            return variables[i].value;
-        }
+        pipe_status[i] = status_to_exit_code(statuses[i]);
+        snprintf(pipestatus + strlen(pipestatus), sizeof(pipestatus) - strlen(pipestatus), i > 0 ? " %d" : "%d",
+                 pipe_status[i]);
     }
-    return NULL;
+    last_exit_status = status_to_exit_code(pipeline_status(statuses, count));
+    set_variable_value("$PIPESTATUS", pipestatus);
 }
 
-// Sets the value of a shell variable, adding it if it does not exist
-void set_variable_value(const char *name, const char *value)
+// Stores in usage what the shell used since before, for a builtin stage run in the shell
+static void stage_usage(struct rusage *usage, const struct rusage *before)
 {
-    // check if variable already exist
-    for (int i = 0; i <= variable_count; i++)
-    {
-        if (strcmp(variables[i].name, name) == 0)
-        {
-            strcpy(variables[i].value, value);
-            return;
-        }
-    }
+    getrusage(RUSAGE_SELF, usage);
+    timersub(&usage->ru_utime, &before->ru_utime, &usage->ru_utime);
+    timersub(&usage->ru_stime, &before->ru_stime, &usage->ru_stime);
+    usage->ru_nvcsw -= before->ru_nvcsw;
+    usage->ru_nivcsw -= before->ru_nivcsw;
+}
 
-    if (variable_count < MAX_ARG_COUNT)
-    {
-        strcpy(variables[variable_count].name, name);
-        strcpy(variables[variable_count].value, value);
-        variable_count++;
-    }
-    else
+// Decides which builtin stages can run inside the shell, one after the other once the external stages are
+// started. Only builtins that leave the shell's state alone qualify, and read as the last stage; the others
+// are forked like external commands. A builtin writing through forked stages into a later in-process
+// builtin could fill a pipe nobody drains yet, so such a builtin (and every builtin before it) is forked
+// to run alongside instead
+static void plan_builtin_stages(const Builtin **builtins, int *in_process, int argv_count)
+{
+    int builtin_after = 0;
+    int crosses_external = 0;
+
+    for (int i = argv_count - 1; i >= 0; i--)
     {
-        fprintf(stderr, "Max variable count reached.\n");
+        int allowed = builtins[i] != NULL &&
+                      (builtins[i]->stage == STAGE_ANY || (builtins[i]->stage == STAGE_LAST && i == argv_count - 1));
+        in_process[i] = allowed && !crosses_external;
+        if (in_process[i])
+            builtin_after = 1;
+        else
+            crosses_external |= builtin_after;
     }
 }
 
-// Adds a command to the history, shifting the oldest commands if the history is full
-void add_to_history(const char *command)
+// Connects stage i to stage i + 1: a pipe, or between two builtins that run one after the other an
+// in-memory file, which cannot fill up
+static void connect_stages(int sequential, int *write_fd, int *read_fd)
 {
-    if (history_count < MAX_HISTORY_SIZE)
-    {
-        strcpy(command_history[history_count], command);
-        history_count++;
-    }
-    else
+    int fildes[2];
+
+    if (sequential)
     {
-        // Shift existing history to make space for new command
-        for (int i = 0; i < MAX_HISTORY_SIZE - 1; i++)
+        int fd = memfd_create("pipe", MFD_CLOEXEC);
+        if (fd != -1)
         {
-            strcpy(command_history[i], command_history[i + 1]);
+            *write_fd = fd;
+            *read_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            return;
         }
-        strcpy(command_history[MAX_HISTORY_SIZE - 1], command);
     }
-    current_history_index = history_count;
-}
 
-// Displays a command from the history at the current history index
-void display_command_from_history(char *command, const char *prompt_name)
-{
-    if (current_history_index >= 0 && current_history_index < history_count)
+    // Close-on-exec so only the dup'ed ends survive in the children
+    if (pipe2(fildes, O_CLOEXEC) == -1)
     {
-        strcpy(command, command_history[current_history_index]);
-        printf("\r%s: %s\033[K", prompt_name, command); // Clear line after the command
-        fflush(stdout);
+        perror("pipe");
+        exit(1);
     }
+    if (pipe_buffer_size > 0)
+        fcntl(fildes[1], F_SETPIPE_SZ, pipe_buffer_size);
+    *write_fd = fildes[1];
+    *read_fd = fildes[0];
 }
 
-// Handles arrow key presses to navigate through command history and updates the current command
-void handle_arrow_key_press(int key, char *command, const char *prompt_name)
+// Opens the file of a leading "cat file |" for the next stage to read directly, saving a process and a copy
+// through a pipe; the cat stage then reports status 0 without running. Only a cat of one file that is not an
+// option qualifies, never while cat is a shell function, and not when the next stage takes its stdin from
+// somewhere else anyway. Returns -1 when it does not apply, or when the file cannot be opened or is a
+// directory, so the real cat runs and reports the error itself
+static int open_useless_cat(char ***argv, Redirect **redirects, const Builtin **builtins, int argv_count)
 {
-    if (key == UP_ARROW)
+    char **cat = argv[0];
+    struct stat st;
+
+    if (argv_count < 2 || builtins[0] != NULL || redirects[0] != NULL || strcmp(cat[0], "cat") != 0 ||
+        cat[1] == NULL || cat[2] != NULL || cat[1][0] == '-')
+        return -1;
+    for (const Redirect *redirect = redirects[1]; redirect != NULL; redirect = redirect->next)
     {
-        if (current_history_index > 0)
-        {
-            current_history_index--;
-            display_command_from_history(command, prompt_name);
-        }
+        if (redirect->fd == STDIN_FILENO)
+            return -1;
     }
-    else if (key == DOWN_ARROW)
+
+    int fd = open(cat[1], O_RDONLY | O_CLOEXEC);
+    if (fd != -1 && (fstat(fd, &st) == -1 || S_ISDIR(st.st_mode)))
     {
-        if (current_history_index < history_count)
-        {
-            current_history_index++;
-            if (current_history_index == history_count)
-            {
-                // Clear the line for new command
-                printf("\r%s: \033[K", prompt_name);
-                fflush(stdout);
-                command[0] = '\0'; // Clear the command buffer
-            }
-            else
-            {
-                display_command_from_history(command, prompt_name);
-            }
-        }
+        close(fd);
+        fd = -1;
     }
+    return fd;
 }
 
-// Reads user input with command history navigation support, storing the input in the command buffer
-void read_input_with_history(char *command, const char *prompt_name)
+// Handles the execution of commands connected by pipes. Every stage is looked up in the builtin table:
+// a lone builtin simply runs in the shell, otherwise the external and forked builtin stages are launched up
+// front into one process group and the other builtin stages run in the shell with their ends of the pipes
+// as stdin and stdout
+// The pipeline becomes one job, waited for in the foreground or left running with '&'
+void handle_pipes(char ***argv, Redirect **redirects, int argv_count)
 {
-    enable_raw_mode();
-    int c;
-    int pos = 0;
-    memset(command, 0, MAX_COMMAND_LENGTH);
+    const Builtin *builtins[MAX_ARG_COUNT];
+    int in_process[MAX_ARG_COUNT];
+    int in_fds[MAX_ARG_COUNT];
+    int out_fds[MAX_ARG_COUNT];
+    int *redirect_fds;
+    int redirect_count;
+    pid_t pgid = 0;
+    sigset_t old_mask;
+    LaunchPlan plan;
+
+    if (argv_count == 0)
+        return;
 
-    printf("%s ", prompt_name);
-    fflush(stdout);
+    for (int i = 0; i < argv_count; i++)
+        builtins[i] = find_builtin(argv[i]);
 
-    while (1)
-    {
-        signal(SIGINT, handle_sigint);
+    // While the rc file runs, only a lone builtin without redirections can go into its snapshot
+    if (rc_recording)
+        rc_record(argv_count == 1 && redirects[0] == NULL ? builtins[0] : NULL, argv[0]);
 
-        if ((c = getchar()) == EOF)
+    if (argv_count == 1 && builtins[0] != NULL)
+    {
+        // No process and no job at all
+        launch_plan_init(&plan, -1);
+        if (plan_redirects(&plan, redirects[0], &redirect_fds, &redirect_count) == -1)
         {
-            printf("%s: ", prompt_name);
-            continue;
+            last_exit_status = 1;
+            return;
         }
+        long long builtin_start = trace_start();
+        run_builtin(builtins[0], argv[0], &plan);
+        trace_span("builtin", builtin_start, argv[0][0], 0);
+        close_redirect_fds(redirect_fds, redirect_count);
+        return;
+    }
 
-        if (c == ESCAPE_KEY)
-        {
-            if (getchar() == '[')
-            {
-                switch (getchar())
-                {
-                case 'A': // Up arrow
-                    handle_arrow_key_press(UP_ARROW, command, prompt_name);
-                    pos = strlen(command);
-                    break;
-                case 'B': // Down arrow
-                    handle_arrow_key_press(DOWN_ARROW, command, prompt_name);
-                    pos = strlen(command);
-                    break;
-                }
-            }
-        }
-        else if (c == '\n')
-        {
-            command[pos] = '\0';
-            printf("\n");
-            break;
-        }
-        else if (c == BACKSPACE)
-        {
-            if (pos > 0)
-            {
-                pos--;
-                command[pos] = '\0';
-                printf("\b \b"); // Move cursor back, print space, move cursor back again
-                fflush(stdout);
-            }
-        }
-        else
+    plan_builtin_stages(builtins, in_process, argv_count);
+    int cat_fd = open_useless_cat(argv, redirects, builtins, argv_count);
+    in_fds[0] = -1;
+    out_fds[argv_count - 1] = -1;
+    for (int i = 0; i < argv_count - 1; i++)
+    {
+        if (i == 0 && cat_fd != -1)
         {
-            if (pos < MAX_COMMAND_LENGTH - 1)
-            {
-                command[pos++] = c;
-                printf("%c", c);
-                fflush(stdout);
-            }
+            out_fds[0] = -1;
+            in_fds[1] = cat_fd;
+            continue;
         }
+        connect_stages(in_process[i] && in_process[i + 1], &out_fds[i], &in_fds[i + 1]);
     }
+
+    // The children get the terminal in its normal mode
     disable_raw_mode();
-}
 
-// Handles the execution of commands connected by pipes, setting up file descriptors and forking processes
-void handle_pipes(char ***argv, int argv_count)
-{
-    int fildes[2];
-    int fildes_prev[2];
-    int status;
-    pid_t pid;
+    // Hold SIGCHLD back until every stage is in the job table
+    block_child_signal(&old_mask);
+    Job *job = job_create(argv, argv_count);
 
     for (int i = 0; i < argv_count; i++)
     {
-        if (i < argv_count - 1)
-        {
-            // Create a pipe
-            if (pipe(fildes) == -1)
-            {
-                perror("pipe");
-                exit(1);
-            }
-        }
+        if (in_process[i] || (i == 0 && cat_fd != -1))
+            continue;
 
-        // Fork a child process
-        pid = fork();
-        if (pid == 0)
-        {
-            // Child process
-            if (i > 0)
-            {
-                // Redirect input from the previous pipe
-                dup2(fildes_prev[0], STDIN_FILENO);
-                close(fildes_prev[0]);
-                close(fildes_prev[1]);
-            }
-            if (i < argv_count - 1)
-            {
-                // Redirect output to the next pipe
-                close(fildes[0]);
-                dup2(fildes[1], STDOUT_FILENO);
-                close(fildes[1]);
-            }
+        // Only an interactive shell puts pipelines in their own process group
+        launch_plan_init(&plan, interactive ? pgid : -1);
+        if (out_fds[i] != -1)
+            launch_plan_dup(&plan, out_fds[i], STDOUT_FILENO);
+        if (in_fds[i] != -1)
+            launch_plan_dup(&plan, in_fds[i], STDIN_FILENO);
 
-            // Handle output redirection
-            if (redirect_out)
-            {
-                int fd = creat(outfile, 0660);
-                dup2(fd, STDOUT_FILENO);
-                close(fd);
-            }
-            else if (redirect_err)
-            {
-                int fd_err = creat(errfile, 0660);
-                dup2(fd_err, STDERR_FILENO);
-                close(fd_err);
-            }
-            else if (redirect_out_app)
-            {
-                int fd = open(outfile, O_WRONLY | O_CREAT | O_APPEND, 0660);
-                dup2(fd, STDOUT_FILENO);
-                close(fd);
-            }
-
-            if (execvp(argv[i][0], argv[i]) == -1)
-            {
-                fprintf(stderr, "Command execution failed: %s\n", strerror(errno));
-                exit(errno);
-            }
-        }
-        else if (pid > 0)
+        if (plan_redirects(&plan, redirects[i], &redirect_fds, &redirect_count) == -1)
+            job->statuses[i] = 1 << 8;
+        else
         {
-            // Parent process
-            if (i > 0)
-            {
-                // Close the previous pipe
-                close(fildes_prev[0]);
-                close(fildes_prev[1]);
-            }
-            if (i < argv_count - 1)
+            job->launched[i] = trace_start();
+            if (builtins[i] != NULL)
+                job->pids[i] = launch_builtin(builtins[i], argv[i], &plan);
+            else
+                job->pids[i] = launch_command(argv[i], &plan);
+            trace_span("spawn", job->launched[i], argv[i][0], 0);
+            if (job->pids[i] == -1)
             {
-                // Save the current pipe for the next iteration
-                fildes_prev[0] = fildes[0];
-                fildes_prev[1] = fildes[1];
+                fprintf(stderr, "Command execution failed: %s\n", strerror(errno));
+                job->statuses[i] = launch_failure_status(errno);
             }
-
-            // Wait for the child process to finish
-            if (!amper)
+            else
             {
-                waitpid(pid, &status, 0);
-                last_exit_status = status;
+                job->running++;
+                if (pgid == 0 && interactive)
+                    pgid = job->pids[i];
             }
+            close_redirect_fds(redirect_fds, redirect_count);
         }
-        else
-        {
-            perror("fork");
-            exit(1);
-        }
-    }
-}
 
-// Parses and executes a simple if-else command structure within the shell
-void execute_if_else(char *command)
-{
-    int argc;
-    char **argv1 = split_string(command, ' ', &argc);
-
-    if (argc < 5 || strcmp(argv1[0], "if") != 0)
-    {
-        fprintf(stderr, "Invalid if statement syntax\n");
-        return;
+        // The stage has its own copies now
+        if (in_fds[i] != -1)
+            close(in_fds[i]);
+        if (out_fds[i] != -1)
+            close(out_fds[i]);
     }
 
-    int then_index = -1;
-    int else_index = -1;
-    int fi_index = -1;
+    job->pgid = pgid;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
 
-    // Find the positions of 'then', 'else', and 'fi' in the argument list
-    for (int i = 1; i < argc; i++)
+    for (int i = 0; i < argv_count; i++)
     {
-        if (strcmp(argv1[i], "then") == 0)
-        {
-            then_index = i;
-        }
-        else if (strcmp(argv1[i], "else") == 0)
+        if (!in_process[i])
+            continue;
+
+        launch_plan_init(&plan, -1);
+        if (out_fds[i] != -1)
+            launch_plan_dup(&plan, out_fds[i], STDOUT_FILENO);
+        if (in_fds[i] != -1)
+            launch_plan_dup(&plan, in_fds[i], STDIN_FILENO);
+        if (plan_redirects(&plan, redirects[i], &redirect_fds, &redirect_count) == -1)
+            job->statuses[i] = 1 << 8;
+        else
         {
-            else_index = i;
+            // time reports an in-process stage with the shell's own usage while it ran
+            struct rusage before;
+            if (keep_finished_job)
+                getrusage(RUSAGE_SELF, &before);
+            long long builtin_start = trace_start();
+            run_builtin(builtins[i], argv[i], &plan);
+            trace_span("builtin", builtin_start, argv[i][0], 0);
+            if (keep_finished_job)
+                stage_usage(&job->usage[i], &before);
+            job->statuses[i] = last_exit_status << 8;
+            close_redirect_fds(redirect_fds, redirect_count);
         }
-        else if (strcmp(argv1[i], "fi") == 0)
+
+        // Closing the write end lets the next stage see the end of its input; an in-memory file
+        // is rewound for the builtin reading it next
+        if (in_fds[i] != -1)
+            close(in_fds[i]);
+        if (out_fds[i] != -1)
         {
-            fi_index = i;
+            if (i + 1 < argv_count && in_process[i + 1])
+                lseek(in_fds[i + 1], 0, SEEK_SET);
+            close(out_fds[i]);
         }
     }
 
-    if (then_index == -1 || else_index == -1 || fi_index == -1)
+    if (job->running == 0)
     {
-        fprintf(stderr, "Invalid if statement syntax: must be then , else and fi\n");
+        // Nothing left running: builtins only, or no stage could be started
+        job_finish(job);
         return;
     }
 
-    // Ensure 'then' comes before 'else' if both are present
-    if (then_index > else_index)
+    if (amper)
     {
-        fprintf(stderr, "Invalid if statement syntax: 'then' must come before 'else'\n");
+        job_background(job);
         return;
     }
 
-    if (else_index > fi_index)
-    {
-        fprintf(stderr, "Invalid if statement syntax: 'else' must come before 'fi'\n");
-        return;
-    }
+    // Wait for every stage together, handing the terminal to the pipeline meanwhile
+    job_foreground(job, 0);
+}
 
-    // Extract the condition
-    char condition[MAX_COMMAND_LENGTH] = "";
-    for (int i = 1; i < then_index; i++)
-    {
-        strcat(condition, argv1[i]);
-        if (i < then_index - 1)
+// Text of a compound command typed over several lines, collected until its last line arrives
+static char *pending = NULL;
+static size_t pending_len = 0;
+static size_t pending_capacity = 0;
+static int pending_depth = 0;
+static int pending_heredoc = 0; // the pending text ends inside a here-document
+
+// Appends a line to the pending compound command
+static void pending_append(const char *line)
+{
+    size_t len = strlen(line);
+    if (pending_len + len + 2 > pending_capacity)
+    {
+        size_t capacity = pending_capacity == 0 ? MAX_COMMAND_LENGTH : pending_capacity * 2;
+        while (capacity < pending_len + len + 2)
+            capacity *= 2;
+        char *grown = realloc(pending, capacity);
+        if (grown == NULL)
         {
-            strcat(condition, " ");
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
         }
+        pending = grown;
+        pending_capacity = capacity;
     }
+    memcpy(pending + pending_len, line, len);
+    pending_len += len;
+    pending[pending_len++] = '\n';
+    pending[pending_len] = '\0';
+}
 
-    int argc1[MAX_SUBCOMMAND_COUNTER] = {0};
-    int argv_count;
-    char ***argv;
-
-    argv = (char ***)malloc(MAX_ARG_COUNT * sizeof(char **));
-    if (argv == NULL)
-    {
-        fprintf(stderr, "Memory allocation failed for argv\n");
-        return; // Return error code
-    }
-    argvAllocate(&argv);
-
-    parse_command(condition, &argv, argc1, &argv_count);
-
-    int fd;
-    int po;
-    // Expand commands
-    expand_commands(&argv, &po, argc1, condition);
+// Drops the pending compound command
+static void pending_clear()
+{
+    pending_len = 0;
+    pending_depth = 0;
+    pending_heredoc = 0;
+}
 
-    int original_stdout = dup(STDOUT_FILENO);
+// Runs one line of input: history bookkeeping, then parsing and evaluating the command it completes
+// command holds MAX_COMMAND_LENGTH bytes, the room alias expansion has to rewrite it in place
+// Returns 1 when the line left a compound command or a here-document open and more lines are needed
+int run_line(char *command)
+{
+    // Everything parsed from the previous command is released at once
+    arena_reset(&line_arena);
+
+    // Without a prompt finished background jobs are released here, silently
+    if (!interactive)
+        job_notify();
+
+    Token *tokens;
+    const char *text = command;
+    int token_count;
+
+    if (pending_heredoc)
+    {
+        // Lines of a here-document are kept as they are; its delimiter line completes the pending text,
+        // unless another here-document of the same command follows
+        pending_append(command);
+        if (!heredoc_closes(command))
+            return 1;
+
+        text = pending;
+        token_count = lex_line(pending, &tokens);
+        if (token_count == LEX_INCOMPLETE)
+            return 1;
+        if (token_count < 0)
+        {
+            pending_clear();
+            last_exit_status = 2;
+            return 0;
+        }
 
-    // Handle output redirection
-    if (redirect_out)
-    {
-        fd = creat(outfile, 0660);
-        dup2(fd, STDOUT_FILENO);
-        close(fd);
-    }
-    else if (redirect_err)
-    {
-        fd = creat(errfile, 0660);
-        dup2(fd, STDERR_FILENO);
-        close(fd);
+        pending_heredoc = 0;
+        pending_depth = block_depth(pending, tokens, token_count);
+        if (pending_depth > 0)
+            return 1;
     }
-    else if (redirect_out_app)
-    {
-        fd = open(outfile, O_WRONLY | O_CREAT | O_APPEND, 0660);
-        dup2(fd, STDOUT_FILENO);
-        close(fd);
-    }
-
-    // // Execute the condition command
-    handle_pipes(argv, argv_count);
-
-    // Restore the original file descriptor of stdout
-    dup2(original_stdout, STDOUT_FILENO);
-    close(original_stdout);
-
-    // Check the condition command's exit status
-    if (WIFEXITED(last_exit_status))
+    else
     {
-        int condition_exit_status = last_exit_status;
-        if (condition_exit_status == 0)
+        // Check for the !! command
+        if (strcmp(command, "!!") == 0)
         {
-            // Condition is true
-            if (then_index != -1 && else_index != -1)
+            if (strlen(last_command) == 0)
             {
-                // 'then' and 'else' blocks both exist
-                for (int i = then_index + 1; i < else_index; i++)
-                {
-                    // Execute the 'then' block
-                    char *then_argv[MAX_ARG_COUNT];
-                    int then_argc = 0;
-                    while (argv1[i] != NULL && strcmp(argv1[i], "else") != 0)
-                    {
-                        then_argv[then_argc++] = argv1[i++];
-                    }
-                    then_argv[then_argc] = NULL;
-
-                    // Create a temporary 3D array to pass to expand_commands
-                    char ****temp_argv = (char ****)malloc(sizeof(char ***));
-                    *temp_argv = (char ***)malloc(sizeof(char **));
-                    (*temp_argv)[0] = then_argv;
-
-                    int need_fork = 1;
-                    expand_commands(temp_argv, &need_fork, &then_argc, then_argv[0]);
-                    free(*temp_argv);
-                    free(temp_argv);
-
-                    if (need_fork == 0)
-                    {
-                        continue;
-                    }
-
-                    pid_t then_pid = fork();
-                    if (then_pid == 0)
-                    {
-                        execvp(then_argv[0], then_argv);
-                        perror("execvp failed");
-                        exit(EXIT_FAILURE);
-                    }
-                    else if (then_pid > 0)
-                    {
-                        int then_status;
-                        waitpid(then_pid, &then_status, 0);
-                    }
-                    else
-                    {
-                        perror("fork failed");
-                    }
-                }
-            }
-            else if (then_index != -1 && else_index == -1 && fi_index != -1)
-            {
-                // 'then' block only exists
-                for (int i = then_index + 1; i < fi_index; i++)
-                {
-                    // Execute the 'then' block
-                    char *then_argv[MAX_ARG_COUNT];
-                    int then_argc = 0;
-                    while (argv1[i] != NULL && strcmp(argv1[i], "fi") != 0)
-                    {
-                        then_argv[then_argc++] = argv1[i++];
-                    }
-                    then_argv[then_argc] = NULL;
-
-                    // Create a temporary 3D array to pass to expand_commands
-                    char ****temp_argv = (char ****)malloc(sizeof(char ***));
-                    *temp_argv = (char ***)malloc(sizeof(char **));
-                    (*temp_argv)[0] = then_argv;
-
-                    int need_fork = 1;
-                    expand_commands(temp_argv, &need_fork, &then_argc, then_argv[0]);
-                    free(*temp_argv);
-                    free(temp_argv);
-
-                    if (need_fork == 0)
-                    {
-                        continue;
-                    }
-
-                    pid_t then_pid = fork();
-                    if (then_pid == 0)
-                    {
-                        execvp(then_argv[0], then_argv);
-                        perror("execvp failed");
-                        exit(EXIT_FAILURE);
-                    }
-                    else if (then_pid > 0)
-                    {
-                        int then_status;
-                        waitpid(then_pid, &then_status, 0);
-                    }
-                    else
-                    {
-                        perror("fork failed");
-                    }
-                }
+                printf("No previous command to repeat.\n");
+                return pending_len > 0;
             }
+            strcpy(command, last_command);
         }
-        else if (else_index != -1 && fi_index != -1)
-        {
-            // 'else' block exists
-            for (int i = else_index + 1; i < fi_index; i++)
-            {
-                // Execute the 'else' block
-                char *else_argv[MAX_ARG_COUNT];
-                int else_argc = 0;
-                while (argv1[i] != NULL && strcmp(argv1[i], "fi") != 0)
-                {
-                    else_argv[else_argc++] = argv1[i++];
-                }
-                else_argv[else_argc] = NULL;
-
-                // Create a temporary 3D array to pass to expand_commands
-                char ****temp_argv = (char ****)malloc(sizeof(char ***));
-                *temp_argv = (char ***)malloc(sizeof(char **));
-                (*temp_argv)[0] = else_argv;
-
-                int need_fork = 1;
-                expand_commands(temp_argv, &need_fork, &else_argc, else_argv[0]);
-                free(*temp_argv);
-                free(temp_argv);
 
-                if (need_fork == 0)
-                {
-                    continue;
-                }
+        // Check if the command is empty
+        if (command[strspn(command, " \t")] == '\0')
+            return pending_len > 0;
 
-                pid_t else_pid = fork();
-                if (else_pid == 0)
-                {
-                    execvp(else_argv[0], else_argv);
-                    perror("execvp failed");
-                    exit(EXIT_FAILURE);
-                }
-                else if (else_pid > 0)
-                {
-                    int else_status;
-                    waitpid(else_pid, &else_status, 0);
-                }
-                else
-                {
-                    perror("fork failed");
-                }
-            }
+        strcpy(last_command, command); // Store the current command as the last command
+        if (interactive)
+            add_to_history(command);
+
+        // Split the line into tokens once, and once more after aliases are replaced in its text
+        long long lex_start = trace_start();
+        token_count = lex_line(command, &tokens);
+        int aliased = token_count >= 0 ? expand_aliases(command, tokens, token_count) : 0;
+        if (aliased == 1)
+            token_count = lex_line(command, &tokens);
+        else if (aliased == -1)
+            token_count = -1;
+        trace_span("lex", lex_start, NULL, 0);
+        if (token_count == LEX_INCOMPLETE)
+        {
+            // The body of a here-document follows
+            pending_append(command);
+            pending_heredoc = 1;
+            return 1;
+        }
+        if (token_count < 0)
+        {
+            last_exit_status = 2;
+            return pending_len > 0;
         }
-    }
-}
-
-// Expands shell-specific commands or variables in the given command string and updates argv
-void expand_commands(char ****argv, int *need_fork, int *argc, char *command)
-{
-    char ***argvMat = *argv;
 
-    // Check for the !! command
-    if (strcmp(command, "!!") == 0)
-    {
-        if (strlen(last_command) == 0)
+        // A block spanning lines is only parsed once the line closing it arrives
+        int depth = pending_depth + block_depth(command, tokens, token_count);
+        if (pending_len > 0 || depth > 0)
         {
-            printf("No previous command to repeat.\n");
-            *need_fork = 0;
-            return;
+            pending_append(command);
+            pending_depth = depth;
+            if (depth > 0)
+                return 1;
+
+            text = pending;
+            token_count = lex_line(pending, &tokens);
         }
-        strcpy(command, last_command);
-        int num_subtokens;
-        argvMat[0] = split_string(last_command, ' ', &num_subtokens);
     }
-    else
+
+    // Parse the whole command into a tree, then walk it
+    Node *tree;
+    char *buf = arena_strdup(&line_arena, text);
+    long long parse_start = trace_start();
+    int status = parse_program(buf, text, tokens, token_count, &tree);
+    trace_span("parse", parse_start, NULL, 0);
+    if (status == PARSE_INCOMPLETE)
     {
-        strcpy(last_command, command); // Store the current command as the last command
+        // Still open although the keywords balance, keep collecting
+        if (pending_len == 0)
+            pending_append(command);
+        return 1;
     }
-    strcpy(curr_command, command);
 
-    // Check if the command is empty
-    if (argvMat[0][0] == NULL)
+    pending_clear();
+    if (status == PARSE_ERROR)
     {
-        *need_fork = 0;
-        return;
+        last_exit_status = 2;
+        return 0;
     }
 
-    int argc1 = argc[0];
+    interrupted = 0;
+    eval_tree(tree);
+    return 0;
+}
 
-    // Check for background execution
-    if (argc1 > 0 && strcmp(argvMat[0][argc1 - 1], "&") == 0)
-    {
-        amper = 1;
-        argvMat[0][argc1 - 1] = NULL;
-    }
-    else
-    {
-        amper = 0;
-    }
+// Reports a compound command or here-document left open when the input ends, and drops it
+void end_of_input()
+{
+    if (pending_len == 0)
+        return;
+    fprintf(stderr, "Syntax error: unexpected end of file\n");
+    pending_clear();
+    last_exit_status = 2;
+}
 
-    add_to_history(curr_command);
+// Runs every line of an in-memory script (a mapped file or a -c string) as fast as it can be parsed
+void run_script_buffer(const char *data, size_t size)
+{
+    size_t offset = 0;
+    int line_number = 0;
 
-    // Check for output redirection
-    if (argc1 > 2 && strcmp(argvMat[0][argc1 - 2], ">") == 0)
+    while (offset < size)
     {
-        redirect_out = 1;
-        argvMat[0][argc1 - 2] = NULL;
-        outfile = argvMat[0][argc1 - 1];
-    }
-    else if (argc1 > 2 && strcmp(argvMat[0][argc1 - 2], "2>") == 0)
-    {
-        redirect_err = 1;
-        argvMat[0][argc1 - 2] = NULL;
-        errfile = argvMat[0][argc1 - 1];
-    }
-    else if (argc1 > 2 && strcmp(argvMat[0][argc1 - 2], ">>") == 0)
-    {
-        redirect_out_app = 1;
-        argvMat[0][argc1 - 2] = NULL;
-        outfile = argvMat[0][argc1 - 1];
-    }
-    else
-    {
-        redirect_out = 0;
-        redirect_out_app = 0;
-        redirect_err = 0;
-    }
+        const char *nl = memchr(data + offset, '\n', size - offset);
+        size_t end = nl != NULL ? (size_t)(nl - data) : size;
+        size_t len = end - offset;
+        line_number++;
 
-    // Check for built-in commands
-    if (argc1 > 1 && strcmp(argvMat[0][0], "prompt") == 0)
-    {
-        free(prompt_name);
-        prompt_name = malloc(strlen(argvMat[0][argc1 - 1]) + 1);
-        if (prompt_name == NULL)
+        if (len >= MAX_COMMAND_LENGTH)
         {
-            perror("Memory allocation failed");
-            exit(EXIT_FAILURE);
-        }
-        strcpy(prompt_name, argvMat[0][argc1 - 1]);
-        *need_fork = 0;
-    }
-    else if (argc1 > 1 && strcmp(argvMat[0][0], "echo") == 0)
-    {
-        if (strcmp(argvMat[0][1], "$?") == 0)
-        {
-            printf("%d \n", last_exit_status);
+            fprintf(stderr, "line %d: command too long\n", line_number);
+            last_exit_status = 2;
         }
         else
         {
-            // Check for variable substitution
-            for (int i = 0; argvMat[0][i] != NULL; i++)
-            {
-                char *value = get_variable_value(argvMat[0][i]);
-                if (value != NULL)
-                {
-                    argvMat[0][i] = value;
-                }
-            }
-
-            for (int i = 1; i < argc1; i++)
-            {
-                printf("%s ", argvMat[0][i]);
-            }
-            printf("\n");
+            memcpy(command, data + offset, len);
+            command[len] = '\0';
+            run_line(command);
         }
-        *need_fork = 0;
+        offset = end + 1;
     }
-    else if (argc1 > 1 && strcmp(argvMat[0][0], "cd") == 0)
+    end_of_input();
+}
+
+// Maps a script file and runs it, returns -1 if it cannot be read
+int run_script_file(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, &st) == -1)
     {
-        if (chdir(argvMat[0][1]) != 0)
-        {
-            perror("chdir failed");
-        }
-        *need_fork = 0;
+        perror(path);
+        if (fd != -1)
+            close(fd);
+        return -1;
     }
-    else if (argc1 == 1 && strcmp(argvMat[0][0], "quit") == 0)
+
+    if (st.st_size == 0)
     {
-        exit(EXIT_SUCCESS);
+        close(fd);
+        return 0;
     }
-    else if (argc1 > 2 && argvMat[0][argc1 - 2] != NULL && strcmp(argvMat[0][argc1 - 2], "=") == 0)
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
     {
-        set_variable_value(argvMat[0][argc1 - 3], argvMat[0][argc1 - 1]);
-        *need_fork = 0;
+        perror(path);
+        return -1;
     }
-    else if (argc1 == 2 && strcmp(argvMat[0][0], "read") == 0)
-    {
-        char value[MAX_COMMAND_LENGTH];
-        if (fgets(value, sizeof(value), stdin) == NULL)
-        {
-            perror("fgets failed");
-            *need_fork = 0;
-        }
-        value[strcspn(value, "\n")] = '\0'; // Remove trailing newline
-        // Add a $ before argv1[1] using strcat
-        char var_name[MAX_COMMAND_LENGTH] = "$";
-        strcat(var_name, argvMat[0][1]);
 
-        set_variable_value(var_name, value);
-        *need_fork = 0;
+    // The whole file is read front to back once
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    run_script_buffer(data, st.st_size);
+    munmap(data, st.st_size);
+    return 0;
+}
+
+// Sets $0, $1.. and $# from the command line of a script or -c invocation
+void set_positional_parameters(int count, char **args)
+{
+    char name[32];
+    char value[32];
+
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(name, sizeof(name), "$%d", i);
+        set_variable_value(name, args[i]);
     }
+    snprintf(value, sizeof(value), "%d", count > 0 ? count - 1 : 0);
+    set_variable_value("$#", value);
 }
 
-int main()
+int main(int argc, char *argv_main[])
 {
-    char ***argv;
+    const char *command_string = NULL;
+    const char *script_path = NULL;
 
     prompt_name = malloc(strlen("hello:") + 1);
     if (prompt_name == NULL)
@@ -876,58 +705,105 @@ int main()
         exit(EXIT_FAILURE);
     }
 
-    argv = (char ***)malloc(MAX_ARG_COUNT * sizeof(char **));
-    if (argv == NULL)
-    {
-        fprintf(stderr, "Memory allocation failed for argv\n");
-        return 1; // Return error code
-    }
-    argvAllocate(&argv);
-
     strcpy(prompt_name, "hello:");
 
-    // Save the original stderr file descriptor
-    int original_stderr = dup(STDERR_FILENO);
+    // Inherited environment variables become exported shell variables
+    import_environment();
 
-    // Register the signal handler for SIGINT
-    signal(SIGINT, handle_sigint);
+    // MYSHELL_TRACE=file traces from the start, for shells that are not interactive
+    const char *trace_path = getenv("MYSHELL_TRACE");
+    if (trace_path != NULL && trace_path[0] != '\0')
+        trace_open(trace_path);
 
-    while (1)
+    // myshell -c 'commands' [name [args]], myshell script [args], or commands on stdin
+    if (argc > 1 && strcmp(argv_main[1], "-c") == 0)
     {
-        // Register the signal handler for SIGINT
-        signal(SIGINT, handle_sigint);
-        command[MAX_COMMAND_LENGTH - 1] = '\0'; // Remove trailing newline
+        if (argc < 3)
+        {
+            fprintf(stderr, "myshell: -c: option requires an argument\n");
+            return 2;
+        }
+        command_string = argv_main[2];
+        set_positional_parameters(argc > 3 ? argc - 3 : 1, argc > 3 ? argv_main + 3 : argv_main);
+    }
+    else if (argc > 1)
+    {
+        script_path = argv_main[1];
+        set_positional_parameters(argc - 1, argv_main + 1);
+    }
+    interactive = command_string == NULL && script_path == NULL && isatty(STDIN_FILENO);
 
-        int argc[MAX_SUBCOMMAND_COUNTER] = {0};
-        int argv_count;
-        int needfork = 1;
+    // Background jobs are reaped as they finish in every mode
+    jobs_init();
 
-        read_input_with_history(command, prompt_name);
+    if (!interactive)
+    {
+        // No terminal handling and no history, just run the commands
+        if (command_string != NULL)
+            run_script_buffer(command_string, strlen(command_string));
+        else if (script_path != NULL && run_script_file(script_path) == -1)
+            return 127;
+        else if (script_path == NULL)
+        {
+            // Standard input is read no further than each line, so the commands run can read what follows it
+            long len;
+            int line_number = 0;
+            while ((len = read_input_line(STDIN_FILENO, command, MAX_COMMAND_LENGTH)) != -1)
+            {
+                line_number++;
+                if (len >= MAX_COMMAND_LENGTH)
+                {
+                    fprintf(stderr, "line %d: command too long\n", line_number);
+                    last_exit_status = 2;
+                }
+                else
+                    run_line(command);
+            }
+            end_of_input();
+        }
 
-        parse_command(command, &argv, argc, &argv_count);
+        fflush(stdout);
+        return last_exit_status;
+    }
 
-        // Check if the command is empty
-        if (argv[0][0] == NULL)
-            continue;
+    // Save the original stderr file descriptor
+    int original_stderr = dup(STDERR_FILENO);
 
-        // Handle if-else statements
-        if (argc[0] > 0 && strcmp(argv[0][0], "if") == 0)
-        {
-            execute_if_else(command);
-            needfork = 0;
-        }
+    // Register the signal handler for SIGINT once, without SA_RESTART so a pending read is interrupted
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
 
-        // Expand commands
-        expand_commands(&argv, &needfork, argc, command);
+    // Ignore SIGTTOU so the shell can take the terminal back from a finished pipeline,
+    // and the stop signals so Ctrl-Z only stops the foreground job
+    signal(SIGTTOU, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
 
-        if (needfork == 0)
-        {
-            continue;
-        }
+    // Lead our own process group and own the terminal so jobs can be moved in and out of the foreground
+    setpgid(0, 0);
+    tcsetpgrp(STDIN_FILENO, getpgrp());
+
+    // The rc file can set $HISTFILE and $HISTSIZE, so it runs before the history log is loaded
+    rc_load();
+    history_init();
+
+    int more = 0;
+    while (1)
+    {
+        // Report background jobs that finished while the last command ran
+        if (!more)
+            job_notify();
+
+        // End of input leaves the shell like quit; a block still open gets a continuation prompt
+        if (read_input_with_history(command, more ? ">" : prompt_name) == -1)
+            break;
 
-        // Handle the piping commands
-        handle_pipes(argv, argv_count);
+        more = run_line(command);
     }
+    end_of_input();
 
     // Close the original stderr file descriptor
     close(original_stderr);
@@ -1,8 +1,14 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#define _GNU_SOURCE
+
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
@@ -12,6 +18,173 @@
 #include <signal.h>
 #include <termios.h>
 #include <ctype.h>
+#include <limits.h>
+
+#define MAX_FD_ACTIONS 8 // actions a launch plan holds before it moves them to the line arena
+
+// Kinds of descriptor setup performed in a launched child
+enum
+{
+    FD_ACTION_DUP,
+    FD_ACTION_OPEN,
+    FD_ACTION_CLOSE
+};
+
+// One descriptor operation applied in the child before exec
+typedef struct
+{
+    int type;
+    int fd;
+    int src_fd;
+    const char *path;
+    int flags;
+} FdAction;
+
+// Everything the launcher needs to start a command: descriptor actions and process group
+typedef struct
+{
+    FdAction *actions; // inline_actions until they are outgrown, then a larger copy in the line arena
+    int action_count;
+    int action_capacity;
+    FdAction inline_actions[MAX_FD_ACTIONS];
+    pid_t pgid;
+} LaunchPlan;
+
+// Where a builtin may run inside the shell as one stage of a longer pipeline; in any other stage it is
+// forked, so what it changes (the directory, variables, options, the shell's exit) stays out of the shell
+enum
+{
+    STAGE_FORKED,
+    STAGE_LAST, // the last stage, so "cmd | read line" sets the variable
+    STAGE_ANY   // changes nothing in the shell
+};
+
+// A command run by the shell itself; it reports failure by setting last_exit_status
+typedef struct
+{
+    const char *name;
+    void (*run)(char **argv);
+    int stage;
+} Builtin;
+
+// Kinds of tokens produced by the lexer; redirection operators, which may start with the number of the
+// descriptor they redirect, run from TOK_REDIRECT_OUT to TOK_HERESTRING
+enum
+{
+    TOK_WORD,
+    TOK_PIPE,
+    TOK_AMP,
+    TOK_SEMI,
+    TOK_REDIRECT_OUT, // >
+    TOK_APPEND,       // >>
+    TOK_REDIRECT_IN,  // <
+    TOK_DUP_OUT,      // >&
+    TOK_DUP_IN,       // <&
+    TOK_REDIRECT_ALL, // &>
+    TOK_HEREDOC,      // <<
+    TOK_HEREDOC_TABS, // <<-
+    TOK_HERESTRING,   // <<<
+    TOK_HEREDOC_BODY  // the delimiter word after << once the lexer has found its body, spanning the body
+};
+
+// lex_line() result for text that ends inside a here-document
+#define LEX_INCOMPLETE -2
+
+// A token as a span of the lexed line; quoted words still contain their quotes and escapes
+typedef struct
+{
+    int type;
+    int offset;
+    int length;
+    int quoted;
+    int expand; // holds a '$' outside single quotes, or an unquoted wildcard
+} Token;
+
+// First byte of an argv word that is kept raw by the parser and expanded each time the command runs
+#define EXPAND_MARK '\001'
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator owned by one input line, emptied in O(1) when the line is done
+typedef struct
+{
+    ArenaBlock *head;
+    ArenaBlock *current;
+    size_t bytes_used;
+    size_t heap_allocations;
+    size_t line_allocations;
+} Arena;
+
+// A position in an arena to rewind to
+typedef struct
+{
+    ArenaBlock *block;
+    size_t used;
+    size_t bytes_used;
+} ArenaMark;
+
+extern Arena line_arena;
+
+// Kinds of redirection attached to a pipeline stage
+enum
+{
+    REDIR_FILE,
+    REDIR_DUP,
+    REDIR_HEREDOC,
+    REDIR_HERESTRING
+};
+
+// One redirection of a pipeline stage, compiled by the parser; a stage chains its own in order
+typedef struct Redirect
+{
+    int type;
+    int fd;     // descriptor redirected
+    int flags;  // file: open flags
+    int src_fd; // dup: descriptor copied onto fd, -1 to close fd
+    char *word; // file name, dup source, here-document body or here-string, behind an EXPAND_MARK when
+                // expanded at run time
+    struct Redirect *next;
+} Redirect;
+
+// Kinds of nodes in a parsed command tree
+enum
+{
+    NODE_PIPELINE,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_UNTIL,
+    NODE_FOR,
+    NODE_GROUP,   // { list; }
+    NODE_FUNCTION // name() { list; }, a definition
+};
+
+// Results of parsing a complete command
+enum
+{
+    PARSE_OK,
+    PARSE_INCOMPLETE,
+    PARSE_ERROR
+};
+
+// One command of a parsed list, lists are chained through next; the tree lives in the line arena, and a
+// function's body in the function's own
+typedef struct Node
+{
+    int type;
+    struct Node *next;
+    char ***argv;           // pipeline: argv rows of the stages
+    int *argc;              // pipeline: word count of each stage
+    int argv_count;         // pipeline: number of stages
+    int background;         // pipeline: ended with '&'
+    int timed;              // preceded by the time keyword
+    Redirect **redirects;   // pipeline: redirections of each stage
+    struct Node *cond;      // if, while, until: condition list
+    struct Node *body;      // then branch, loop, group or function body
+    struct Node *else_part; // else branch; an elif is a nested if here
+    char *name;             // for: loop variable, with its '$'; function: its name
+    char **words;           // for: word list, NULL to walk the positional parameters
+    int word_count;
+} Node;
 
 void disable_raw_mode();
 void enable_raw_mode();
@@ -19,27 +192,187 @@ void handle_sigint();
 void print_status();
 char *trim(char *str);
 char *my_strdup(const char *s);
+unsigned int hash_bytes(const char *s, size_t len);
+int compare_strings(const void *a, const void *b);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+char *arena_strdup(Arena *arena, const char *s);
+void arena_reset(Arena *arena);
+ArenaMark arena_mark(const Arena *arena);
+void arena_rewind(Arena *arena, ArenaMark mark);
+void arena_free(Arena *arena);
+void arena_stats(const Arena *arena);
 char **split_string(const char *str, const char delimiter, int *num_tokens);
-void argvAllocate(char ****argv);
+int lex_line(const char *line, Token **tokens_out);
+char *token_text(char *buf, const Token *token);
+char *token_word(char *buf, const Token *token);
+const char *arith_end(const char *p);
+const char *command_end(const char *p);
+const char *backquote_end(const char *p);
+int heredoc_closes(const char *line);
+int redirect_source(const char *word);
+int token_is(const char *line, const Token *token, const char *word);
+extern const char *const command_keywords[];
+int parse_tokens(char *buf, const Token *tokens, int count, char ***argv, int *argc, Redirect **redirects,
+                 int *argv_count, int *background);
 void parse_command(char *command, char ****argv, int *argc, int *argv_count);
+int parse_program(char *buf, const char *line, const Token *tokens, int count, Node **tree);
+int block_depth(const char *line, const Token *tokens, int count);
+void eval_tree(Node *list);
+void eval_function(Node *body);
+extern int function_depth;
+int is_function(const char *name);
+void define_function(const char *name, const Node *body);
+int unset_function(const char *name);
+void function_builtin(char **argv);
+void local_builtin(char **argv);
+int expand_aliases(char *command, const Token *tokens, int count);
+void for_each_builtin(void (*visit)(const char *name));
+void for_each_function(void (*visit)(const char *name));
+void for_each_alias(void (*visit)(const char *name));
+void alias_builtin(char **argv);
+void unalias_builtin(char **argv);
+int arith_eval(const char *text, long *result);
+char *expand_word(const char *raw);
+char *expand_pattern(const char *raw);
+int expand_fields(const char *raw, char ***fields);
+char *expand_here_document(const char *raw);
+int is_glob_pattern(const char *word);
+int glob_expand(const char *pattern, char ***out);
+void glob_cache_reset();
+int read_directory(const char *path, void (*visit)(int fd, const struct dirent64 *entry, void *context),
+                   void *context);
+int plan_redirects(LaunchPlan *plan, const Redirect *redirect, int **fds, int *fd_count);
+void close_redirect_fds(const int *fds, int count);
+int write_all(int fd, const char *data, size_t len);
+void test_builtin(char **argv);
+void tee_builtin(char **argv);
+void parallel_builtin(char **argv);
+void coproc_builtin(char **argv);
+int coproc_exited(pid_t pid, int status);
+void coprocs_forget();
+extern pid_t coproc_pgid;
 char *get_variable_value(const char *name);
 void set_variable_value(const char *name, const char *value);
+int unset_variable(const char *name);
+int is_exported(const char *name);
+void export_variable(const char *name);
+void import_environment();
+void export_builtin(char **argv);
+void unset_builtin(char **argv);
+void history_init();
 void add_to_history(const char *command);
-void display_command_from_history(char *command, const char *prompt_name);
-void handle_arrow_key_press(int key, char *command, const char *prompt_name);
-void read_input_with_history(char *command, const char *prompt_name);
-void handle_pipes(char ***argv, int argv_count);
-void execute_if_else(char *command);
-void expand_commands(char ****argv, int *need_fork, int *argc, char *command);
+int history_get(int index, char *out, size_t size);
+int history_search(const char *query, int before);
+int read_input_with_history(char *command, const char *prompt_name);
+int read_plain_line(char *out, int size);
+long read_input_line(int fd, char *out, int size);
+int read_unbuffered_line(int fd, char *out, int size);
+int read_fd_line(int fd, char *out, int size);
+
+// Candidates for completing the word before the cursor, allocated from the line arena
+typedef struct
+{
+    char **matches; // sorted and unique; directories end in '/'
+    int count;
+    int typed; // length of the part of every match that is already typed
+    int files; // the matches are file names, whose special characters need escaping when inserted
+} Completion;
+
+void complete_word(const char *line, int pos, Completion *completion);
+int command_index_refresh();
+extern int history_count;
+void handle_pipes(char ***argv, Redirect **redirects, int argv_count);
+int status_to_exit_code(int status);
+void launch_plan_init(LaunchPlan *plan, pid_t pgid);
+void launch_plan_dup(LaunchPlan *plan, int src_fd, int fd);
+void launch_plan_open(LaunchPlan *plan, int fd, const char *path, int flags);
+void launch_plan_close(LaunchPlan *plan, int fd);
+pid_t launch_command(char **argv, const LaunchPlan *plan);
+int launch_failure_status(int err);
+int launch_and_wait(char **argv);
+extern int status_before_builtin;
+void run_builtin(const Builtin *builtin, char **argv, const LaunchPlan *plan);
+pid_t launch_builtin(const Builtin *builtin, char **argv, const LaunchPlan *plan);
+const Builtin *find_builtin(char **argv);
+const char *hash_lookup(const char *name);
+int hash_forget(const char *name);
+void hash_clear();
+void hash_builtin(char **argv);
+int pipeline_status(const int *statuses, int count);
+void set_pipeline_status(const int *statuses, int count);
+int run_line(char *command);
+void end_of_input();
+void run_script_buffer(const char *data, size_t size);
+int run_script_file(const char *path);
+void set_positional_parameters(int count, char **args);
+extern int interactive;
+extern const int child_default_signals[];
+extern int input_redirected;
+extern int pipefail;
+extern int noglob;
+extern int pipe_buffer_size;
+extern char *prompt_name;
+extern int rc_recording;
+void rc_record(const Builtin *builtin, char **argv);
+void rc_load();
+extern int trace_fd;
+int trace_open(const char *path);
+void trace_close();
+long long trace_start();
+void trace_span(const char *name, long long start, const char *detail, pid_t tid);
 
 #define MAX_ARG_COUNT 10          // max pipes
 #define MAX_COMMAND_LENGTH 1024   // command length
 #define MAX_SUBCOMMAND_LENGTH 480 // subcommand length
 #define MAX_SUBCOMMAND_COUNTER 10 // subcommand counter
-#define MAX_HISTORY_SIZE 20
-#define UP_ARROW 65
-#define DOWN_ARROW 66
 #define ESCAPE_KEY 27
 #define BACKSPACE 127
+#define CTRL_A 1
+#define CTRL_D 4
+#define CTRL_E 5
+#define CTRL_G 7
+#define CTRL_R 18
+
+// A pipeline tracked from launch until its stages are reaped and its status is reported
+typedef struct Job
+{
+    int id;
+    pid_t pgid;
+    pid_t pids[MAX_ARG_COUNT];
+    int statuses[MAX_ARG_COUNT];
+    struct rusage usage[MAX_ARG_COUNT]; // what each reaped stage used, from wait4()
+    long long launched[MAX_ARG_COUNT];  // trace clock when each stage was launched, 0 when not traced
+    int count;
+    int running;
+    unsigned int reaped;
+    int stopped;
+    int background;
+    char command[MAX_COMMAND_LENGTH];
+    struct Job *next;
+} Job;
+
+extern int last_exit_status;
+extern int amper;
+extern pid_t pipe_pid;
+extern volatile sig_atomic_t interrupted;
+extern int keep_finished_job;
+extern Job finished_job;
+void jobs_init();
+void block_child_signal(sigset_t *old);
+void job_collect();
+Job *job_create(char ***argv, int argv_count);
+void job_remove(Job *job);
+void jobs_forget();
+void job_finish(Job *job);
+Job *job_wait_any(Job *const *jobs, int count);
+void wait_until_reaped(const int *running);
+void job_foreground(Job *job, int cont);
+void job_background(Job *job);
+void job_notify();
+void jobs_builtin(char **argv);
+void fg_builtin(char **argv);
+void bg_builtin(char **argv);
+void wait_builtin(char **argv);
 
 #endif // SHELL_H
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "myshell.h"
+
+#include <sys/sendfile.h>
+
+#define PARALLEL_READ_CHUNK 65536
+#define PARALLEL_MAX_FAILURES 101
+
+// One command of a parallel run, from its launch until its output is printed
+typedef struct
+{
+    Job *job;
+    int output; // in-memory file collecting its standard output, -1 when ungrouped or printed
+    int done;
+} ParallelTask;
+
+// Builds the command for one argument: every {} in the template is replaced by it, and without any {} the
+// argument is added as the last word
+static char **task_argv(char **template, int template_count, const char *arg)
+{
+    char **argv = arena_alloc(&line_arena, (template_count + 2) * sizeof(char *));
+    size_t arg_len = strlen(arg);
+    int substituted = 0;
+
+    for (int i = 0; i < template_count; i++)
+    {
+        const char *word = template[i];
+        const char *hole = strstr(word, "{}");
+        if (hole == NULL)
+        {
+            argv[i] = template[i];
+            continue;
+        }
+
+        int holes = 0;
+        for (const char *p = hole; p != NULL; p = strstr(p + 2, "{}"))
+            holes++;
+        char *out = arena_alloc(&line_arena, strlen(word) + holes * arg_len + 1);
+        char *end = out;
+        for (; hole != NULL; hole = strstr(word, "{}"))
+        {
+            memcpy(end, word, hole - word);
+            end += hole - word;
+            memcpy(end, arg, arg_len);
+            end += arg_len;
+            word = hole + 2;
+        }
+        strcpy(end, word);
+        argv[i] = out;
+        substituted = 1;
+    }
+
+    argv[template_count] = substituted ? NULL : (char *)arg;
+    argv[template_count + 1] = NULL;
+    return argv;
+}
+
+// Adds one line to the argument list, skipping empty ones
+static void add_argument(char ***args, int *count, int *capacity, const char *line, size_t len)
+{
+    if (len == 0)
+        return;
+    if (*count == *capacity)
+    {
+        char **grown = arena_alloc(&line_arena, *capacity * 2 * sizeof(char *));
+        memcpy(grown, *args, *count * sizeof(char *));
+        *args = grown;
+        *capacity *= 2;
+    }
+    (*args)[(*count)++] = arena_strndup(&line_arena, line, len);
+}
+
+// Reads the argument list from standard input, one argument per line. Input redirected to this stage is
+// read in bulk, since all of it is ours; the shell's own input goes line by line like read
+static char **read_arguments(int *count)
+{
+    int capacity = 16;
+    char **args = arena_alloc(&line_arena, capacity * sizeof(char *));
+
+    *count = 0;
+    if (!input_redirected)
+    {
+        char line[MAX_COMMAND_LENGTH];
+        int len;
+        while ((len = read_plain_line(line, sizeof(line))) != -1)
+            add_argument(&args, count, &capacity, line, len);
+        return args;
+    }
+
+    char *data = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    while (1)
+    {
+        if (size - used < PARALLEL_READ_CHUNK)
+        {
+            size = size == 0 ? PARALLEL_READ_CHUNK * 2 : size * 2;
+            char *grown = realloc(data, size);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+        ssize_t n = read(STDIN_FILENO, data + used, size - used);
+        if (n == -1 && errno == EINTR && !interrupted)
+            continue;
+        if (n <= 0)
+            break;
+        used += n;
+    }
+
+    for (size_t start = 0; start < used;)
+    {
+        const char *nl = memchr(data + start, '\n', used - start);
+        size_t end = nl != NULL ? (size_t)(nl - data) : used;
+        add_argument(&args, count, &capacity, data + start, end - start);
+        start = end + 1;
+    }
+    free(data);
+    return args;
+}
+
+// Starts one task in the shell's process group as a job of its own, its standard output going to an
+// in-memory file when grouped. A task that cannot start is left as a finished job with the failure status
+static void task_start(ParallelTask *task, char **argv, int grouped)
+{
+    LaunchPlan plan;
+    sigset_t old_mask;
+
+    task->done = 0;
+    task->output = grouped ? memfd_create("parallel", MFD_CLOEXEC) : -1;
+    launch_plan_init(&plan, -1);
+    if (task->output != -1)
+        launch_plan_dup(&plan, task->output, STDOUT_FILENO);
+
+    // Hold SIGCHLD back until the job knows its pid
+    block_child_signal(&old_mask);
+    Job *job = job_create(&argv, 1);
+    const Builtin *builtin = find_builtin(argv);
+    job->launched[0] = trace_start();
+    job->pids[0] = builtin != NULL ? launch_builtin(builtin, argv, &plan) : launch_command(argv, &plan);
+    trace_span("spawn", job->launched[0], argv[0], 0);
+    if (job->pids[0] == -1)
+    {
+        fprintf(stderr, "parallel: %s: %s\n", argv[0], strerror(errno));
+        job->statuses[0] = launch_failure_status(errno);
+    }
+    else
+        job->running = 1;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    task->job = job;
+}
+
+// Writes what a task printed to standard output in one piece, with sendfile(2) where the output allows it
+static void task_print(ParallelTask *task)
+{
+    struct stat st;
+    off_t offset = 0;
+    char buffer[PARALLEL_READ_CHUNK];
+
+    if (task->output == -1)
+        return;
+    if (fstat(task->output, &st) == 0)
+    {
+        while (offset < st.st_size)
+        {
+            ssize_t sent = sendfile(STDOUT_FILENO, task->output, &offset, st.st_size - offset);
+            if (sent == -1 && errno == EINTR && !interrupted)
+                continue;
+            if (sent > 0)
+                continue;
+
+            // Some outputs refuse sendfile(2), appending files among them; copy the rest instead
+            ssize_t n;
+            while ((n = pread(task->output, buffer, sizeof(buffer), offset)) > 0 &&
+                   write_all(STDOUT_FILENO, buffer, n) == 0)
+                offset += n;
+            break;
+        }
+    }
+    close(task->output);
+    task->output = -1;
+}
+
+// parallel [-j N] [-k] [-u] command [word...] [::: arg...]: runs command once per argument, taken from the
+// words after ::: or from the lines of standard input, with at most N (the CPU count by default) running at
+// once and a new one started as soon as one finishes. {} in the command stands for the argument, otherwise
+// it is added at the end. Each command's output is printed in one piece when it finishes, in argument order
+// with -k, or straight away as it comes with -u. The status is the number of commands that failed, up to 101
+void parallel_builtin(char **argv)
+{
+    long slots = sysconf(_SC_NPROCESSORS_ONLN);
+    int keep_order = 0;
+    int grouped = 1;
+    int i = 1;
+
+    for (; argv[i] != NULL && argv[i][0] == '-' && argv[i][1] != '\0'; i++)
+    {
+        if (strcmp(argv[i], "-k") == 0)
+            keep_order = 1;
+        else if (strcmp(argv[i], "-u") == 0)
+            grouped = 0;
+        else if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            const char *value = argv[i][2] != '\0' ? argv[i] + 2 : argv[i + 1];
+            char *end;
+            slots = value != NULL ? strtol(value, &end, 10) : 0;
+            if (value == NULL || *end != '\0' || slots < 1)
+            {
+                fprintf(stderr, "parallel: -j: invalid job count '%s'\n", value != NULL ? value : "");
+                last_exit_status = 2;
+                return;
+            }
+            if (argv[i][2] == '\0')
+                i++;
+        }
+        else
+            break;
+    }
+
+    char **template = argv + i;
+    int template_count = 0;
+    while (template[template_count] != NULL && strcmp(template[template_count], ":::") != 0)
+        template_count++;
+    if (template_count == 0)
+    {
+        fprintf(stderr, "parallel: usage: parallel [-j N] [-k] [-u] command [word...] [::: arg...]\n");
+        last_exit_status = 2;
+        return;
+    }
+
+    char **args;
+    int count = 0;
+    if (template[template_count] != NULL)
+    {
+        args = template + template_count + 1;
+        while (args[count] != NULL)
+            count++;
+    }
+    else
+        args = read_arguments(&count);
+
+    if (slots < 1)
+        slots = 1;
+    if (slots > count)
+        slots = count;
+
+    ParallelTask *tasks = arena_alloc(&line_arena, (count + 1) * sizeof(ParallelTask));
+    Job **running = arena_alloc(&line_arena, (slots + 1) * sizeof(Job *));
+    int *running_task = arena_alloc(&line_arena, (slots + 1) * sizeof(int));
+    int running_count = 0;
+    int started = 0;
+    int printed = 0;
+    int failed = 0;
+
+    fflush(stdout);
+    while (1)
+    {
+        // Fill every free slot; Control-C stops new commands from starting and the wait for the running ones
+        while (running_count < slots && started < count && !interrupted)
+        {
+            task_start(&tasks[started], task_argv(template, template_count, args[started]), grouped);
+            running[running_count] = tasks[started].job;
+            running_task[running_count++] = started++;
+        }
+        if (running_count == 0)
+            break;
+
+        Job *job = job_wait_any(running, running_count);
+        if (job == NULL)
+        {
+            // Control-C: commands that survived it are left to finish as background jobs, unprinted
+            for (int r = 0; r < running_count; r++)
+            {
+                running[r]->background = 1;
+                if (tasks[running_task[r]].output != -1)
+                    close(tasks[running_task[r]].output);
+            }
+            last_exit_status = 128 + SIGINT;
+            return;
+        }
+        int slot = 0;
+        while (running[slot] != job)
+            slot++;
+        ParallelTask *task = &tasks[running_task[slot]];
+        running[slot] = running[running_count - 1];
+        running_task[slot] = running_task[--running_count];
+
+        if (status_to_exit_code(job->statuses[0]) != 0)
+            failed++;
+        job_remove(job);
+        task->done = 1;
+
+        if (!keep_order)
+            task_print(task);
+        while (keep_order && printed < started && tasks[printed].done)
+            task_print(&tasks[printed++]);
+    }
+
+    last_exit_status = failed < PARALLEL_MAX_FAILURES ? failed : PARALLEL_MAX_FAILURES;
+}
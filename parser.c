@@ -0,0 +1,418 @@
+#include "myshell.h"
+
+// State of one parse over the tokens of a complete command
+typedef struct
+{
+    char *buf;        // writable copy of the text that words are unquoted into
+    const char *line; // the text as typed, for keyword checks
+    const Token *tokens;
+    int count;
+    int pos;
+    int status;
+} Parser;
+
+// Keywords that can only follow the start of a compound command
+static const char *const closing_words[] = {"then", "elif", "else", "fi", "do", "done", "}", NULL};
+
+static Node *parse_list(Parser *p, const char *const *terms);
+
+// Returns 1 when token is one of the unquoted keywords in the NULL-terminated words
+static int token_in(const char *line, const Token *token, const char *const *words)
+{
+    for (int i = 0; words[i] != NULL; i++)
+    {
+        if (token_is(line, token, words[i]))
+            return 1;
+    }
+    return 0;
+}
+
+// Returns 1 when the current token is the unquoted keyword word
+static int at_word(Parser *p, const char *word)
+{
+    return p->pos < p->count && token_is(p->line, &p->tokens[p->pos], word);
+}
+
+// Returns 1 when the current token is one of the keywords in words
+static int at_any(Parser *p, const char *const *words)
+{
+    return p->pos < p->count && token_in(p->line, &p->tokens[p->pos], words);
+}
+
+// Returns the length of a function name at the start of a token's text: a letter or '_', then letters,
+// digits, '_', '-' or '.'; 0 when it does not start with one
+static int function_name_length(const char *text, int length)
+{
+    int i = 0;
+    if (length == 0 || !(isalpha((unsigned char)text[0]) || text[0] == '_'))
+        return 0;
+    while (i < length && (isalnum((unsigned char)text[i]) || strchr("_-.", text[i]) != NULL))
+        i++;
+    return i;
+}
+
+// Returns how many tokens the function header "name()" or "name ()" at tokens[i] takes, 0 when there is none,
+// storing the length of the name in name_length
+static int function_header(const char *line, const Token *tokens, int count, int i, int *name_length)
+{
+    const Token *token = &tokens[i];
+    if (token->type != TOK_WORD || token->quoted || token->expand)
+        return 0;
+
+    const char *text = line + token->offset;
+    int length = function_name_length(text, token->length);
+    if (length > 0 && length == token->length - 2 && strncmp(text + length, "()", 2) == 0)
+    {
+        *name_length = length;
+        return 1;
+    }
+    if (length > 0 && length == token->length && i + 1 < count && token_is(line, &tokens[i + 1], "()"))
+    {
+        *name_length = length;
+        return 2;
+    }
+    return 0;
+}
+
+// Allocates an empty node of the given type in the line arena
+static Node *new_node(int type)
+{
+    Node *node = arena_alloc(&line_arena, sizeof(Node));
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    return node;
+}
+
+// Reports a syntax error at the current token, or marks the command incomplete when the input ran out
+static void parse_fail(Parser *p, const char *expected)
+{
+    if (p->status != PARSE_OK)
+        return;
+    if (p->pos >= p->count)
+    {
+        p->status = PARSE_INCOMPLETE;
+        return;
+    }
+
+    const Token *token = &p->tokens[p->pos];
+    if (p->line[token->offset] == '\n')
+        fprintf(stderr, "Syntax error near newline");
+    else
+        fprintf(stderr, "Syntax error near '%.*s'", token->length, p->line + token->offset);
+    if (expected != NULL)
+        fprintf(stderr, ", expected '%s'", expected);
+    fprintf(stderr, "\n");
+    p->status = PARSE_ERROR;
+}
+
+// Consumes the keyword word, or fails when something else comes next
+static int expect_word(Parser *p, const char *word)
+{
+    if (p->status != PARSE_OK)
+        return 0;
+    if (at_word(p, word))
+    {
+        p->pos++;
+        return 1;
+    }
+    parse_fail(p, word);
+    return 0;
+}
+
+// Skips ';' and newline separators
+static void skip_separators(Parser *p)
+{
+    while (p->pos < p->count && p->tokens[p->pos].type == TOK_SEMI)
+        p->pos++;
+}
+
+// Checks that a compound command is followed by a separator, the end of input or an enclosing keyword
+static void end_compound(Parser *p, const char *const *terms)
+{
+    if (p->status != PARSE_OK || p->pos >= p->count || at_any(p, terms))
+        return;
+    if (p->tokens[p->pos].type == TOK_SEMI)
+    {
+        p->pos++;
+        return;
+    }
+    parse_fail(p, NULL);
+}
+
+// Parses a non-empty list up to one of the keywords in terms, which must follow before the input ends
+static Node *parse_body(Parser *p, const char *const *terms)
+{
+    Node *list = parse_list(p, terms);
+    if (p->status == PARSE_OK && list == NULL)
+        parse_fail(p, NULL);
+    return list;
+}
+
+// Parses one pipeline into argv rows and redirections, consuming the ';' or '&' that ends it
+static Node *parse_pipeline(Parser *p)
+{
+    Node *node = new_node(NODE_PIPELINE);
+    node->argv = arena_alloc(&line_arena, MAX_ARG_COUNT * sizeof(char **));
+    node->argc = arena_alloc(&line_arena, MAX_ARG_COUNT * sizeof(int));
+    node->redirects = arena_alloc(&line_arena, MAX_ARG_COUNT * sizeof(Redirect *));
+    int used = parse_tokens(p->buf, p->tokens + p->pos, p->count - p->pos, node->argv, node->argc, node->redirects,
+                            &node->argv_count, &node->background);
+    if (used == -1)
+    {
+        p->status = PARSE_ERROR;
+        return NULL;
+    }
+    p->pos += used;
+    return node;
+}
+
+// Parses the rest of an if (or elif) command after its keyword; an elif becomes a nested if in the else branch
+static Node *parse_if(Parser *p, const char *const *terms)
+{
+    static const char *const then_words[] = {"then", NULL};
+    static const char *const branch_words[] = {"elif", "else", "fi", NULL};
+    static const char *const fi_words[] = {"fi", NULL};
+    Node *node = new_node(NODE_IF);
+
+    node->cond = parse_body(p, then_words);
+    if (!expect_word(p, "then"))
+        return NULL;
+    node->body = parse_body(p, branch_words);
+    if (p->status != PARSE_OK)
+        return NULL;
+
+    if (at_word(p, "elif"))
+    {
+        // The nested if consumes the shared 'fi'
+        p->pos++;
+        node->else_part = parse_if(p, terms);
+        return node->else_part != NULL ? node : NULL;
+    }
+    if (at_word(p, "else"))
+    {
+        p->pos++;
+        node->else_part = parse_body(p, fi_words);
+    }
+    if (!expect_word(p, "fi"))
+        return NULL;
+    end_compound(p, terms);
+    return node;
+}
+
+// Parses the rest of a while or until loop after its keyword
+static Node *parse_loop(Parser *p, int type, const char *const *terms)
+{
+    static const char *const do_words[] = {"do", NULL};
+    static const char *const done_words[] = {"done", NULL};
+    Node *node = new_node(type);
+
+    node->cond = parse_body(p, do_words);
+    if (!expect_word(p, "do"))
+        return NULL;
+    node->body = parse_body(p, done_words);
+    if (!expect_word(p, "done"))
+        return NULL;
+    end_compound(p, terms);
+    return node;
+}
+
+// Parses the rest of a for loop after its keyword: NAME [in WORDS...] ; do LIST done
+static Node *parse_for(Parser *p, const char *const *terms)
+{
+    static const char *const done_words[] = {"done", NULL};
+    Node *node = new_node(NODE_FOR);
+
+    if (p->pos >= p->count || p->tokens[p->pos].type != TOK_WORD)
+    {
+        parse_fail(p, NULL);
+        return NULL;
+    }
+    const Token *name = &p->tokens[p->pos++];
+    node->name = arena_alloc(&line_arena, name->length + 2);
+    snprintf(node->name, name->length + 2, "$%s", token_text(p->buf, name));
+
+    if (at_word(p, "in"))
+    {
+        // The words run up to the next separator; without 'in' the loop walks the positional parameters
+        p->pos++;
+        int start = p->pos;
+        while (p->pos < p->count && p->tokens[p->pos].type == TOK_WORD)
+            p->pos++;
+        if (p->pos >= p->count || p->tokens[p->pos].type != TOK_SEMI)
+        {
+            parse_fail(p, NULL);
+            return NULL;
+        }
+
+        node->word_count = p->pos - start;
+        node->words = arena_alloc(&line_arena, (node->word_count + 1) * sizeof(char *));
+        for (int i = 0; i < node->word_count; i++)
+            node->words[i] = token_word(p->buf, &p->tokens[start + i]);
+        node->words[node->word_count] = NULL;
+    }
+
+    skip_separators(p);
+    if (!expect_word(p, "do"))
+        return NULL;
+    node->body = parse_body(p, done_words);
+    if (!expect_word(p, "done"))
+        return NULL;
+    end_compound(p, terms);
+    return node;
+}
+
+// Parses the rest of a { list; } group after its opening brace
+static Node *parse_group(Parser *p, const char *const *terms)
+{
+    static const char *const brace_words[] = {"}", NULL};
+    Node *node = new_node(NODE_GROUP);
+
+    node->body = parse_body(p, brace_words);
+    if (!expect_word(p, "}"))
+        return NULL;
+    end_compound(p, terms);
+    return node;
+}
+
+// Parses a function definition, name() { list; }, whose header takes header tokens; the body may start on
+// a later line
+static Node *parse_function(Parser *p, int header, int name_length, const char *const *terms)
+{
+    Node *node = new_node(NODE_FUNCTION);
+
+    node->name = arena_strndup(&line_arena, p->line + p->tokens[p->pos].offset, name_length);
+    p->pos += header;
+    skip_separators(p);
+    if (!expect_word(p, "{"))
+        return NULL;
+    Node *group = parse_group(p, terms);
+    if (group == NULL)
+        return NULL;
+    node->body = group->body;
+    return node;
+}
+
+// Parses one command: a compound command when it starts with a keyword or is a function definition, a
+// pipeline otherwise. A leading time keyword marks the command to be timed
+static Node *parse_list_item(Parser *p, const char *const *terms)
+{
+    int name_length;
+    int header = p->pos < p->count ? function_header(p->line, p->tokens, p->count, p->pos, &name_length) : 0;
+
+    if (header > 0)
+        return parse_function(p, header, name_length, terms);
+    if (at_word(p, "{"))
+    {
+        p->pos++;
+        return parse_group(p, terms);
+    }
+    if (at_word(p, "time"))
+    {
+        p->pos++;
+        Node *node = parse_list_item(p, terms);
+        if (node != NULL)
+            node->timed = 1;
+        return node;
+    }
+    if (at_word(p, "if"))
+    {
+        p->pos++;
+        return parse_if(p, terms);
+    }
+    if (at_word(p, "while") || at_word(p, "until"))
+    {
+        int type = at_word(p, "while") ? NODE_WHILE : NODE_UNTIL;
+        p->pos++;
+        return parse_loop(p, type, terms);
+    }
+    if (at_word(p, "for"))
+    {
+        p->pos++;
+        return parse_for(p, terms);
+    }
+    return parse_pipeline(p);
+}
+
+// Parses commands up to the end of input or one of the keywords in terms, which is left for the caller
+static Node *parse_list(Parser *p, const char *const *terms)
+{
+    Node *head = NULL;
+    Node **tail = &head;
+
+    while (p->status == PARSE_OK)
+    {
+        skip_separators(p);
+        if (p->pos >= p->count || at_any(p, terms))
+            break;
+        if (at_any(p, closing_words))
+        {
+            // A keyword no open command is waiting for
+            parse_fail(p, NULL);
+            break;
+        }
+
+        Node *node = parse_list_item(p, terms);
+        if (node == NULL)
+            break;
+        if (node->type == NODE_PIPELINE && node->argv_count == 0 && !node->timed)
+            continue;
+        *tail = node;
+        tail = &node->next;
+    }
+    return head;
+}
+
+// Parses the tokens of a complete command into a tree in the line arena; words are unquoted into buf
+// Returns PARSE_OK, PARSE_INCOMPLETE when a compound command is still open at the end, or PARSE_ERROR
+int parse_program(char *buf, const char *line, const Token *tokens, int count, Node **tree)
+{
+    static const char *const no_words[] = {NULL};
+    Parser p = {buf, line, tokens, count, 0, PARSE_OK};
+
+    *tree = parse_list(&p, no_words);
+    return p.status;
+}
+
+// Counts how many compound commands a line opens (positive) or closes (negative), looking only at
+// keywords in command position; lets a block typed over several lines be parsed once, when it is complete
+// A function header keeps the command position for the brace opening its body
+int block_depth(const char *line, const Token *tokens, int count)
+{
+    static const char *const openers[] = {"if", "while", "until", "{", NULL};
+    static const char *const closers[] = {"fi", "done", "}", NULL};
+    int name_length;
+    int depth = 0;
+    int command_start = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        const Token *token = &tokens[i];
+        if (token->type != TOK_WORD)
+        {
+            // After a redirection operator comes a file name, not a command
+            command_start = token->type == TOK_SEMI || token->type == TOK_PIPE || token->type == TOK_AMP;
+            continue;
+        }
+        if (!command_start)
+            continue;
+
+        int header = function_header(line, tokens, count, i, &name_length);
+        if (header > 0)
+            i += header - 1;
+        else if (token_in(line, token, openers))
+            depth++;
+        else if (token_is(line, token, "for"))
+        {
+            depth++;
+            command_start = 0;
+        }
+        else if (token_in(line, token, closers))
+        {
+            depth--;
+            command_start = 0;
+        }
+        else if (!token_in(line, token, closing_words) && !token_is(line, token, "time"))
+            command_start = 0;
+    }
+    return depth;
+}
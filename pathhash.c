@@ -0,0 +1,232 @@
+#include "myshell.h"
+
+#include <limits.h>
+#include <time.h>
+
+#define HASH_BUCKETS 128
+#define HASH_NEGATIVE_TTL 2 // seconds a "command not found" answer is trusted
+
+// One remembered PATH search result, path is NULL for a command that was not found
+typedef struct HashEntry
+{
+    char *name;
+    char *path;
+    int hits;
+    time_t checked;
+    struct HashEntry *next;
+} HashEntry;
+
+static HashEntry *hash_table[HASH_BUCKETS];
+static char *hashed_path_env = NULL;
+
+// Bucket of a command name
+static unsigned int hash_name(const char *name)
+{
+    return hash_bytes(name, strlen(name)) % HASH_BUCKETS;
+}
+
+// Frees every entry of the table
+void hash_clear()
+{
+    for (int i = 0; i < HASH_BUCKETS; i++)
+    {
+        HashEntry *entry = hash_table[i];
+        while (entry != NULL)
+        {
+            HashEntry *next = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+        hash_table[i] = NULL;
+    }
+}
+
+// Flushes the table when PATH differs from the one the entries were resolved against
+static void hash_check_path_env()
+{
+    const char *path_env = getenv("PATH");
+    if (path_env == NULL)
+        path_env = "";
+
+    if (hashed_path_env != NULL && strcmp(hashed_path_env, path_env) == 0)
+        return;
+
+    hash_clear();
+    free(hashed_path_env);
+    hashed_path_env = strdup(path_env);
+}
+
+// Returns 1 when path names an executable regular file
+static int is_executable(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+// Walks PATH for name, returning a malloc'd full path or NULL when it is not found
+static char *search_path(const char *name)
+{
+    const char *dir = getenv("PATH");
+    char candidate[PATH_MAX];
+
+    if (dir == NULL)
+        dir = "/bin:/usr/bin";
+
+    while (1)
+    {
+        const char *end = strchr(dir, ':');
+        int len = end != NULL ? (int)(end - dir) : (int)strlen(dir);
+
+        // An empty PATH component means the current directory
+        if (len == 0)
+            snprintf(candidate, sizeof(candidate), "./%s", name);
+        else
+            snprintf(candidate, sizeof(candidate), "%.*s/%s", len, dir, name);
+
+        if (is_executable(candidate))
+            return strdup(candidate);
+
+        if (end == NULL)
+            return NULL;
+        dir = end + 1;
+    }
+}
+
+// Finds the entry for name, or NULL
+static HashEntry *hash_find(const char *name, HashEntry ***link_out)
+{
+    HashEntry **link = &hash_table[hash_name(name)];
+    while (*link != NULL)
+    {
+        if (strcmp((*link)->name, name) == 0)
+        {
+            if (link_out != NULL)
+                *link_out = link;
+            return *link;
+        }
+        link = &(*link)->next;
+    }
+    return NULL;
+}
+
+// Forgets the cached result for name, returns 0 if it was present and -1 otherwise
+int hash_forget(const char *name)
+{
+    HashEntry **link;
+    HashEntry *entry = hash_find(name, &link);
+    if (entry == NULL)
+        return -1;
+
+    *link = entry->next;
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+    return 0;
+}
+
+// Searches PATH for name and remembers the answer, found or not
+static HashEntry *hash_insert(const char *name)
+{
+    HashEntry *entry = malloc(sizeof(HashEntry));
+    if (entry == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int bucket = hash_name(name);
+    entry->name = strdup(name);
+    entry->path = search_path(name);
+    entry->hits = 0;
+    entry->checked = time(NULL);
+    entry->next = hash_table[bucket];
+    hash_table[bucket] = entry;
+    return entry;
+}
+
+// Resolves a command name to the executable that will run, consulting the table first
+// Names containing a slash are used as given; returns NULL when the command cannot be found
+const char *hash_lookup(const char *name)
+{
+    if (strchr(name, '/') != NULL)
+        return name;
+
+    hash_check_path_env();
+
+    HashEntry *entry = hash_find(name, NULL);
+    if (entry != NULL)
+    {
+        // A negative answer is only trusted for a short while, a positive one while the file is still there
+        int stale = entry->path == NULL ? time(NULL) - entry->checked > HASH_NEGATIVE_TTL
+                                        : access(entry->path, X_OK) != 0;
+        if (stale)
+        {
+            hash_forget(name);
+            entry = NULL;
+        }
+    }
+
+    if (entry == NULL)
+        entry = hash_insert(name);
+
+    entry->hits++;
+    return entry->path;
+}
+
+// Implements the hash builtin: no arguments lists the table, -r empties it, -d forgets names, other names are hashed
+void hash_builtin(char **argv)
+{
+    hash_check_path_env();
+
+    if (argv[1] == NULL)
+    {
+        int empty = 1;
+        for (int i = 0; i < HASH_BUCKETS; i++)
+        {
+            for (HashEntry *entry = hash_table[i]; entry != NULL; entry = entry->next)
+            {
+                if (empty)
+                    printf("hits\tcommand\n");
+                empty = 0;
+                if (entry->path != NULL)
+                    printf("%4d\t%s\n", entry->hits, entry->path);
+                else
+                    printf("%4d\t%s: not found\n", entry->hits, entry->name);
+            }
+        }
+        if (empty)
+            printf("hash: hash table empty\n");
+        return;
+    }
+
+    if (strcmp(argv[1], "-r") == 0)
+    {
+        hash_clear();
+        return;
+    }
+
+    if (strcmp(argv[1], "-d") == 0)
+    {
+        for (int i = 2; argv[i] != NULL; i++)
+        {
+            if (hash_forget(argv[i]) != 0)
+            {
+                fprintf(stderr, "hash: %s: not found\n", argv[i]);
+                last_exit_status = 1;
+            }
+        }
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        hash_forget(argv[i]);
+        if (hash_insert(argv[i])->path == NULL)
+        {
+            fprintf(stderr, "hash: %s: not found\n", argv[i]);
+            last_exit_status = 1;
+        }
+    }
+}
@@ -0,0 +1,265 @@
+#include "myshell.h"
+
+#include <stddef.h>
+
+#define SNAPSHOT_MAGIC "MYSHSNP1"
+#define SNAPSHOT_SUFFIX ".snapshot"
+#define SNAPSHOT_INITIAL_CAPACITY 4096
+
+extern char **environ;
+
+// What a snapshot was taken from: the rc file as it was then and the environment it ran in
+typedef struct
+{
+    char magic[8];
+    long long rc_mtime_sec;
+    long long rc_mtime_nsec;
+    long long rc_size;
+    unsigned long long rc_inode;
+    unsigned long long env_hash;
+    unsigned int record_count;
+    unsigned int data_size;
+} SnapshotHeader;
+
+// Builtins that only set shell state, so running them again from a snapshot gives the same shell
+static const char *const snapshot_builtins[] = {"=", "export", "unset", "set", "prompt", "alias", "unalias", NULL};
+
+// Set while the rc file runs; a command that is not a state-setting builtin clears snapshot_safe
+int rc_recording = 0;
+static int snapshot_safe = 0;
+
+// The recorded builtin commands: for each, its word count and its NUL-terminated words
+static char *snapshot_data = NULL;
+static size_t snapshot_len = 0;
+static size_t snapshot_capacity = 0;
+static unsigned int snapshot_records = 0;
+
+// FNV-1a hash of the environment, which the rc's expansions may have read
+static unsigned long long environment_hash()
+{
+    unsigned long long h = 14695981039346656037ull;
+    for (char **env = environ; *env != NULL; env++)
+    {
+        for (const char *p = *env; *p != '\0'; p++)
+        {
+            h ^= (unsigned char)*p;
+            h *= 1099511628211ull;
+        }
+        h ^= '\n';
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Appends len bytes to the recorded commands
+static void snapshot_append(const void *data, size_t len)
+{
+    if (snapshot_len + len > snapshot_capacity)
+    {
+        size_t capacity = snapshot_capacity == 0 ? SNAPSHOT_INITIAL_CAPACITY : snapshot_capacity * 2;
+        while (capacity < snapshot_len + len)
+            capacity *= 2;
+        char *grown = realloc(snapshot_data, capacity);
+        if (grown == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        snapshot_data = grown;
+        snapshot_capacity = capacity;
+    }
+    memcpy(snapshot_data + snapshot_len, data, len);
+    snapshot_len += len;
+}
+
+// Notes a command run by the rc file: a state-setting builtin is recorded, already expanded, for the
+// snapshot; anything else (builtin NULL for processes, pipelines and substitutions) rules the snapshot out
+void rc_record(const Builtin *builtin, char **argv)
+{
+    int allowed = 0;
+    for (int i = 0; builtin != NULL && snapshot_builtins[i] != NULL; i++)
+        allowed |= strcmp(builtin->name, snapshot_builtins[i]) == 0;
+    if (!allowed)
+    {
+        snapshot_safe = 0;
+        return;
+    }
+
+    unsigned int count = 0;
+    while (argv[count] != NULL)
+        count++;
+    snapshot_append(&count, sizeof(count));
+    for (unsigned int i = 0; i < count; i++)
+        snapshot_append(argv[i], strlen(argv[i]) + 1);
+    snapshot_records++;
+}
+
+// Fills header with what identifies the rc file and the environment
+static void snapshot_header(SnapshotHeader *header, const struct stat *st, unsigned long long env_hash)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->rc_mtime_sec = st->st_mtim.tv_sec;
+    header->rc_mtime_nsec = st->st_mtim.tv_nsec;
+    header->rc_size = st->st_size;
+    header->rc_inode = st->st_ino;
+    header->env_hash = env_hash;
+}
+
+// Replays a snapshot still matching the rc file and the environment, running its recorded builtins
+// without lexing, parsing or expanding anything. Returns 0 when replayed, -1 when it is missing or stale
+static int snapshot_replay(const char *path, const SnapshotHeader *expected)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+        return -1;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t size = st.st_size - sizeof(header);
+    if (memcmp(&header, expected, offsetof(SnapshotHeader, record_count)) != 0 || header.data_size != size)
+    {
+        munmap(data, st.st_size);
+        return -1;
+    }
+
+    // Every record is checked to lie inside the file before anything runs
+    const char *p = data + sizeof(header);
+    const char *end = data + st.st_size;
+    for (unsigned int r = 0; r < header.record_count && p != NULL; r++)
+    {
+        unsigned int count;
+        if ((size_t)(end - p) < sizeof(count))
+        {
+            p = NULL;
+            break;
+        }
+        memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        for (unsigned int i = 0; i < count && p != NULL; i++)
+        {
+            const char *nul = memchr(p, '\0', end - p);
+            p = nul != NULL ? nul + 1 : NULL;
+        }
+    }
+    if (p != end)
+    {
+        munmap(data, st.st_size);
+        return -1;
+    }
+
+    p = data + sizeof(header);
+    for (unsigned int r = 0; r < header.record_count; r++)
+    {
+        unsigned int count;
+        memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        char **argv = arena_alloc(&line_arena, (count + 1) * sizeof(char *));
+        for (unsigned int i = 0; i < count; i++)
+        {
+            argv[i] = arena_strdup(&line_arena, p);
+            p += strlen(p) + 1;
+        }
+        argv[count] = NULL;
+
+        const Builtin *builtin = find_builtin(argv);
+        if (builtin != NULL)
+        {
+            LaunchPlan plan;
+            launch_plan_init(&plan, -1);
+            run_builtin(builtin, argv, &plan);
+        }
+    }
+    arena_reset(&line_arena);
+    munmap(data, st.st_size);
+    return 0;
+}
+
+// Writes the recorded builtins next to the rc file, through a temporary file renamed into place so a
+// concurrent shell never reads half a snapshot
+static void snapshot_write(const char *path, SnapshotHeader *header)
+{
+    char temp[PATH_MAX];
+
+    header->record_count = snapshot_records;
+    header->data_size = snapshot_len;
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return;
+    int failed = write_all(fd, (const char *)header, sizeof(*header)) == -1 ||
+                 write_all(fd, snapshot_data, snapshot_len) == -1;
+    close(fd);
+    if (failed || rename(temp, path) == -1)
+        unlink(temp);
+}
+
+// Runs ~/.myshellrc ($MYSHELLRC when set, empty for none) in an interactive shell. A snapshot of an rc file
+// that only sets variables and options is replayed instead while the file's mtime, size and inode and the
+// environment are unchanged; otherwise the file runs and, when it turns out to set state only, a new snapshot
+// is saved. An rc reading $$ or $! gets no snapshot, those differ in every shell
+void rc_load()
+{
+    char rc_path[PATH_MAX];
+    char snapshot_path[PATH_MAX + sizeof(SNAPSHOT_SUFFIX)];
+    const char *configured = getenv("MYSHELLRC");
+    const char *home = getenv("HOME");
+    struct stat st;
+    SnapshotHeader header;
+
+    if (configured != NULL)
+        snprintf(rc_path, sizeof(rc_path), "%s", configured);
+    else if (home != NULL)
+        snprintf(rc_path, sizeof(rc_path), "%s/.myshellrc", home);
+    else
+        return;
+    if (rc_path[0] == '\0' || stat(rc_path, &st) == -1 || !S_ISREG(st.st_mode))
+        return;
+
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s%s", rc_path, SNAPSHOT_SUFFIX);
+    snapshot_header(&header, &st, environment_hash());
+    if (snapshot_replay(snapshot_path, &header) == 0)
+        return;
+
+    int fd = open(rc_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        perror(rc_path);
+        return;
+    }
+    char *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror(rc_path);
+        return;
+    }
+
+    snapshot_safe = memmem(data, st.st_size, "$$", 2) == NULL && memmem(data, st.st_size, "$!", 2) == NULL;
+    snapshot_len = 0;
+    snapshot_records = 0;
+    rc_recording = 1;
+    if (data != NULL)
+        run_script_buffer(data, st.st_size);
+    end_of_input();
+    rc_recording = 0;
+
+    if (snapshot_safe && !interrupted)
+        snapshot_write(snapshot_path, &header);
+    free(snapshot_data);
+    snapshot_data = NULL;
+    snapshot_capacity = 0;
+    if (data != NULL)
+        munmap(data, st.st_size);
+}
@@ -0,0 +1,166 @@
+#include "myshell.h"
+
+// Writes all of data to fd, returns -1 on failure
+int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+// Returns a descriptor reading back data without touching the filesystem: a pipe already holding it when
+// it fits the pipe whole, otherwise an in-memory file rewound to its start. Returns -1 after reporting a failure
+static int here_document_fd(const char *data, size_t len)
+{
+    int fildes[2];
+
+    if (len <= PIPE_BUF)
+    {
+        // Written in one go before anything reads, so it must never have to wait for a reader
+        if (pipe2(fildes, O_CLOEXEC) == -1)
+        {
+            perror("pipe");
+            return -1;
+        }
+        if (write_all(fildes[1], data, len) == -1)
+        {
+            perror("here-document");
+            close(fildes[0]);
+            fildes[0] = -1;
+        }
+        close(fildes[1]);
+        return fildes[0];
+    }
+
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        perror("memfd_create");
+        return -1;
+    }
+    if (write_all(fd, data, len) == -1 || lseek(fd, 0, SEEK_SET) == -1)
+    {
+        perror("here-document");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Produces the text a here-document or here-string feeds its command, expanding it first when the
+// parser marked it; a here-string gets a newline added. Returns NULL after reporting an error
+static char *here_text(const Redirect *redirect, size_t *len)
+{
+    const char *word = redirect->word;
+    char *text;
+
+    if (redirect->type == REDIR_HEREDOC)
+    {
+        text = word[0] == EXPAND_MARK ? expand_here_document(word + 1) : (char *)word;
+        if (text != NULL)
+            *len = strlen(text);
+        return text;
+    }
+
+    const char *value = word[0] == EXPAND_MARK ? expand_word(word + 1) : word;
+    if (value == NULL)
+        return NULL;
+    *len = strlen(value) + 1;
+    text = arena_alloc(&line_arena, *len + 1);
+    memcpy(text, value, *len - 1);
+    text[*len - 1] = '\n';
+    text[*len] = '\0';
+    return text;
+}
+
+// Opens the file or here-document a redirection reads from or writes to, returning a close-on-exec
+// descriptor, or -1 after reporting a failure
+static int redirect_open(const Redirect *redirect)
+{
+    size_t len = 0;
+    const char *text;
+
+    if (redirect->type != REDIR_FILE)
+    {
+        text = here_text(redirect, &len);
+        return text != NULL ? here_document_fd(text, len) : -1;
+    }
+
+    const char *path = redirect->word[0] == EXPAND_MARK ? expand_word(redirect->word + 1) : redirect->word;
+    if (path == NULL)
+        return -1;
+    int fd = open(path, redirect->flags | O_CLOEXEC, 0660);
+    if (fd == -1)
+        perror(path);
+    return fd;
+}
+
+// Adds a stage's redirections to its plan in order, after its pipes so they take precedence over them
+// Files and here-documents are opened here, in the shell, so a failure is reported before anything runs;
+// their descriptors are stored in *fds, in the line arena, for the caller to close once the stage has its own
+// copies. Returns -1 after reporting a failure, with the descriptors opened so far already closed
+int plan_redirects(LaunchPlan *plan, const Redirect *redirect, int **fds, int *fd_count)
+{
+    int count = 0;
+    for (const Redirect *r = redirect; r != NULL; r = r->next)
+        count++;
+    *fds = count > 0 ? arena_alloc(&line_arena, count * sizeof(int)) : NULL;
+    *fd_count = 0;
+
+    for (; redirect != NULL; redirect = redirect->next)
+    {
+        int failed = 0;
+        if (redirect->type == REDIR_DUP)
+        {
+            int src_fd = redirect->src_fd;
+            if (redirect->word[0] == EXPAND_MARK)
+            {
+                const char *word = expand_word(redirect->word + 1);
+                src_fd = word != NULL ? redirect_source(word) : -2;
+                if (word != NULL && src_fd == -2)
+                    fprintf(stderr, "%s: not a file descriptor\n", word);
+            }
+            if (src_fd == -2)
+                failed = 1;
+            else if (src_fd == -1)
+                launch_plan_close(plan, redirect->fd);
+            else
+                launch_plan_dup(plan, src_fd, redirect->fd);
+        }
+        else
+        {
+            int fd = redirect_open(redirect);
+            failed = fd == -1;
+            if (!failed)
+            {
+                (*fds)[(*fd_count)++] = fd;
+                launch_plan_dup(plan, fd, redirect->fd);
+            }
+        }
+
+        if (failed)
+        {
+            close_redirect_fds(*fds, *fd_count);
+            *fd_count = 0;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Closes the descriptors plan_redirects() opened for a stage
+void close_redirect_fds(const int *fds, int count)
+{
+    for (int i = 0; i < count; i++)
+        close(fds[i]);
+}
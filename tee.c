@@ -0,0 +1,181 @@
+#include "myshell.h"
+
+#define TEE_COPY_BUFFER 65536
+
+// Moves exactly len bytes from the pipe in to out with splice(2), returns -1 on failure
+static int splice_all(int in, int out, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t moved = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE);
+        if (moved == -1 && errno == EINTR && !interrupted)
+            continue;
+        if (moved <= 0)
+            return -1;
+        len -= moved;
+    }
+    return 0;
+}
+
+// Duplicates the data waiting in stdin into the pipe out, len bytes at most; returns the bytes duplicated,
+// 0 at end of input or -1 on failure
+static ssize_t tee_input(int out, size_t len)
+{
+    while (1)
+    {
+        ssize_t teed = tee(STDIN_FILENO, out, len, 0);
+        if (teed != -1 || errno != EINTR || interrupted)
+            return teed;
+    }
+}
+
+// Returns 1 when splice(2) can write to fd: a pipe, a regular file not opened for appending or /dev/null,
+// but not a terminal
+static int can_splice_to(int fd)
+{
+    struct stat st;
+    struct stat null_st;
+
+    if (fstat(fd, &st) == -1 || (fcntl(fd, F_GETFL) & O_APPEND))
+        return 0;
+    if (S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode))
+        return 1;
+    return S_ISCHR(st.st_mode) && stat("/dev/null", &null_st) == 0 && st.st_rdev == null_st.st_rdev;
+}
+
+// Copies stdin to stdout and the files without the data ever entering user space. Each round, tee(2)
+// duplicates what waits in the input pipe into stdout when it is a pipe (a scratch pipe otherwise), the files
+// but the last get their copy through the scratch pipe, and the last file consumes the input with splice(2)
+// Returns 1 when stdin is not a pipe, an output cannot be spliced to or the scratch pipe cannot hold all of
+// the input, before anything is copied; 0 when done, -1 on a failure
+static int tee_splice(const int *files, int count)
+{
+    int in_size = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+    int scratch[2];
+
+    if (in_size == -1 || !can_splice_to(STDOUT_FILENO))
+        return 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (!can_splice_to(files[i]))
+            return 1;
+    }
+    if (count == 0)
+    {
+        while (1)
+        {
+            ssize_t moved = splice(STDIN_FILENO, NULL, STDOUT_FILENO, NULL, in_size, SPLICE_F_MOVE);
+            if (moved == -1 && errno == EINTR && !interrupted)
+                continue;
+            if (moved <= 0)
+                return (int)moved;
+        }
+    }
+
+    // tee(2) cannot start partway into the input, so every copy of a round must go through in one call:
+    // the scratch pipe needs at least as many slots as the input pipe has
+    if (pipe2(scratch, O_CLOEXEC) == -1)
+        return -1;
+    if (fcntl(scratch[1], F_SETPIPE_SZ, in_size) < in_size)
+    {
+        close(scratch[0]);
+        close(scratch[1]);
+        return 1;
+    }
+
+    int out_is_pipe = fcntl(STDOUT_FILENO, F_GETPIPE_SZ) != -1;
+    int result = 0;
+    while (1)
+    {
+        ssize_t n = tee_input(out_is_pipe ? STDOUT_FILENO : scratch[1], in_size);
+        if (n <= 0)
+        {
+            result = (int)n;
+            break;
+        }
+        if (!out_is_pipe && splice_all(scratch[0], STDOUT_FILENO, n) == -1)
+        {
+            result = -1;
+            break;
+        }
+
+        for (int i = 0; i < count - 1 && result == 0; i++)
+        {
+            if (tee_input(scratch[1], n) != n || splice_all(scratch[0], files[i], n) == -1)
+                result = -1;
+        }
+        if (result == -1 || splice_all(STDIN_FILENO, files[count - 1], n) == -1)
+        {
+            result = -1;
+            break;
+        }
+    }
+
+    close(scratch[0]);
+    close(scratch[1]);
+    return result;
+}
+
+// Copies stdin to stdout and the files through a buffer, for input that is not a pipe; returns -1 on a failure
+static int tee_copy(const int *files, int count)
+{
+    char buffer[TEE_COPY_BUFFER];
+
+    while (1)
+    {
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (n == -1 && errno == EINTR && !interrupted)
+            continue;
+        if (n <= 0)
+            return (int)n;
+
+        if (write_all(STDOUT_FILENO, buffer, n) == -1)
+            return -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (write_all(files[i], buffer, n) == -1)
+                return -1;
+        }
+    }
+}
+
+// tee [-a] file...: copies stdin to stdout and to every file, appending to them with -a
+void tee_builtin(char **argv)
+{
+    int append = argv[1] != NULL && strcmp(argv[1], "-a") == 0;
+    char **names = argv + 1 + append;
+    int count = 0;
+
+    while (names[count] != NULL)
+        count++;
+    int *files = arena_alloc(&line_arena, (count + 1) * sizeof(int));
+
+    // splice(2) refuses files opened for appending, so -a seeks to the end instead
+    int opened = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int fd = open(names[i], O_WRONLY | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0660);
+        if (fd == -1 || (append && lseek(fd, 0, SEEK_END) == -1))
+        {
+            perror(names[i]);
+            last_exit_status = 1;
+            if (fd != -1)
+                close(fd);
+            continue;
+        }
+        files[opened++] = fd;
+    }
+
+    int result = tee_splice(files, opened);
+    if (result == 1)
+        result = tee_copy(files, opened);
+
+    // A reader that went away simply ends the copy, as SIGPIPE would have
+    if (result == -1 && !interrupted && errno != EPIPE)
+        perror("tee");
+    if (result == -1)
+        last_exit_status = 1;
+
+    for (int i = 0; i < opened; i++)
+        close(files[i]);
+}
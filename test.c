@@ -0,0 +1,294 @@
+#include "myshell.h"
+
+#include <fnmatch.h>
+#include <regex.h>
+
+// State of one evaluation of test, [ or [[ arguments
+typedef struct
+{
+    char **args;
+    int count;
+    int pos;
+    int extended; // [[ ]]: && || and pattern matching instead of -a -o
+    const char *error;
+} TestState;
+
+static int test_or(TestState *t);
+
+// Returns the current argument, or NULL past the end
+static const char *peek(TestState *t, int ahead)
+{
+    return t->pos + ahead < t->count ? t->args[t->pos + ahead] : NULL;
+}
+
+// Returns 1 when the current argument is word
+static int peek_is(TestState *t, int ahead, const char *word)
+{
+    const char *arg = peek(t, ahead);
+    return arg != NULL && strcmp(arg, word) == 0;
+}
+
+// Records the first error
+static int test_fail(TestState *t, const char *message)
+{
+    if (t->error == NULL)
+        t->error = message;
+    return 0;
+}
+
+// Parses an integer operand, failing on anything else
+static long test_integer(TestState *t, const char *arg)
+{
+    char *end;
+    while (isspace((unsigned char)*arg))
+        arg++;
+    long value = strtol(arg, &end, 10);
+    while (isspace((unsigned char)*end))
+        end++;
+    if (*arg == '\0' || *end != '\0')
+        test_fail(t, "integer expression expected");
+    return value;
+}
+
+// Returns 1 when op is a binary operator
+static int is_binary(const char *op, int extended)
+{
+    static const char *const ops[] = {"=",   "==",  "!=",  "<",   ">",   "-eq", "-ne", "-lt", "-le",
+                                      "-gt", "-ge", "-nt", "-ot", "-ef", "=~",  NULL};
+    for (int i = 0; ops[i] != NULL; i++)
+    {
+        if (strcmp(op, ops[i]) == 0)
+            return extended || strcmp(op, "=~") != 0;
+    }
+    return 0;
+}
+
+// Evaluates a unary file or string operator
+static int test_unary(TestState *t, const char *op, const char *arg)
+{
+    struct stat st;
+
+    switch (op[1])
+    {
+    case 'n':
+        return *arg != '\0';
+    case 'z':
+        return *arg == '\0';
+    case 't':
+        return isatty((int)test_integer(t, arg));
+    case 'L':
+    case 'h':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'r':
+        return access(arg, R_OK) == 0;
+    case 'w':
+        return access(arg, W_OK) == 0;
+    case 'x':
+        return access(arg, X_OK) == 0;
+    }
+
+    if (stat(arg, &st) != 0)
+        return 0;
+    switch (op[1])
+    {
+    case 'e':
+        return 1;
+    case 'f':
+        return S_ISREG(st.st_mode);
+    case 'd':
+        return S_ISDIR(st.st_mode);
+    case 's':
+        return st.st_size > 0;
+    case 'p':
+        return S_ISFIFO(st.st_mode);
+    case 'S':
+        return S_ISSOCK(st.st_mode);
+    case 'b':
+        return S_ISBLK(st.st_mode);
+    case 'c':
+        return S_ISCHR(st.st_mode);
+    case 'u':
+        return (st.st_mode & S_ISUID) != 0;
+    case 'g':
+        return (st.st_mode & S_ISGID) != 0;
+    case 'k':
+        return (st.st_mode & S_ISVTX) != 0;
+    }
+    return test_fail(t, "unknown unary operator");
+}
+
+// Returns 1 when op names a unary operator
+static int is_unary(const char *op)
+{
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("nztLhrwxefdspSbcugk", op[1]) != NULL;
+}
+
+// Compares two file modification times, a missing file being older than any other
+static int newer_than(const char *a, const char *b)
+{
+    struct stat sa;
+    struct stat sb;
+    if (stat(a, &sa) != 0)
+        return 0;
+    if (stat(b, &sb) != 0)
+        return 1;
+    return sa.st_mtim.tv_sec > sb.st_mtim.tv_sec ||
+           (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec);
+}
+
+// Evaluates a binary operator
+static int test_binary(TestState *t, const char *lhs, const char *op, const char *rhs)
+{
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return t->extended ? fnmatch(rhs, lhs, 0) == 0 : strcmp(lhs, rhs) == 0;
+    if (strcmp(op, "!=") == 0)
+        return t->extended ? fnmatch(rhs, lhs, 0) != 0 : strcmp(lhs, rhs) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcmp(lhs, rhs) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcmp(lhs, rhs) > 0;
+    if (strcmp(op, "=~") == 0)
+    {
+        regex_t re;
+        if (regcomp(&re, rhs, REG_EXTENDED | REG_NOSUB) != 0)
+            return test_fail(t, "invalid regular expression");
+        int match = regexec(&re, lhs, 0, NULL, 0) == 0;
+        regfree(&re);
+        return match;
+    }
+    if (strcmp(op, "-nt") == 0)
+        return newer_than(lhs, rhs);
+    if (strcmp(op, "-ot") == 0)
+        return newer_than(rhs, lhs);
+    if (strcmp(op, "-ef") == 0)
+    {
+        struct stat sa;
+        struct stat sb;
+        return stat(lhs, &sa) == 0 && stat(rhs, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    long a = test_integer(t, lhs);
+    long b = test_integer(t, rhs);
+    switch (op[1] << 8 | op[2])
+    {
+    case 'e' << 8 | 'q':
+        return a == b;
+    case 'n' << 8 | 'e':
+        return a != b;
+    case 'l' << 8 | 't':
+        return a < b;
+    case 'l' << 8 | 'e':
+        return a <= b;
+    case 'g' << 8 | 't':
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
+
+// Primary: ( expr ), unary operator, binary operator, or a lone string that is true when not empty
+static int test_primary(TestState *t)
+{
+    const char *arg = peek(t, 0);
+    if (arg == NULL)
+        return test_fail(t, "argument expected");
+
+    // A binary operator in second place wins, so [ -n = x ] compares strings
+    if (peek(t, 1) != NULL && peek(t, 2) != NULL && is_binary(peek(t, 1), t->extended))
+    {
+        t->pos += 3;
+        return test_binary(t, arg, t->args[t->pos - 2], t->args[t->pos - 1]);
+    }
+    if (strcmp(arg, "(") == 0)
+    {
+        t->pos++;
+        int value = test_or(t);
+        if (!peek_is(t, 0, ")"))
+            return test_fail(t, "')' expected");
+        t->pos++;
+        return value;
+    }
+    if (is_unary(arg) && peek(t, 1) != NULL)
+    {
+        t->pos += 2;
+        return test_unary(t, arg, t->args[t->pos - 1]);
+    }
+    t->pos++;
+    return *arg != '\0';
+}
+
+// ! primary
+static int test_not(TestState *t)
+{
+    if (peek_is(t, 0, "!") && peek(t, 1) != NULL)
+    {
+        t->pos++;
+        return !test_not(t);
+    }
+    return test_primary(t);
+}
+
+// not -a not (&& inside [[ ]])
+static int test_and(TestState *t)
+{
+    int value = test_not(t);
+    while (peek_is(t, 0, t->extended ? "&&" : "-a"))
+    {
+        t->pos++;
+        value = test_not(t) && value;
+    }
+    return value;
+}
+
+// and -o and (|| inside [[ ]])
+static int test_or(TestState *t)
+{
+    int value = test_and(t);
+    while (peek_is(t, 0, t->extended ? "||" : "-o"))
+    {
+        t->pos++;
+        value = test_and(t) || value;
+    }
+    return value;
+}
+
+// Implements test, [ ... ] and [[ ... ]] in the shell process; the status is 0 for true, 1 for false
+// and 2 for a malformed expression
+void test_builtin(char **argv)
+{
+    TestState t = {argv + 1, 0, 0, 0, NULL};
+    const char *closing = NULL;
+
+    while (t.args[t.count] != NULL)
+        t.count++;
+
+    if (strcmp(argv[0], "[") == 0)
+        closing = "]";
+    else if (strcmp(argv[0], "[[") == 0)
+    {
+        closing = "]]";
+        t.extended = 1;
+    }
+    if (closing != NULL)
+    {
+        if (t.count == 0 || strcmp(t.args[t.count - 1], closing) != 0)
+        {
+            fprintf(stderr, "%s: missing '%s'\n", argv[0], closing);
+            last_exit_status = 2;
+            return;
+        }
+        t.count--;
+    }
+
+    // No arguments is false
+    int value = t.count > 0 ? test_or(&t) : 0;
+    if (t.error == NULL && t.pos < t.count)
+        t.error = "too many arguments";
+    if (t.error != NULL)
+    {
+        fprintf(stderr, "%s: %s\n", argv[0], t.error);
+        last_exit_status = 2;
+        return;
+    }
+    last_exit_status = value ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "myshell.h"
+
+#include <time.h>
+
+#define TRACE_LINE 768
+#define TRACE_DETAIL 200
+
+// Descriptor the spans are appended to, -1 while tracing is off
+int trace_fd = -1;
+
+// Returns the monotonic clock in microseconds, the unit trace viewers expect
+static long long trace_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Starts appending spans to path in the Trace Event Format that chrome://tracing and Perfetto load: an opening
+// '[' and then one complete event per line, the closing bracket being optional. Returns -1 after reporting
+int trace_open(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd == -1)
+    {
+        perror(path);
+        return -1;
+    }
+
+    // Kept clear of the low descriptors a redirection of a builtin could swap out from under it
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    close(fd);
+    if (high == -1)
+    {
+        perror(path);
+        return -1;
+    }
+    if (fstat(high, &st) == 0 && st.st_size == 0)
+        write_all(high, "[\n", 2);
+
+    trace_close();
+    trace_fd = high;
+    return 0;
+}
+
+// Stops tracing
+void trace_close()
+{
+    if (trace_fd != -1)
+        close(trace_fd);
+    trace_fd = -1;
+}
+
+// Returns the time a span starts, or 0 while tracing is off so untraced runs never read the clock
+long long trace_start()
+{
+    return trace_fd != -1 ? trace_clock() : 0;
+}
+
+// Writes the span name from start until now; tid puts a child's span on its own row, 0 keeps it on the
+// shell's. detail, when not NULL, is shown with the span. A span started before tracing was on is dropped
+void trace_span(const char *name, long long start, const char *detail, pid_t tid)
+{
+    char line[TRACE_LINE];
+
+    if (trace_fd == -1 || start == 0)
+        return;
+
+    pid_t shell = getpid();
+    int len = snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,", name, start,
+                       trace_clock() - start);
+    len += snprintf(line + len, sizeof(line) - len, "\"pid\":%d,\"tid\":%d", shell, tid != 0 ? tid : shell);
+    if (detail != NULL)
+    {
+        len += snprintf(line + len, sizeof(line) - len, ",\"args\":{\"detail\":\"");
+        for (int i = 0; detail[i] != '\0' && i < TRACE_DETAIL; i++)
+        {
+            // Quotes and backslashes are escaped, control characters would need \u escapes and become spaces
+            unsigned char c = detail[i];
+            if (c == '"' || c == '\\')
+                line[len++] = '\\';
+            line[len++] = c < ' ' ? ' ' : c;
+        }
+        len += snprintf(line + len, sizeof(line) - len, "\"}");
+    }
+    len += snprintf(line + len, sizeof(line) - len, "},\n");
+    write_all(trace_fd, line, len);
+}
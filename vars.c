@@ -0,0 +1,282 @@
+#include "myshell.h"
+
+#define VARS_INITIAL_CAPACITY 64
+
+extern char **environ;
+
+// Length-prefixed string; values keep spare capacity so reassignment can reuse the buffer
+typedef struct
+{
+    size_t length;
+    size_t capacity;
+    char data[];
+} ShellString;
+
+// One open-addressing slot; a slot with a name but no value is a tombstone left by unset
+typedef struct
+{
+    unsigned int hash;
+    int exported;
+    ShellString *name;
+    ShellString *value;
+} VarSlot;
+
+static VarSlot *var_slots = NULL;
+static size_t var_capacity = 0;
+static size_t var_used = 0; // live variables plus tombstones
+static size_t var_count = 0;
+
+// Makes a length-prefixed copy of len bytes with room for at least capacity bytes
+static ShellString *string_new(const char *s, size_t len, size_t capacity)
+{
+    if (capacity < len)
+        capacity = len;
+
+    ShellString *str = malloc(sizeof(ShellString) + capacity + 1);
+    if (str == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    str->length = len;
+    str->capacity = capacity;
+    memcpy(str->data, s, len);
+    str->data[len] = '\0';
+    return str;
+}
+
+// Finds the slot holding name, or the slot where it would be inserted (reusing the first tombstone seen)
+static VarSlot *var_find_slot(const char *name, size_t len, unsigned int hash)
+{
+    size_t mask = var_capacity - 1;
+    VarSlot *tombstone = NULL;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        VarSlot *slot = &var_slots[i];
+        if (slot->name == NULL)
+            return tombstone != NULL ? tombstone : slot;
+
+        if (slot->value == NULL)
+        {
+            if (tombstone == NULL)
+                tombstone = slot;
+        }
+        else if (slot->hash == hash && slot->name->length == len && memcmp(slot->name->data, name, len) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+// Rehashes every live variable into a table of new_capacity slots, dropping tombstones
+static void var_resize(size_t new_capacity)
+{
+    VarSlot *old_slots = var_slots;
+    size_t old_capacity = var_capacity;
+
+    var_slots = calloc(new_capacity, sizeof(VarSlot));
+    if (var_slots == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    var_capacity = new_capacity;
+    var_used = var_count;
+
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        VarSlot *slot = &old_slots[i];
+        if (slot->name == NULL)
+            continue;
+        if (slot->value == NULL)
+        {
+            free(slot->name);
+            continue;
+        }
+        *var_find_slot(slot->name->data, slot->name->length, slot->hash) = *slot;
+    }
+    free(old_slots);
+}
+
+// Looks up the live slot for name, or NULL
+static VarSlot *var_lookup(const char *name)
+{
+    if (var_count == 0)
+        return NULL;
+
+    size_t len = strlen(name);
+    VarSlot *slot = var_find_slot(name, len, hash_bytes(name, len));
+    return slot->name != NULL && slot->value != NULL ? slot : NULL;
+}
+
+// Copies an exported variable into the environment children inherit (the store keeps the '$' prefix)
+static void var_sync_environment(const VarSlot *slot)
+{
+    const char *env_name = slot->name->data[0] == '$' ? slot->name->data + 1 : slot->name->data;
+    setenv(env_name, slot->value->data, 1);
+}
+
+// Retrieves the value of a shell variable given its name
+char *get_variable_value(const char *name)
+{
+    VarSlot *slot = var_lookup(name);
+    return slot != NULL ? slot->value->data : NULL;
+}
+
+// Sets the value of a shell variable, adding it if it does not exist
+void set_variable_value(const char *name, const char *value)
+{
+    size_t len = strlen(name);
+    size_t value_len = strlen(value);
+    unsigned int hash = hash_bytes(name, len);
+
+    // Keep the load factor under 3/4, tombstones included
+    if ((var_used + 1) * 4 > var_capacity * 3)
+    {
+        // Grow while live variables would fill more than half the table, otherwise just sweep out tombstones
+        size_t new_capacity = VARS_INITIAL_CAPACITY;
+        while ((var_count + 1) * 2 > new_capacity)
+            new_capacity *= 2;
+        var_resize(new_capacity);
+    }
+
+    VarSlot *slot = var_find_slot(name, len, hash);
+    if (slot->name != NULL && slot->value != NULL)
+    {
+        // Existing variable: overwrite in place when the value fits
+        if (value_len <= slot->value->capacity)
+        {
+            memcpy(slot->value->data, value, value_len + 1);
+            slot->value->length = value_len;
+        }
+        else
+        {
+            free(slot->value);
+            slot->value = string_new(value, value_len, value_len * 2);
+        }
+    }
+    else
+    {
+        if (slot->name == NULL)
+        {
+            slot->name = string_new(name, len, len);
+            var_used++;
+        }
+        else if (slot->name->length != len || memcmp(slot->name->data, name, len) != 0)
+        {
+            // Reusing a tombstone that belonged to another name
+            free(slot->name);
+            slot->name = string_new(name, len, len);
+        }
+        slot->hash = hash;
+        slot->exported = 0;
+        slot->value = string_new(value, value_len, value_len);
+        var_count++;
+    }
+
+    if (slot->exported)
+        var_sync_environment(slot);
+}
+
+// Removes a shell variable, returns 0 if it existed and -1 otherwise
+int unset_variable(const char *name)
+{
+    VarSlot *slot = var_lookup(name);
+    if (slot == NULL)
+        return -1;
+
+    if (slot->exported)
+        unsetenv(slot->name->data[0] == '$' ? slot->name->data + 1 : slot->name->data);
+
+    // Leave the name behind as a tombstone so probe chains stay intact
+    free(slot->value);
+    slot->value = NULL;
+    slot->exported = 0;
+    var_count--;
+    return 0;
+}
+
+// Returns 1 when the variable name is set and exported
+int is_exported(const char *name)
+{
+    VarSlot *slot = var_lookup(name);
+    return slot != NULL && slot->exported;
+}
+
+// Marks a variable for export to child processes, creating it empty if needed
+void export_variable(const char *name)
+{
+    VarSlot *slot = var_lookup(name);
+    if (slot == NULL)
+    {
+        set_variable_value(name, "");
+        slot = var_lookup(name);
+    }
+    slot->exported = 1;
+    var_sync_environment(slot);
+}
+
+// Loads the inherited environment as exported shell variables
+void import_environment()
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    for (char **env = environ; *env != NULL; env++)
+    {
+        const char *eq = strchr(*env, '=');
+        if (eq == NULL || eq - *env >= MAX_COMMAND_LENGTH - 1)
+            continue;
+
+        snprintf(name, sizeof(name), "$%.*s", (int)(eq - *env), *env);
+        set_variable_value(name, eq + 1);
+        var_lookup(name)->exported = 1;
+    }
+}
+
+// Implements export: no arguments lists exported variables, NAME marks one, NAME=value also assigns it
+void export_builtin(char **argv)
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    if (argv[1] == NULL)
+    {
+        for (size_t i = 0; i < var_capacity; i++)
+        {
+            VarSlot *slot = &var_slots[i];
+            if (slot->value != NULL && slot->exported)
+                printf("export %s=\"%s\"\n", slot->name->data + (slot->name->data[0] == '$'), slot->value->data);
+        }
+        return;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        const char *arg = argv[i][0] == '$' ? argv[i] + 1 : argv[i];
+        const char *eq = strchr(arg, '=');
+        int len = eq != NULL ? (int)(eq - arg) : (int)strlen(arg);
+
+        snprintf(name, sizeof(name), "$%.*s", len, arg);
+        if (eq != NULL)
+            set_variable_value(name, eq + 1);
+        export_variable(name);
+    }
+}
+
+// Implements unset for each named variable, or with -f for each named function
+void unset_builtin(char **argv)
+{
+    char name[MAX_COMMAND_LENGTH];
+
+    if (argv[1] != NULL && strcmp(argv[1], "-f") == 0)
+    {
+        for (int i = 2; argv[i] != NULL; i++)
+            unset_function(argv[i]);
+        return;
+    }
+    for (int i = 1; argv[i] != NULL; i++)
+    {
+        snprintf(name, sizeof(name), "$%s", argv[i][0] == '$' ? argv[i] + 1 : argv[i]);
+        unset_variable(name);
+    }
+}